@@ -0,0 +1,241 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Minimal Google-Benchmark-style harness. No external dependency: each
+// benchmark is a named function that loops on State::keepRunning() and tells
+// the state how many samples one iteration processes, so the report can be
+// expressed per sample.
+//
+// Cycles are read from the TSC on x86. Elsewhere there is no portable
+// user-space cycle counter, so cycles are derived from wall time and the
+// nominal clock passed with --ghz.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+  defined(_M_IX86)
+#define OVERDRAW_BENCHMARK_HAS_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define OVERDRAW_BENCHMARK_HAS_TSC 0
+#endif
+
+namespace overdraw::benchmark {
+
+inline uint64_t
+readCycleCounter()
+{
+#if OVERDRAW_BENCHMARK_HAS_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// Keeps the compiler from optimizing away a computed value.
+template<class T>
+inline void
+doNotOptimize(T const& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile char sink;
+  sink = *reinterpret_cast<char const volatile*>(&value);
+#endif
+}
+
+class State final
+{
+public:
+  explicit State(double minTimeInSeconds)
+    : minTime(minTimeInSeconds)
+  {}
+
+  bool keepRunning()
+  {
+    auto const now = Clock::now();
+    if (numIterations == 0) {
+      startTime = now;
+      startCycles = readCycleCounter();
+    }
+    else {
+      elapsed = std::chrono::duration<double>(now - startTime).count();
+      if (elapsed >= minTime && numIterations >= minIterations) {
+        cycles = readCycleCounter() - startCycles;
+        return false;
+      }
+    }
+    ++numIterations;
+    return true;
+  }
+
+  // Setup work done inside the loop can be excluded with pause/resume.
+  void pauseTiming()
+  {
+    pausedAt = Clock::now();
+    pausedCycles = readCycleCounter();
+  }
+
+  void resumeTiming()
+  {
+    startTime += Clock::now() - pausedAt;
+    startCycles += readCycleCounter() - pausedCycles;
+  }
+
+  void setSamplesPerIteration(int64_t n) { samplesPerIteration = n; }
+
+  int64_t getNumIterations() const { return numIterations; }
+  int64_t getTotalSamples() const
+  {
+    return getNumIterations() * samplesPerIteration;
+  }
+  double getElapsedSeconds() const { return elapsed; }
+  uint64_t getElapsedCycles() const { return cycles; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  double const minTime;
+  static constexpr int64_t minIterations = 16;
+
+  int64_t numIterations = 0;
+  int64_t samplesPerIteration = 1;
+  Clock::time_point startTime;
+  Clock::time_point pausedAt;
+  uint64_t startCycles = 0;
+  uint64_t pausedCycles = 0;
+  uint64_t cycles = 0;
+  double elapsed = 0.0;
+};
+
+struct Benchmark final
+{
+  std::string name;
+  std::function<void(State&)> function;
+};
+
+inline std::vector<Benchmark>&
+getRegistry()
+{
+  static std::vector<Benchmark> registry;
+  return registry;
+}
+
+inline void
+registerBenchmark(std::string name, std::function<void(State&)> function)
+{
+  getRegistry().push_back({ std::move(name), std::move(function) });
+}
+
+// Usage: <benchmark> [--filter <substring>] [--min-time <seconds>]
+//                    [--ghz <nominal clock>] [--list]
+inline int
+runRegisteredBenchmarks(int argc, char** argv)
+{
+  std::string filter;
+  double minTime = 0.25;
+  double ghz = 3.0;
+  bool listOnly = false;
+
+  for (int i = 1; i < argc; ++i) {
+    auto const isArg = [&](char const* name) {
+      return std::strcmp(argv[i], name) == 0 && i + 1 < argc;
+    };
+    if (isArg("--filter")) {
+      filter = argv[++i];
+    }
+    else if (isArg("--min-time")) {
+      minTime = std::atof(argv[++i]);
+    }
+    else if (isArg("--ghz")) {
+      ghz = std::atof(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--list") == 0) {
+      listOnly = true;
+    }
+    else {
+      std::fprintf(stderr,
+                   "usage: %s [--filter <substring>] [--min-time <seconds>] "
+                   "[--ghz <nominal clock>] [--list]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+
+  size_t nameWidth = 24;
+  for (auto const& benchmark : getRegistry()) {
+    nameWidth = std::max(nameWidth, benchmark.name.size());
+  }
+
+  if (!listOnly) {
+    std::printf("%-*s %12s %12s %14s\n",
+                static_cast<int>(nameWidth),
+                "benchmark",
+                "iterations",
+                "ns/sample",
+                "cycles/sample");
+  }
+
+  for (auto const& benchmark : getRegistry()) {
+    if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    if (listOnly) {
+      std::printf("%s\n", benchmark.name.c_str());
+      continue;
+    }
+
+    State state(minTime);
+    benchmark.function(state);
+
+    auto const totalSamples =
+      static_cast<double>(std::max<int64_t>(1, state.getTotalSamples()));
+    double const nsPerSample = 1e9 * state.getElapsedSeconds() / totalSamples;
+    double const cyclesPerSample =
+      OVERDRAW_BENCHMARK_HAS_TSC
+        ? static_cast<double>(state.getElapsedCycles()) / totalSamples
+        : nsPerSample * ghz;
+
+    std::printf("%-*s %12lld %12.3f %14.3f\n",
+                static_cast<int>(nameWidth),
+                benchmark.name.c_str(),
+                static_cast<long long>(state.getNumIterations()),
+                nsPerSample,
+                cyclesPerSample);
+  }
+
+  return 0;
+}
+
+} // namespace overdraw::benchmark
@@ -0,0 +1,472 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Startup time and memory of many plug-in instances.
+//
+// For each instance count, constructs the processors, with their parameters
+// and value tree, prepares them, loads a state into each of them and
+// optionally creates their editors, then destroys everything. Each phase is
+// timed, and the heap bytes allocated through operator new and the growth of
+// the resident set are reported per instance, along with the peak resident
+// set of the process so far. Counts run in increasing order, so the peak is
+// that of the largest count run so far.
+
+#include "PluginEditor.h"
+#include "PluginProcessor.h"
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <optional>
+
+#if JUCE_WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif JUCE_MAC
+#include <mach/mach.h>
+#endif
+
+// heap accounting: every allocation through operator new is preceded by a
+// header with its size and the address of the underlying block
+
+namespace {
+
+std::atomic<int64_t> liveHeapBytes{ 0 };
+
+struct AllocationHeader final
+{
+  void* block;
+  size_t size;
+};
+
+void*
+allocate(size_t size, size_t alignment) noexcept
+{
+  alignment = std::max(alignment, alignof(std::max_align_t));
+  void* const block =
+    std::malloc(size + alignment + sizeof(AllocationHeader));
+  if (block == nullptr) {
+    return nullptr;
+  }
+  auto address = reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader);
+  address = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+  auto* const header = reinterpret_cast<AllocationHeader*>(address) - 1;
+  header->block = block;
+  header->size = size;
+  liveHeapBytes.fetch_add(static_cast<int64_t>(size),
+                          std::memory_order_relaxed);
+  return reinterpret_cast<void*>(address);
+}
+
+void*
+allocateOrThrow(size_t size, size_t alignment)
+{
+  if (void* const memory = allocate(size, alignment)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void
+deallocate(void* memory) noexcept
+{
+  if (memory == nullptr) {
+    return;
+  }
+  auto* const header = static_cast<AllocationHeader*>(memory) - 1;
+  liveHeapBytes.fetch_sub(static_cast<int64_t>(header->size),
+                          std::memory_order_relaxed);
+  std::free(header->block);
+}
+
+} // namespace
+
+void*
+operator new(size_t size)
+{
+  return allocateOrThrow(size, 0);
+}
+void*
+operator new[](size_t size)
+{
+  return allocateOrThrow(size, 0);
+}
+void*
+operator new(size_t size, std::align_val_t alignment)
+{
+  return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void*
+operator new[](size_t size, std::align_val_t alignment)
+{
+  return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+void*
+operator new(size_t size, std::nothrow_t const&) noexcept
+{
+  return allocate(size, 0);
+}
+void*
+operator new[](size_t size, std::nothrow_t const&) noexcept
+{
+  return allocate(size, 0);
+}
+void*
+operator new(size_t size,
+             std::align_val_t alignment,
+             std::nothrow_t const&) noexcept
+{
+  return allocate(size, static_cast<size_t>(alignment));
+}
+void*
+operator new[](size_t size,
+               std::align_val_t alignment,
+               std::nothrow_t const&) noexcept
+{
+  return allocate(size, static_cast<size_t>(alignment));
+}
+
+void
+operator delete(void* memory) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete[](void* memory) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete(void* memory, size_t) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete[](void* memory, size_t) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete(void* memory, std::align_val_t) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete[](void* memory, std::align_val_t) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete(void* memory, std::nothrow_t const&) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete[](void* memory, std::nothrow_t const&) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete(void* memory, std::align_val_t, std::nothrow_t const&) noexcept
+{
+  deallocate(memory);
+}
+void
+operator delete[](void* memory,
+                  std::align_val_t,
+                  std::nothrow_t const&) noexcept
+{
+  deallocate(memory);
+}
+
+namespace {
+
+struct ResidentSet final
+{
+  size_t current = 0;
+  size_t peak = 0;
+};
+
+ResidentSet
+getResidentSet()
+{
+  ResidentSet residentSet;
+#if JUCE_WINDOWS
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    residentSet.current = counters.WorkingSetSize;
+    residentSet.peak = counters.PeakWorkingSetSize;
+  }
+#elif JUCE_MAC
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(),
+                MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info),
+                &count) == KERN_SUCCESS) {
+    residentSet.current = info.resident_size;
+    residentSet.peak = info.resident_size_max;
+  }
+#else
+  // in kB
+  auto const status = File("/proc/self/status").loadFileAsString();
+  auto const readField = [&](String const& name) {
+    auto const line = status.fromFirstOccurrenceOf(name, false, false)
+                        .upToFirstOccurrenceOf("\n", false, false);
+    return static_cast<size_t>(line.trim().getLargeIntValue()) * 1024;
+  };
+  residentSet.current = readField("VmRSS:");
+  residentSet.peak = readField("VmHWM:");
+#endif
+  return residentSet;
+}
+
+struct Options final
+{
+  Array<int> counts{ 1, 8, 64, 256 };
+  double sampleRate = 48000.0;
+  int blockSize = 512;
+  String presetPath;
+  bool hasEditors = false;
+};
+
+void
+printUsage()
+{
+  std::printf(
+    "usage: OverdrawInstanceBenchmark [options]\n"
+    "  --counts <n,n,...>     instance counts (default: 1,8,64,256)\n"
+    "  --sample-rate <Hz>     (default: 48000)\n"
+    "  --block-size <n>       block size given to prepareToPlay "
+    "(default: 512)\n"
+    "  --preset <file>        plug-in state, binary or xml, loaded into "
+    "every\n"
+    "                         instance (default: the state of a new one)\n"
+    "  --editors              also creates an editor for each instance\n");
+}
+
+std::optional<Options>
+parseOptions(StringArray const& args)
+{
+  Options options;
+  for (int i = 0; i < args.size(); ++i) {
+    auto const& arg = args[i];
+    if (arg == "--editors") {
+      options.hasEditors = true;
+      continue;
+    }
+    if (arg == "--help" || arg == "-h" || i + 1 == args.size()) {
+      return std::nullopt;
+    }
+    auto const& value = args[++i];
+    if (arg == "--counts") {
+      options.counts.clear();
+      for (auto const& count : StringArray::fromTokens(value, ",", "")) {
+        options.counts.add(jmax(1, count.getIntValue()));
+      }
+      options.counts.sort();
+    }
+    else if (arg == "--sample-rate") {
+      options.sampleRate = value.getDoubleValue();
+    }
+    else if (arg == "--block-size") {
+      options.blockSize = jmax(1, value.getIntValue());
+    }
+    else if (arg == "--preset") {
+      options.presetPath = value;
+    }
+    else {
+      std::fprintf(stderr, "unknown option %s\n", arg.toRawUTF8());
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+
+bool
+loadPreset(String const& path, MemoryBlock& state)
+{
+  if (!File(path).loadFileAsData(state)) {
+    return false;
+  }
+  if (auto xml = parseXML(state.toString())) {
+    MemoryBlock binary;
+    AudioProcessor::copyXmlToBinary(*xml, binary);
+    state = binary;
+  }
+  return true;
+}
+
+struct Result final
+{
+  double constructMs = 0.0;
+  double prepareMs = 0.0;
+  double setStateMs = 0.0;
+  double editorMs = 0.0;
+  double destroyMs = 0.0;
+  double heapBytesPerInstance = 0.0;
+  double residentBytesPerInstance = 0.0;
+  size_t peakResidentBytes = 0;
+};
+
+template<class Function>
+double
+timeMs(Function&& function)
+{
+  auto const start = std::chrono::steady_clock::now();
+  function();
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+Result
+run(int count, MemoryBlock const& state, Options const& options)
+{
+  Result result;
+
+  int64_t const heapBefore = liveHeapBytes.load();
+  auto const residentBefore = getResidentSet();
+
+  std::vector<std::unique_ptr<OverdrawAudioProcessor>> processors;
+  std::vector<std::unique_ptr<AudioProcessorEditor>> editors;
+  processors.reserve(count);
+  editors.reserve(count);
+
+  result.constructMs = timeMs([&] {
+    for (int i = 0; i < count; ++i) {
+      processors.push_back(std::make_unique<OverdrawAudioProcessor>());
+    }
+  });
+
+  result.prepareMs = timeMs([&] {
+    for (auto& processor : processors) {
+      processor->setRateAndBufferSizeDetails(options.sampleRate,
+                                             options.blockSize);
+      processor->prepareToPlay(options.sampleRate, options.blockSize);
+    }
+  });
+
+  result.setStateMs = timeMs([&] {
+    for (auto& processor : processors) {
+      processor->setStateInformation(state.getData(),
+                                     static_cast<int>(state.getSize()));
+    }
+  });
+
+  if (options.hasEditors) {
+    result.editorMs = timeMs([&] {
+      for (auto& processor : processors) {
+        editors.emplace_back(processor->createEditorIfNeeded());
+      }
+    });
+  }
+
+  int64_t const heapAfter = liveHeapBytes.load();
+  auto const residentAfter = getResidentSet();
+
+  result.heapBytesPerInstance =
+    static_cast<double>(heapAfter - heapBefore) / count;
+  result.residentBytesPerInstance =
+    (static_cast<double>(residentAfter.current) -
+     static_cast<double>(residentBefore.current)) /
+    count;
+  result.peakResidentBytes = residentAfter.peak;
+
+  // editors first, as in a host
+  result.destroyMs = timeMs([&] {
+    editors.clear();
+    processors.clear();
+  });
+
+  return result;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  ScopedJuceInitialiser_GUI juce;
+
+  StringArray args;
+  for (int i = 1; i < argc; ++i) {
+    args.add(argv[i]);
+  }
+  auto const options = parseOptions(args);
+  if (!options) {
+    printUsage();
+    return 2;
+  }
+
+  MemoryBlock state;
+  if (options->presetPath.isNotEmpty()) {
+    if (!loadPreset(options->presetPath, state)) {
+      std::fprintf(
+        stderr, "could not read %s\n", options->presetPath.toRawUTF8());
+      return 2;
+    }
+  }
+  else {
+    OverdrawAudioProcessor().getStateInformation(state);
+  }
+
+  std::printf("%9s %12s %12s %12s %12s %12s %14s %14s %13s\n",
+              "instances",
+              "construct ms",
+              "prepare ms",
+              "state ms",
+              "editors ms",
+              "destroy ms",
+              "heap KiB/inst",
+              "RSS KiB/inst",
+              "peak RSS MiB");
+
+  for (int const count : options->counts) {
+    auto const result = run(count, state, *options);
+    std::printf("%9d %12.1f %12.1f %12.1f %12.1f %12.1f %14.1f %14.1f %13.1f\n",
+                count,
+                result.constructMs,
+                result.prepareMs,
+                result.setStateMs,
+                result.editorMs,
+                result.destroyMs,
+                result.heapBytesPerInstance / 1024.0,
+                result.residentBytesPerInstance / 1024.0,
+                result.peakResidentBytes / (1024.0 * 1024.0));
+    std::fflush(stdout);
+  }
+
+  return 0;
+}
@@ -0,0 +1,280 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Microbenchmarks for the spline kernel in isolation: no JUCE, no
+// oversamplers. A "sample" in the report is one stereo frame, i.e. one Vec2d.
+//
+// Each configuration runs both through overdraw::Dsp::waveshape (in place,
+// which includes refreshing the input, see the "copy" baseline) and directly
+// through AutoSpline::processBlock (out of place). With static knots,
+// waveshape runs the wide kernel, which packs consecutive samples of a channel
+// in a vector, so "waveshape/.../static" against "autospline/.../static"
+// compares the two kernels.
+
+#include "BenchmarkHarness.h"
+#include "OverdrawDsp.h"
+
+#include <cmath>
+#include <random>
+
+namespace {
+
+using namespace overdraw;
+using namespace overdraw::benchmark;
+
+// the plug-in runs the spline at up to 32x, so this is the rate at which the
+// knot smoothing is computed when benchmarking automation
+constexpr double upsampledSampleRate = 48000.0 * 32.0;
+constexpr double smoothingTime = 0.05;
+
+enum class InputLevel
+{
+  quiet,
+  nominal,
+  hot,
+  sine
+};
+
+char const*
+getInputLevelName(InputLevel level)
+{
+  switch (level) {
+    case InputLevel::quiet:
+      return "quiet";
+    case InputLevel::nominal:
+      return "nominal";
+    case InputLevel::hot:
+      return "hot";
+    case InputLevel::sine:
+      return "sine";
+  }
+  return "";
+}
+
+void
+fillInput(VecBuffer<Vec2d>& buffer, int const numSamples, InputLevel level)
+{
+  auto randomGenerator = std::mt19937(1234);
+  auto gaussian = std::normal_distribution<double>(0.0, 0.01);
+  auto uniform = std::uniform_real_distribution<double>(-1.0, 1.0);
+  auto wide = std::uniform_real_distribution<double>(-3.0, 3.0);
+
+  constexpr double sineFrequency = 997.0 / upsampledSampleRate;
+  constexpr double twoPi = 6.283185307179586476925;
+
+  for (int i = 0; i < numSamples; ++i) {
+    double l = 0.0;
+    double r = 0.0;
+    switch (level) {
+      case InputLevel::quiet:
+        l = gaussian(randomGenerator);
+        r = gaussian(randomGenerator);
+        break;
+      case InputLevel::nominal:
+        l = uniform(randomGenerator);
+        r = uniform(randomGenerator);
+        break;
+      case InputLevel::hot:
+        // mostly outside of the knot range, where the spline extrapolates
+        l = wide(randomGenerator);
+        r = wide(randomGenerator);
+        break;
+      case InputLevel::sine:
+        l = 0.9 * std::sin(twoPi * sineFrequency * i);
+        r = 0.9 * std::cos(twoPi * sineFrequency * i);
+        break;
+    }
+    buffer[i] = Vec2d(l, r);
+  }
+}
+
+// Spreads numKnots knots over [-1.5, 1.5] on a tanh curve, scaled by
+// `drive` so that two different drives give two different targets for the
+// automation benchmarks.
+void
+setKnots(Dsp& dsp, int const numKnots, double const drive)
+{
+  for (int k = 0; k < numKnots; ++k) {
+    double const x =
+      numKnots == 1 ? 0.0 : -1.5 + 3.0 * k / static_cast<double>(numKnots - 1);
+    double const y = std::tanh(drive * x);
+    double const tangent = drive * (1.0 - y * y);
+    for (int c = 0; c < 2; ++c) {
+      dsp.setKnot(k, c, x, y, tangent, 1.0);
+    }
+  }
+}
+
+struct Configuration final
+{
+  int numKnots;
+  bool isSymmetric;
+  bool isAutomated;
+  int numSamples;
+  InputLevel inputLevel;
+
+  std::string getName(char const* prefix) const
+  {
+    return std::string(prefix) + "/knots:" + std::to_string(numKnots) +
+           (isSymmetric ? "/symmetric" : "/asymmetric") +
+           (isAutomated ? "/automated" : "/static") +
+           "/samples:" + std::to_string(numSamples) + "/" +
+           getInputLevelName(inputLevel);
+  }
+};
+
+aligned_ptr<Dsp>
+makeDsp(Configuration const& configuration)
+{
+  auto dsp = Aligned<Dsp>::make();
+
+  setKnots(*dsp, configuration.numKnots, 1.0);
+  for (int c = 0; c < 2; ++c) {
+    dsp->setIsSymmetric(c, configuration.isSymmetric);
+  }
+
+  double const alpha =
+    std::exp(-6.283185307179586476925 / (upsampledSampleRate * smoothingTime));
+  dsp->setSmoothingAlpha(alpha);
+  dsp->prepare(configuration.numSamples);
+  dsp->reset();
+
+  return dsp;
+}
+
+// Flipping the targets on every block keeps the automator smoothing for the
+// whole run, as during a dense automation pass.
+void
+updateAutomation(Dsp& dsp,
+                 Configuration const& configuration,
+                 int64_t const iteration)
+{
+  if (configuration.isAutomated) {
+    setKnots(dsp, configuration.numKnots, (iteration & 1) ? 2.0 : 1.0);
+  }
+}
+
+void
+benchmarkWaveshape(State& state, Configuration const& configuration)
+{
+  auto dsp = makeDsp(configuration);
+  int const numSamples = configuration.numSamples;
+
+  VecBuffer<Vec2d> input{ numSamples };
+  VecBuffer<Vec2d> io{ numSamples };
+  fillInput(input, numSamples, configuration.inputLevel);
+
+  state.setSamplesPerIteration(numSamples);
+
+  int64_t iteration = 0;
+  while (state.keepRunning()) {
+    updateAutomation(*dsp, configuration, iteration++);
+    for (int i = 0; i < numSamples; ++i) {
+      Vec2d const x = input[i];
+      io[i] = x;
+    }
+    dsp->waveshape(io, configuration.numKnots);
+    doNotOptimize(io);
+  }
+}
+
+void
+benchmarkAutoSpline(State& state, Configuration const& configuration)
+{
+  auto dsp = makeDsp(configuration);
+  int const numSamples = configuration.numSamples;
+
+  VecBuffer<Vec2d> input{ numSamples };
+  VecBuffer<Vec2d> output{ numSamples };
+  fillInput(input, numSamples, configuration.inputLevel);
+
+  state.setSamplesPerIteration(numSamples);
+
+  int64_t iteration = 0;
+  while (state.keepRunning()) {
+    updateAutomation(*dsp, configuration, iteration++);
+    dsp->autoSpline.processBlock(input, output, configuration.numKnots);
+    doNotOptimize(output);
+  }
+}
+
+// Baseline for the input refresh included in benchmarkWaveshape.
+void
+benchmarkCopy(State& state, int const numSamples)
+{
+  VecBuffer<Vec2d> input{ numSamples };
+  VecBuffer<Vec2d> io{ numSamples };
+  fillInput(input, numSamples, InputLevel::nominal);
+
+  state.setSamplesPerIteration(numSamples);
+
+  while (state.keepRunning()) {
+    for (int i = 0; i < numSamples; ++i) {
+      Vec2d const x = input[i];
+      io[i] = x;
+    }
+    doNotOptimize(io);
+  }
+}
+
+void
+registerAll()
+{
+  constexpr int knotCounts[] = { 1, 3, 7, 11, maxNumKnots };
+  constexpr int bufferLengths[] = { 32, 512, 4096 };
+  constexpr InputLevel inputLevels[] = {
+    InputLevel::quiet, InputLevel::nominal, InputLevel::hot, InputLevel::sine
+  };
+
+  for (int numSamples : bufferLengths) {
+    registerBenchmark("copy/samples:" + std::to_string(numSamples),
+                      [=](State& state) { benchmarkCopy(state, numSamples); });
+  }
+
+  for (int numKnots : knotCounts) {
+    for (bool isSymmetric : { false, true }) {
+      for (bool isAutomated : { false, true }) {
+        for (int numSamples : bufferLengths) {
+          for (InputLevel inputLevel : inputLevels) {
+            auto const configuration = Configuration{
+              numKnots, isSymmetric, isAutomated, numSamples, inputLevel
+            };
+            registerBenchmark(configuration.getName("waveshape"),
+                              [=](State& state) {
+                                benchmarkWaveshape(state, configuration);
+                              });
+            registerBenchmark(configuration.getName("autospline"),
+                              [=](State& state) {
+                                benchmarkAutoSpline(state, configuration);
+                              });
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  registerAll();
+  return runRegisteredBenchmarks(argc, argv);
+}
@@ -0,0 +1,166 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Arena.h"
+#include "avec/Avec.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace overdraw {
+
+/**
+ * Chooses the oversampling order from the load of the processor, for the
+ * adaptive oversampling mode. The load is smoothed over about half a second.
+ * When it stays above highLoad, the order goes down by one, and when it stays
+ * below lowLoad, it goes back up by one. Each order costs about twice the one
+ * below, so the smoothed load is scaled accordingly on a change, and lowLoad
+ * is well below half of highLoad, so that a change does not undo the
+ * previous one. Going up also needs a longer hold time than going down.
+ */
+class OversamplingGovernor final
+{
+public:
+  static constexpr double highLoad = 0.6;
+  static constexpr double lowLoad = 0.2;
+  static constexpr double loadTimeConstant = 0.5;
+  static constexpr double downHoldTime = 1.0;
+  static constexpr double upHoldTime = 5.0;
+
+  void reset(int newOrder)
+  {
+    order = newOrder;
+    smoothedLoad = 0.0;
+    timeSinceChange = 0.0;
+  }
+
+  /**
+   * @param load the time spent on the last block, relative to its duration
+   * @param blockSeconds the duration of the last block
+   * @return the order to use, in [minOrder, maxOrder]
+   */
+  int update(double load, double blockSeconds, int minOrder, int maxOrder)
+  {
+    double const alpha = 1.0 - std::exp(-blockSeconds / loadTimeConstant);
+    smoothedLoad += alpha * (load - smoothedLoad);
+    timeSinceChange += blockSeconds;
+
+    int newOrder = std::clamp(order, minOrder, maxOrder);
+    if (newOrder == order) {
+      if (smoothedLoad > highLoad && order > minOrder &&
+          timeSinceChange >= downHoldTime) {
+        newOrder = order - 1;
+      }
+      else if (smoothedLoad < lowLoad && order < maxOrder &&
+               timeSinceChange >= upHoldTime) {
+        newOrder = order + 1;
+      }
+    }
+    if (newOrder != order) {
+      smoothedLoad *= std::ldexp(1.0, newOrder - order);
+      timeSinceChange = 0.0;
+      order = newOrder;
+    }
+    return order;
+  }
+
+  int getOrder() const { return order; }
+
+private:
+  int order = 0;
+  double smoothedLoad = 0.0;
+  double timeSinceChange = 0.0;
+};
+
+/**
+ * Delays a stereo signal, to pad the latency of a resampling path to the one
+ * reported to the host, or to stand in for the whole processing in bypass.
+ */
+class LatencyCompensation final
+{
+public:
+  /**
+   * Takes the memory for delays of up to maxDelay samples from an arena.
+   */
+  void carve(Arena& arena, int maxDelay)
+  {
+    capacity = maxDelay + 1;
+    memory = arena.carve<double>(2 * static_cast<size_t>(capacity));
+  }
+
+  /**
+   * Clears the state and sets the delay, clamped to the carved capacity.
+   */
+  void reset(int newDelay)
+  {
+    delay = memory ? std::clamp(newDelay, 0, capacity - 1) : 0;
+    head = 0;
+    if (memory) {
+      std::fill(memory, memory + 2 * capacity, 0.0);
+    }
+  }
+
+  int getDelay() const { return delay; }
+
+  void process(VecBuffer<Vec2d>& io, int const numSamples)
+  {
+    if (delay == 0) {
+      return;
+    }
+    for (int i = 0; i < numSamples; ++i) {
+      int const tail = head >= delay ? head - delay : head - delay + capacity;
+      Vec2d const x = io[i];
+      io[i] = Vec2d().load(memory + 2 * tail);
+      x.store(memory + 2 * head);
+      head = head + 1 == capacity ? 0 : head + 1;
+    }
+  }
+
+  /**
+   * Delays two planar channels from input to output, which may be the same.
+   */
+  void process(double* const* input, double* const* output, int numSamples)
+  {
+    if (delay == 0) {
+      for (int c = 0; c < 2; ++c) {
+        std::copy(input[c], input[c] + numSamples, output[c]);
+      }
+      return;
+    }
+    for (int i = 0; i < numSamples; ++i) {
+      int const tail = head >= delay ? head - delay : head - delay + capacity;
+      double const left = input[0][i];
+      double const right = input[1][i];
+      output[0][i] = memory[2 * tail];
+      output[1][i] = memory[2 * tail + 1];
+      memory[2 * head] = left;
+      memory[2 * head + 1] = right;
+      head = head + 1 == capacity ? 0 : head + 1;
+    }
+  }
+
+private:
+  double* memory = nullptr;
+  int capacity = 0;
+  int delay = 0;
+  int head = 0;
+};
+
+} // namespace overdraw
@@ -0,0 +1,174 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Arena.h"
+#include "avec/Avec.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace overdraw {
+
+/**
+ * An affine map of each channel, y = slope * x + offset, which is exact for
+ * inputs of magnitude up to halfWidth. Used to skip the resampling and the
+ * waveshaping while the signal stays where the curves are straight lines.
+ */
+struct AffineMap final
+{
+  double slope[2] = { 1.0, 1.0 };
+  double offset[2] = { 0.0, 0.0 };
+  double halfWidth[2] = { std::numeric_limits<double>::infinity(),
+                          std::numeric_limits<double>::infinity() };
+
+  /**
+   * Appends a gain followed by another map, as a stage after the first one.
+   * The range shrinks to the inputs for which the next map gets an input in
+   * its own range.
+   */
+  void append(double const* gain, AffineMap const& next)
+  {
+    for (int c = 0; c < 2; ++c) {
+      double const g = gain[c];
+      double const nextLimit = next.halfWidth[c] / std::abs(g);
+      double const reach = std::abs(slope[c]) * halfWidth[c];
+      if (std::abs(offset[c]) + reach > nextLimit) {
+        halfWidth[c] =
+          slope[c] == 0.0
+            ? (std::abs(offset[c]) <= nextLimit ? halfWidth[c] : -1.0)
+            : (nextLimit - std::abs(offset[c])) / std::abs(slope[c]);
+      }
+      offset[c] = next.slope[c] * g * offset[c] + next.offset[c];
+      slope[c] = next.slope[c] * g * slope[c];
+    }
+  }
+
+  bool isSameAs(AffineMap const& other) const
+  {
+    for (int c = 0; c < 2; ++c) {
+      if (slope[c] != other.slope[c] || offset[c] != other.offset[c] ||
+          halfWidth[c] != other.halfWidth[c]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @return the index of the first sample out of the range on either
+   * channel, or numSamples
+   */
+  int findFirstOutside(double const* const* input, int const numSamples) const
+  {
+    int first = numSamples;
+    for (int c = 0; c < 2; ++c) {
+      for (int i = 0; i < first; ++i) {
+        if (!(std::abs(input[c][i]) <= halfWidth[c])) {
+          first = i;
+          break;
+        }
+      }
+    }
+    return first;
+  }
+
+  void apply(double const* const* input,
+             double* const* output,
+             int const numSamples) const
+  {
+    for (int c = 0; c < 2; ++c) {
+      for (int i = 0; i < numSamples; ++i) {
+        output[c][i] = slope[c] * input[c][i] + offset[c];
+      }
+    }
+  }
+
+  void apply(VecBuffer<Vec2d>& io, int const numSamples) const
+  {
+    Vec2d const a = Vec2d().load(slope);
+    Vec2d const b = Vec2d().load(offset);
+    for (int i = 0; i < numSamples; ++i) {
+      Vec2d const x = io[i];
+      io[i] = a * x + b;
+    }
+  }
+};
+
+/**
+ * The last samples of a stereo signal, to bring a resampling path that was
+ * not running back to the state it would have if it had run.
+ */
+class SignalHistory final
+{
+public:
+  /**
+   * Takes the memory for length samples from an arena.
+   */
+  void carve(Arena& arena, int const newLength)
+  {
+    length = newLength;
+    for (auto& channel : memory) {
+      channel = arena.carve<double>(static_cast<size_t>(length));
+    }
+  }
+
+  void reset()
+  {
+    head = 0;
+    for (auto* channel : memory) {
+      if (channel) {
+        std::fill(channel, channel + length, 0.0);
+      }
+    }
+  }
+
+  int getLength() const { return memory[0] ? length : 0; }
+
+  void write(double const* const* input, int const numSamples)
+  {
+    int const skip = std::max(0, numSamples - length);
+    for (int i = skip; i < numSamples; ++i) {
+      memory[0][head] = input[0][i];
+      memory[1][head] = input[1][i];
+      head = head + 1 == length ? 0 : head + 1;
+    }
+  }
+
+  /**
+   * Reads numSamples samples from the one at begin, counting from the oldest.
+   */
+  void read(double* const* output, int const begin, int const numSamples) const
+  {
+    int position = (head + begin) % length;
+    for (int i = 0; i < numSamples; ++i) {
+      output[0][i] = memory[0][position];
+      output[1][i] = memory[1][position];
+      position = position + 1 == length ? 0 : position + 1;
+    }
+  }
+
+private:
+  double* memory[2] = { nullptr, nullptr };
+  int length = 0;
+  int head = 0;
+};
+
+} // namespace overdraw
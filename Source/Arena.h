@@ -0,0 +1,94 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace overdraw {
+
+/**
+ * A single aligned allocation carved into buffers.
+ * Carving is done by a function that is run twice by build(): once to
+ * measure, when every carve returns nullptr, and once on the allocated
+ * memory, so the layout is written only once and the buffers are contiguous,
+ * in carving order.
+ * The memory is zeroed on allocation, and it is released by release(), by
+ * the next build() or by the destructor.
+ */
+class Arena final
+{
+public:
+  static constexpr size_t alignment = 64;
+
+  Arena() = default;
+  ~Arena() { release(); }
+
+  Arena(Arena const&) = delete;
+  Arena& operator=(Arena const&) = delete;
+
+  template<class Carve>
+  void build(Carve&& carve)
+  {
+    release();
+    offset = 0;
+    carve(*this);
+    capacity = offset;
+    if (capacity > 0) {
+      memory = static_cast<char*>(
+        ::operator new[](capacity, std::align_val_t{ alignment }));
+      std::memset(memory, 0, capacity);
+    }
+    offset = 0;
+    carve(*this);
+  }
+
+  /**
+   * @return count aligned elements of T, or nullptr while measuring
+   */
+  template<class T>
+  T* carve(size_t count)
+  {
+    static_assert(alignof(T) <= alignment);
+    size_t const begin = (offset + alignment - 1) & ~(alignment - 1);
+    offset = begin + count * sizeof(T);
+    return memory ? reinterpret_cast<T*>(memory + begin) : nullptr;
+  }
+
+  size_t getCapacity() const { return capacity; }
+
+  void release()
+  {
+    if (memory) {
+      ::operator delete[](memory, std::align_val_t{ alignment });
+      memory = nullptr;
+    }
+    capacity = 0;
+  }
+
+private:
+  char* memory = nullptr;
+  size_t capacity = 0;
+  size_t offset = 0;
+};
+
+} // namespace overdraw
@@ -0,0 +1,156 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Crossover.h"
+#include <algorithm>
+#include <cmath>
+
+namespace overdraw {
+
+void
+Crossover::Split::reset()
+{
+  g = gTarget;
+  s1 = 0.0;
+  s2 = 0.0;
+  t1 = 0.0;
+  t2 = 0.0;
+  allpass1.fill(0.0);
+  allpass2.fill(0.0);
+}
+
+void
+Crossover::setTarget(int newNumBands,
+                     double const (*frequencies)[2],
+                     double sampleRate)
+{
+  constexpr double pi = 3.14159265358979323846;
+
+  newNumBands = std::clamp(newNumBands, 1, maxNumBands);
+
+  double lowerCutoff[2] = { 0.0, 0.0 };
+
+  for (int s = 0; s < newNumBands - 1; ++s) {
+    double g[2];
+    for (int c = 0; c < 2; ++c) {
+      double const cutoff =
+        std::clamp(frequencies[s][c], lowerCutoff[c], 0.49 * sampleRate);
+      g[c] = std::tan(pi * cutoff / sampleRate);
+      lowerCutoff[c] = cutoff;
+    }
+    splits[s].gTarget = Vec2d().load(g);
+    if (s >= numBands - 1) {
+      splits[s].reset();
+    }
+  }
+
+  numBands = newNumBands;
+}
+
+void
+Crossover::split(VecBuffer<Vec2d>& io,
+                 VecBuffer<Vec2d>* bands,
+                 double const alpha)
+{
+  constexpr double sqrt2 = 1.41421356237309504880;
+
+  int const numSamples = io.getNumSamples();
+  Vec2d const a = alpha;
+  Vec2d const k = sqrt2;
+  Vec4d const k4 = sqrt2;
+
+  for (int s = 0; s < numBands - 1; ++s) {
+    auto& split = splits[s];
+    auto& input = s == 0 ? io : bands[s - 1];
+    auto& high = bands[s];
+
+    Vec2d g = split.g;
+    Vec2d s1 = split.s1;
+    Vec2d s2 = split.s2;
+    Vec4d t1 = split.t1;
+    Vec4d t2 = split.t2;
+
+    for (int i = 0; i < numSamples; ++i) {
+      g = a * (g - split.gTarget) + split.gTarget;
+
+      Vec2d const a1 = 1.0 / (1.0 + g * (g + k));
+      Vec2d const a2 = g * a1;
+      Vec2d const a3 = g * a2;
+
+      Vec2d const v0 = input[i];
+      Vec2d const v3 = v0 - s2;
+      Vec2d const v1 = a1 * s1 + a2 * v3;
+      Vec2d const v2 = s2 + a2 * s1 + a3 * v3;
+      s1 = 2.0 * v1 - s1;
+      s2 = 2.0 * v2 - s2;
+
+      Vec4d const w0 = Vec4d(v2, v0 - k * v1 - v2);
+      Vec4d const w3 = w0 - t2;
+      Vec4d const w1 = Vec4d(a1, a1) * t1 + Vec4d(a2, a2) * w3;
+      Vec4d const w2 = t2 + Vec4d(a2, a2) * t1 + Vec4d(a3, a3) * w3;
+      t1 = 2.0 * w1 - t1;
+      t2 = 2.0 * w2 - t2;
+
+      input[i] = w2.get_low();
+      Vec4d const highPass = w0 - k4 * w1 - w2;
+      high[i] = highPass.get_high();
+
+      for (int b = 0; b < s; ++b) {
+        auto& band = b == 0 ? io : bands[b - 1];
+        Vec2d const x0 = band[i];
+        Vec2d const x3 = x0 - split.allpass2[b];
+        Vec2d const x1 = a1 * split.allpass1[b] + a2 * x3;
+        Vec2d const x2 = split.allpass2[b] + a2 * split.allpass1[b] + a3 * x3;
+        split.allpass1[b] = 2.0 * x1 - split.allpass1[b];
+        split.allpass2[b] = 2.0 * x2 - split.allpass2[b];
+        band[i] = x0 - 2.0 * k * x1;
+      }
+    }
+
+    split.g = g;
+    split.s1 = s1;
+    split.s2 = s2;
+    split.t1 = t1;
+    split.t2 = t2;
+  }
+}
+
+void
+Crossover::merge(VecBuffer<Vec2d>& io, VecBuffer<Vec2d>* bands) const
+{
+  int const numSamples = io.getNumSamples();
+  for (int b = 0; b < numBands - 1; ++b) {
+    auto& band = bands[b];
+    for (int i = 0; i < numSamples; ++i) {
+      Vec2d const x = io[i];
+      Vec2d const y = band[i];
+      io[i] = x + y;
+    }
+  }
+}
+
+void
+Crossover::reset()
+{
+  for (auto& split : splits) {
+    split.reset();
+  }
+}
+
+} // namespace overdraw
@@ -0,0 +1,99 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "avec/Avec.hpp"
+#include <array>
+
+namespace overdraw {
+
+/**
+ * A stereo Linkwitz-Riley crossover of up to maxNumBands bands, for the
+ * multiband mode, in the oversampled domain.
+ * Each split is a fourth order Linkwitz-Riley pair: a second order Butterworth
+ * section in the form of Svf, whose low-pass and high-pass outputs go through
+ * a second section each. The second sections share the coefficients, so they
+ * run side by side in a Vec4d. The splits form a chain, the high output of one
+ * feeding the next one, and the bands below a split go through the allpass
+ * response of that split, so that all the bands sum to the same allpass
+ * response, with flat magnitude.
+ * The cutoffs are smoothed sample by sample as in Svf.
+ */
+class Crossover final
+{
+public:
+  static constexpr int maxNumBands = 4;
+
+  Crossover() { AVEC_ASSERT_ALIGNMENT(this, Vec4d); }
+
+  /**
+   * Sets the cutoffs to smooth toward. A split that is switched on starts
+   * from them, with cleared state.
+   * @param numBands the number of bands, from 1 to maxNumBands
+   * @param frequencies the cutoff of each split and channel, in Hz. Each
+   * cutoff is kept above the one of the split below.
+   * @param sampleRate the rate at which the crossover runs
+   */
+  void setTarget(int numBands,
+                 double const (*frequencies)[2],
+                 double sampleRate);
+
+  int getNumBands() const { return numBands; }
+
+  /**
+   * Splits io in the bands, from the lowest to the highest: the lowest one
+   * stays in io, the others go to bands[0] to bands[getNumBands() - 2], which
+   * must hold as many samples as io.
+   */
+  void split(VecBuffer<Vec2d>& io, VecBuffer<Vec2d>* bands, double alpha);
+
+  /**
+   * Sums the bands given by split back into io.
+   */
+  void merge(VecBuffer<Vec2d>& io, VecBuffer<Vec2d>* bands) const;
+
+  /**
+   * Clears the state and jumps to the target cutoffs.
+   */
+  void reset();
+
+private:
+  struct Split final
+  {
+    Vec2d g = 0.0;
+    Vec2d gTarget = 0.0;
+    // the first section
+    Vec2d s1 = 0.0;
+    Vec2d s2 = 0.0;
+    // the second sections, low-pass in the lower half, high-pass in the upper
+    Vec4d t1 = 0.0;
+    Vec4d t2 = 0.0;
+    // the allpass sections of the bands below the split
+    std::array<Vec2d, maxNumBands - 2> allpass1;
+    std::array<Vec2d, maxNumBands - 2> allpass2;
+
+    void reset();
+  };
+
+  std::array<Split, maxNumBands - 1> splits;
+  int numBands = 1;
+};
+
+} // namespace overdraw
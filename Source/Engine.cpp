@@ -0,0 +1,1643 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Engine.h"
+#include "Ramp.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace overdraw {
+
+namespace {
+
+constexpr double twoPi = 6.283185307179586476925;
+
+double
+dbToGain(double const db)
+{
+  constexpr double ln10 = 2.30258509299404568402;
+  return std::exp(ln10 / 20.0 * db);
+}
+
+double
+getSmoothingAlpha(double const smoothingTime, double const sampleRate)
+{
+  return smoothingTime <= 0.0 ? 0.0
+                              : std::exp(-twoPi / (sampleRate * smoothingTime));
+}
+
+void
+leftRightToMidSide(double* const* io, int const n)
+{
+  for (int i = 0; i < n; ++i) {
+    double m = 0.5 * (io[0][i] + io[1][i]);
+    double s = 0.5 * (io[0][i] - io[1][i]);
+    io[0][i] = m;
+    io[1][i] = s;
+  }
+}
+
+void
+midSideToLeftRight(double* const* io, int const n)
+{
+  for (int i = 0; i < n; ++i) {
+    double l = io[0][i] + io[1][i];
+    double r = io[0][i] - io[1][i];
+    io[0][i] = l;
+    io[1][i] = r;
+  }
+}
+
+void
+interleave(double const* const* input, VecBuffer<Vec2d>& output, int const n)
+{
+  output.setNumSamples(n);
+  for (int i = 0; i < n; ++i) {
+    output[i] = Vec2d(input[0][i], input[1][i]);
+  }
+}
+
+void
+deinterleave(VecBuffer<Vec2d>& input, double* const* output, int const n)
+{
+  for (int i = 0; i < n; ++i) {
+    Vec2d const x = input[i];
+    output[0][i] = x[0];
+    output[1][i] = x[1];
+  }
+}
+
+// Mono fast path: when the two channels of the upsampled signal are equal, or
+// the side channel is silent, consecutive samples of the first channel are
+// packed in the two lanes of each Vec2d, so the splines process half the
+// vectors. The channels must have the same settings, which the caller checks.
+
+enum class MonoPacking
+{
+  none,
+  identical,
+  silentSide
+};
+
+MonoPacking
+getMonoPacking(VecBuffer<Vec2d>& io, int const n, bool const canSilenceSide)
+{
+  bool isIdentical = true;
+  bool isSideSilent = canSilenceSide;
+  for (int i = 0; i < n && (isIdentical || isSideSilent); ++i) {
+    Vec2d const x = io[i];
+    isIdentical = isIdentical && x[0] == x[1];
+    isSideSilent = isSideSilent && x[1] == 0.0;
+  }
+  return isIdentical    ? MonoPacking::identical
+         : isSideSilent ? MonoPacking::silentSide
+                        : MonoPacking::none;
+}
+
+void
+packMono(VecBuffer<Vec2d>& input, VecBuffer<Vec2d>& packed, int const n)
+{
+  packed.setNumSamples((n + 1) / 2);
+  for (int i = 0; i < n / 2; ++i) {
+    Vec2d const a = input[2 * i];
+    Vec2d const b = input[2 * i + 1];
+    packed[i] = blend2<0, 2>(a, b);
+  }
+  if (n % 2 == 1) {
+    Vec2d const a = input[n - 1];
+    packed[n / 2] = permute2<0, 0>(a);
+  }
+}
+
+void
+unpackMono(VecBuffer<Vec2d>& packed,
+           VecBuffer<Vec2d>& output,
+           int const n,
+           MonoPacking const packing)
+{
+  bool const isSideSilent = packing == MonoPacking::silentSide;
+  for (int i = 0; i < n / 2; ++i) {
+    Vec2d const y = packed[i];
+    output[2 * i] = isSideSilent ? blend2<0, -1>(y, y) : permute2<0, 0>(y);
+    output[2 * i + 1] = isSideSilent ? blend2<1, -1>(y, y) : permute2<1, 1>(y);
+  }
+  if (n % 2 == 1) {
+    Vec2d const y = packed[n / 2];
+    output[n - 1] = isSideSilent ? blend2<0, -1>(y, y) : permute2<0, 0>(y);
+  }
+}
+
+// The latency of the oversimple oversamplers at each order and phase, which
+// depends on nothing else in the settings of the engines: it is measured once,
+// instead of building an oversampler for it on each prepare.
+int
+getOversimpleLatency(oversimple::OversamplingSettings const& settings,
+                     int const order,
+                     bool const isLinearPhase)
+{
+  constexpr int numOrders = Engine::numOversamplingOrders;
+  static auto const latencies = [&] {
+    std::array<std::array<int, numOrders>, 2> table{};
+    for (int phase = 0; phase < 2; ++phase) {
+      for (int i = 0; i < numOrders; ++i) {
+        auto orderSettings = settings;
+        orderSettings.order = i;
+        orderSettings.isUsingLinearPhase = phase == 1;
+        table[phase][i] = static_cast<int>(
+          oversimple::TOversampling<double>(orderSettings).getLatency());
+      }
+    }
+    return table;
+  }();
+  return latencies[isLinearPhase ? 1 : 0][order];
+}
+
+inline Vec2d
+toDB(Vec2d linear)
+{
+  return (10.0 / 2.30258509299404568402) *
+         log(linear + std::numeric_limits<float>::min());
+}
+
+} // namespace
+
+Engine::Parameters::Parameters()
+{
+  for (auto& spline : isSymmetric) {
+    spline[0] = spline[1] = true;
+  }
+  for (int c = 0; c < 2; ++c) {
+    filters[0].frequency[c] = 100.0;
+    filters[1].frequency[c] = 8000.0;
+  }
+  // 16x and 32x, where the direct linear-phase FIRs are the most expensive
+  for (int order = 0; order < numOversamplingOrders; ++order) {
+    linearPhaseEngines[order] = order >= 4 ? LinearPhaseEngine::partitionedFft
+                                           : LinearPhaseEngine::directFir;
+  }
+}
+
+Engine::Engine()
+  : oversamplingSettings([] {
+    auto s = oversimple::OversamplingSettings{};
+    s.numUpSampledChannels = 2;
+    s.numDownSampledChannels = 2;
+    s.upSampleOutputBufferType = oversimple::BufferType::interleaved;
+    s.downSampleInputBufferType = oversimple::BufferType::interleaved;
+    s.downSampleOutputBufferType = oversimple::BufferType::interleaved;
+    s.order = 1;
+    s.isUsingLinearPhase = false;
+    return s;
+  }())
+{
+  buildOversamplers();
+
+  for (auto* waveshaperArray : { &waveshapers, &fadingWaveshapers }) {
+    for (auto& waveshaper : *waveshaperArray) {
+      waveshaper = Aligned<Dsp>::make();
+    }
+  }
+  for (auto* filterArray : { &filters, &fadingFilters }) {
+    for (auto& filter : *filterArray) {
+      filter = Aligned<Svf>::make();
+    }
+  }
+  crossover = Aligned<Crossover>::make();
+  fadingCrossover = Aligned<Crossover>::make();
+
+  dryTask.engine = this;
+
+  // every spline starts as the identity
+  for (int s = 0; s < numSplines; ++s) {
+    for (int k = 0; k < 3; ++k) {
+      for (int c = 0; c < 2; ++c) {
+        waveshapers[s]->setKnot(k, c, k - 1.0, k - 1.0, 1.0, 1.0);
+      }
+    }
+    numKnots[s] = 3;
+  }
+}
+
+Engine::~Engine() = default;
+
+void
+Engine::buildOversamplers()
+{
+  signalOversampling =
+    std::make_unique<oversimple::TOversampling<double>>(oversamplingSettings);
+  dryOversampling =
+    std::make_unique<oversimple::TOversampling<double>>(oversamplingSettings);
+  if (isPrepared()) {
+    auto const maxIn = static_cast<uint32_t>(maxNumSamples);
+    signalOversampling->prepareBuffers(maxIn);
+    dryOversampling->prepareBuffers(maxIn);
+  }
+}
+
+void
+Engine::prepare(double const newSampleRate, int const newMaxNumSamples)
+{
+  sampleRate = newSampleRate;
+  maxNumSamples = std::max(1, newMaxNumSamples);
+
+  auto const maxIn = static_cast<uint32_t>(maxNumSamples);
+  oversamplingSettings.maxNumInputSamples = maxIn;
+  signalOversampling->prepareBuffers(maxIn);
+  dryOversampling->prepareBuffers(maxIn);
+
+  configureFftOversampling();
+
+  arena.build([&](Arena& a) {
+    carveBuffers(a);
+    for (int order = 1; order < numOversamplingOrders; ++order) {
+      if (isFftOrderConfigured[order]) {
+        signalFftOversampling[order]->carve(a);
+        dryFftOversampling[order]->carve(a);
+      }
+    }
+  });
+
+  for (int order = 1; order < numOversamplingOrders; ++order) {
+    if (isFftOrderConfigured[order]) {
+      signalFftOversampling[order]->initialize();
+      dryFftOversampling[order]->initialize();
+    }
+  }
+
+  activeFftOversamplingOrder = -1;
+
+  if (isAdaptiveBuilt) {
+    buildAdaptiveOversamplers();
+  }
+
+  // the bands and the wide spline kernel at the highest oversampling factor,
+  // so that setOversampling does not need them again. The waveshapers run one
+  // after the other, so they all use the buffers of the first one.
+  int const maxNumUpsampledSamples = getMaxNumUpsampledSamples();
+  for (auto& band : bandBuffers) {
+    band = VecBuffer<Vec2d>{ maxNumUpsampledSamples };
+  }
+  auto& bufferOwner = *waveshapers[0];
+  bufferOwner.prepare(maxNumUpsampledSamples);
+  for (auto* waveshaperArray : { &waveshapers, &fadingWaveshapers }) {
+    for (auto& waveshaper : *waveshaperArray) {
+      if (waveshaper.get() != &bufferOwner) {
+        waveshaper->prepare(bufferOwner);
+      }
+    }
+  }
+
+  reset();
+}
+
+void
+Engine::configureFftOversampling()
+{
+  auto const maxIn = static_cast<uint32_t>(maxNumSamples);
+
+  // each FFT engine gets the latency of the direct linear-phase FIRs of its
+  // order, so that switching engine does not change the latency
+  maxOversamplingLatency = 0;
+  for (int order = 1; order < numOversamplingOrders; ++order) {
+    int const latency =
+      getOversimpleLatency(oversamplingSettings, order, true);
+    maxOversamplingLatency =
+      std::max({ maxOversamplingLatency,
+                 latency,
+                 getOversimpleLatency(oversamplingSettings, order, false) });
+    isFftOrderConfigured[order] = true;
+    for (auto* engines : { &signalFftOversampling, &dryFftOversampling }) {
+      auto& engine = (*engines)[order];
+      if (!engine) {
+        engine = std::make_unique<FftOversampling>();
+      }
+      isFftOrderConfigured[order] =
+        engine->configure(
+          1u << order, maxIn, static_cast<uint32_t>(latency)) &&
+        isFftOrderConfigured[order];
+    }
+  }
+}
+
+void
+Engine::carveBuffers(Arena& a)
+{
+  auto const n = static_cast<size_t>(maxNumSamples);
+  for (int c = 0; c < 2; ++c) {
+    dryBuffer[c] = a.carve<double>(n);
+  }
+  for (int c = 0; c < 2; ++c) {
+    scratch[c] = a.carve<double>(n);
+  }
+  for (auto* compensation : { &wetCompensation, &dryCompensation }) {
+    for (auto& delay : *compensation) {
+      delay.carve(a, maxOversamplingLatency);
+    }
+  }
+  for (auto* buffer : { affineScratch, affineWetOutput, affineDryOutput }) {
+    for (int c = 0; c < 2; ++c) {
+      buffer[c] = a.carve<double>(n);
+    }
+  }
+  affineWetDelay.carve(a, maxOversamplingLatency);
+  affineDryDelay.carve(a, maxOversamplingLatency);
+  int const historyLength = 2 * maxOversamplingLatency + affineHistoryMargin;
+  wetHistory.carve(a, historyLength);
+  dryHistory.carve(a, historyLength);
+}
+
+void
+Engine::release()
+{
+  for (auto* engines : { &signalFftOversampling, &dryFftOversampling }) {
+    for (auto& engine : *engines) {
+      engine.reset();
+    }
+  }
+  isFftOrderConfigured = {};
+  for (auto* oversamplers :
+       { &adaptiveSignalOversampling, &adaptiveDryOversampling }) {
+    for (auto& phase : *oversamplers) {
+      for (auto& oversampling : phase) {
+        oversampling.reset();
+      }
+    }
+  }
+  isAdaptiveBuilt = false;
+  wetCompensation = {};
+  dryCompensation = {};
+  affineWetDelay = {};
+  affineDryDelay = {};
+  wetHistory = {};
+  dryHistory = {};
+  for (auto& band : bandBuffers) {
+    band = VecBuffer<Vec2d>{ 0 };
+  }
+  arena.release();
+  maxNumSamples = 0;
+  dryBuffer[0] = dryBuffer[1] = nullptr;
+  scratch[0] = scratch[1] = nullptr;
+  affineScratch[0] = affineScratch[1] = nullptr;
+  affineWetOutput[0] = affineWetOutput[1] = nullptr;
+  affineDryOutput[0] = affineDryOutput[1] = nullptr;
+}
+
+void
+Engine::setOversampling(int const order, bool const isLinearPhase)
+{
+  oversamplingSettings.order =
+    static_cast<uint32_t>(std::clamp(order, 0, numOversamplingOrders - 1));
+  oversamplingSettings.isUsingLinearPhase = isLinearPhase;
+  buildOversamplers();
+}
+
+void
+Engine::buildAdaptiveOversamplers()
+{
+  if (!isPrepared()) {
+    return;
+  }
+  auto const maxIn = static_cast<uint32_t>(maxNumSamples);
+  for (int phase = 0; phase < 2; ++phase) {
+    for (int order = 0; order < numOversamplingOrders - 1; ++order) {
+      auto settings = oversamplingSettings;
+      settings.order = order;
+      settings.isUsingLinearPhase = phase == 1;
+      settings.maxNumInputSamples = maxIn;
+      // the linear-phase orders above 1x run on the FFT engines
+      bool const isOnFftEngines = phase == 1 && order > 0;
+      for (auto* oversamplers :
+           { &adaptiveSignalOversampling, &adaptiveDryOversampling }) {
+        auto& oversampling = (*oversamplers)[phase][order];
+        if (isOnFftEngines) {
+          oversampling.reset();
+          continue;
+        }
+        if (!oversampling) {
+          oversampling =
+            std::make_unique<oversimple::TOversampling<double>>(settings);
+        }
+        oversampling->prepareBuffers(maxIn);
+      }
+    }
+  }
+  isAdaptiveBuilt = true;
+}
+
+int
+Engine::getLatency() const
+{
+  return signalOversampling
+           ? static_cast<int>(signalOversampling->getLatency())
+           : 0;
+}
+
+void
+Engine::setKnot(int const spline,
+                int const knot,
+                int const channel,
+                double const x,
+                double const y,
+                double const tangent,
+                double const smoothness)
+{
+  waveshapers[spline]->setKnot(knot, channel, x, y, tangent, smoothness);
+}
+
+void
+Engine::setNumKnots(int const spline, int const newNumKnots)
+{
+  numKnots[spline] = std::clamp(newNumKnots, 0, maxNumKnots);
+}
+
+bool
+Engine::isWetSilent() const
+{
+  return parameters.wet[0] <= 0.0 && parameters.wet[1] <= 0.0 &&
+         wetAmount[0] == 0.0 && wetAmount[1] == 0.0;
+}
+
+Engine::MemoryFootprint
+Engine::getMemoryFootprint() const
+{
+  MemoryFootprint footprint;
+
+  footprint.arena = arena.getCapacity();
+
+  for (auto const* engines : { &signalFftOversampling, &dryFftOversampling }) {
+    for (auto const& engine : *engines) {
+      if (engine) {
+        footprint.fftOversamplingBuffers += engine->getBufferMemory();
+      }
+    }
+  }
+
+  // up and down sampling output, two channels, two oversamplers
+  size_t const factor = size_t{ 1 } << oversamplingSettings.order;
+  footprint.oversamplingBuffers = 2 * 2 * sizeof(double) *
+                                  static_cast<size_t>(maxNumSamples) *
+                                  (factor + 1);
+
+  // and the same for the oversamplers of adaptive oversampling that are not
+  // on the FFT engines
+  for (auto const& phase : adaptiveSignalOversampling) {
+    for (int order = 0; order < numOversamplingOrders - 1; ++order) {
+      if (phase[order]) {
+        footprint.oversamplingBuffers += 2 * 2 * sizeof(double) *
+                                         static_cast<size_t>(maxNumSamples) *
+                                         ((size_t{ 1 } << order) + 1);
+      }
+    }
+  }
+
+  footprint.engineBuffers = sizeof(Vec2d) * bandBuffers.size() *
+                            static_cast<size_t>(getMaxNumUpsampledSamples());
+
+  for (auto const* waveshaperArray : { &waveshapers, &fadingWaveshapers }) {
+    for (auto const& waveshaper : *waveshaperArray) {
+      footprint.splineBuffers += waveshaper->getBufferMemory();
+    }
+  }
+
+  return footprint;
+}
+
+void
+Engine::reset()
+{
+  auto const& p = parameters;
+
+  for (int s = 0; s < numSplines; ++s) {
+    auto& waveshaper = *waveshapers[s];
+    for (int c = 0; c < 2; ++c) {
+      waveshaper.setIsSymmetric(c, p.isSymmetric[s][c]);
+    }
+    waveshaper.reset();
+    waveshaper.gain = Vec2d(dbToGain(p.splineGain[s][0]),
+                            dbToGain(p.splineGain[s][1]));
+  }
+
+  for (int c = 0; c < 2; ++c) {
+    gain[0][c] = dbToGain(p.inputGain[c]);
+    gain[1][c] = dbToGain(p.outputGain[c]);
+    wetAmount[c] = 0.01 * std::clamp(p.wet[c], 0.0, 100.0);
+  }
+
+  numActiveStages = std::clamp(p.numStages, 1, maxNumStages);
+  numActiveBands = std::clamp(p.numBands, 1, maxNumBands);
+
+  std::fill(std::begin(vuMeterState), std::end(vuMeterState), 0.0);
+
+  if (!isPrepared()) {
+    return;
+  }
+
+  double const upsampledSampleRate =
+    sampleRate * signalOversampling->getOversamplingRate();
+
+  setFilterTargets(filters, upsampledSampleRate);
+  for (auto& filter : filters) {
+    filter->reset();
+  }
+
+  setCrossoverTarget(*crossover, numActiveBands, upsampledSampleRate);
+  crossover->reset();
+
+  signalOversampling->reset();
+  dryOversampling->reset();
+  for (auto* engines : { &signalFftOversampling, &dryFftOversampling }) {
+    for (auto& engine : *engines) {
+      if (engine) {
+        engine->reset();
+      }
+    }
+  }
+
+  // adaptive oversampling starts over from the order of the settings
+  mainOrder = -1;
+
+  int const latency = getLatency();
+
+  affineWetDelay.reset(latency);
+  affineDryDelay.reset(latency);
+  wetHistory.reset();
+  dryHistory.reset();
+  affineMix = 0.0;
+  affineFadeOutStep = 0.0;
+  affineQuietSamples = 0;
+  affineCalmSamples = 0;
+  isIdle = false;
+  isPreRolling = false;
+  preRollBacklog = 0;
+}
+
+void
+Engine::process(double* const* io, int const numSamples)
+{
+  if (!isPrepared()) {
+    return;
+  }
+  for (int offset = 0; offset < numSamples; offset += maxNumSamples) {
+    double* chunk[2] = { io[0] + offset, io[1] + offset };
+    processBlock(chunk, std::min(maxNumSamples, numSamples - offset));
+  }
+}
+
+void
+Engine::process(float* const* io, int const numSamples)
+{
+  if (!isPrepared()) {
+    return;
+  }
+  for (int offset = 0; offset < numSamples; offset += maxNumSamples) {
+    int const n = std::min(maxNumSamples, numSamples - offset);
+    for (int c = 0; c < 2; ++c) {
+      std::copy(io[c] + offset, io[c] + offset + n, scratch[c]);
+    }
+    processBlock(scratch, n);
+    for (int c = 0; c < 2; ++c) {
+      for (int i = 0; i < n; ++i) {
+        io[c][offset + i] = static_cast<float>(scratch[c][i]);
+      }
+    }
+  }
+}
+
+void
+Engine::processInterleaved(double* io, int const numSamples)
+{
+  if (!isPrepared()) {
+    return;
+  }
+  for (int offset = 0; offset < numSamples; offset += maxNumSamples) {
+    int const n = std::min(maxNumSamples, numSamples - offset);
+    double* frames = io + 2 * offset;
+    for (int i = 0; i < n; ++i) {
+      scratch[0][i] = frames[2 * i];
+      scratch[1][i] = frames[2 * i + 1];
+    }
+    processBlock(scratch, n);
+    for (int i = 0; i < n; ++i) {
+      frames[2 * i] = scratch[0][i];
+      frames[2 * i + 1] = scratch[1][i];
+    }
+  }
+}
+
+void
+Engine::processInterleaved(float* io, int const numSamples)
+{
+  if (!isPrepared()) {
+    return;
+  }
+  for (int offset = 0; offset < numSamples; offset += maxNumSamples) {
+    int const n = std::min(maxNumSamples, numSamples - offset);
+    float* frames = io + 2 * offset;
+    for (int i = 0; i < n; ++i) {
+      scratch[0][i] = frames[2 * i];
+      scratch[1][i] = frames[2 * i + 1];
+    }
+    processBlock(scratch, n);
+    for (int i = 0; i < n; ++i) {
+      frames[2 * i] = static_cast<float>(scratch[0][i]);
+      frames[2 * i + 1] = static_cast<float>(scratch[1][i]);
+    }
+  }
+}
+
+void
+Engine::setFilterTargets(Filters& filtersToSet,
+                         double const upsampledSampleRate)
+{
+  if (upsampledSampleRate <= 0.0) {
+    return;
+  }
+  for (int i = 0; i < 2; ++i) {
+    auto const& filter = parameters.filters[i];
+    filtersToSet[i]->setTarget(filter.type,
+                               filter.frequency,
+                               filter.q,
+                               filter.gain,
+                               upsampledSampleRate);
+  }
+}
+
+void
+Engine::setCrossoverTarget(Crossover& crossoverToSet,
+                           int const numBands,
+                           double const upsampledSampleRate)
+{
+  if (upsampledSampleRate <= 0.0) {
+    return;
+  }
+  crossoverToSet.setTarget(
+    numBands, parameters.crossover, upsampledSampleRate);
+}
+
+void
+Engine::ResamplingPath::reset()
+{
+  if (signalFft) {
+    signalFft->reset();
+    dryFft->reset();
+  }
+  else {
+    signal->reset();
+    dry->reset();
+  }
+}
+
+void
+Engine::ResamplingPath::resampleDry(double* const* input,
+                                    uint32_t const numSamples)
+{
+  if (dryFft) {
+    dryFft->prepareBuffers(numSamples);
+    dryFft->upSample(input, numSamples);
+    dryFft->downSample(dryFft->getUpSampleOutput(), numSamples);
+  }
+  else {
+    dry->prepareBuffers(numSamples);
+    dry->upSample(input, numSamples);
+    dry->downSample(dry->getUpSampleOutputInterleaved(), numSamples);
+  }
+}
+
+uint32_t
+Engine::ResamplingPath::upSample(double* const* input,
+                                 uint32_t const numSamples)
+{
+  if (signalFft) {
+    signalFft->prepareBuffers(numSamples);
+    return signalFft->upSample(input, numSamples);
+  }
+  signal->prepareBuffers(numSamples);
+  return signal->upSample(input, numSamples);
+}
+
+void
+Engine::ResamplingPath::downSample(uint32_t const numSamples)
+{
+  if (signalFft) {
+    signalFft->downSample(signalFft->getUpSampleOutput(), numSamples);
+  }
+  else {
+    signal->downSample(signal->getUpSampleOutputInterleaved(), numSamples);
+  }
+}
+
+bool
+Engine::isFftOversamplingReady(int const order) const
+{
+  auto const& engine = signalFftOversampling[order];
+  return engine && engine->isPrepared() &&
+         dryFftOversampling[order]->isPrepared();
+}
+
+int
+Engine::getFftOversamplingOrder() const
+{
+  int const order = static_cast<int>(oversamplingSettings.order);
+  if (!oversamplingSettings.isUsingLinearPhase || order < 1 ||
+      order >= numOversamplingOrders) {
+    return -1;
+  }
+  if (parameters.linearPhaseEngines[order] !=
+      LinearPhaseEngine::partitionedFft) {
+    return -1;
+  }
+  return isFftOversamplingReady(order) ? order : -1;
+}
+
+Engine::ResamplingPath
+Engine::getResamplingPath(int const order, int const fftOrder)
+{
+  if (order == mainOrder) {
+    ResamplingPath mainPath{ signalOversampling.get(), dryOversampling.get() };
+    if (fftOrder > 0) {
+      mainPath.signalFft = signalFftOversampling[fftOrder].get();
+      mainPath.dryFft = dryFftOversampling[fftOrder].get();
+    }
+    return mainPath;
+  }
+  // with linear phase, the FFT engines of the orders below the main one are
+  // free for adaptive oversampling, see buildAdaptiveOversamplers
+  if (isMainLinearPhase && order > 0) {
+    return { nullptr,
+             nullptr,
+             signalFftOversampling[order].get(),
+             dryFftOversampling[order].get() };
+  }
+  int const phase = isMainLinearPhase ? 1 : 0;
+  return { adaptiveSignalOversampling[phase][order].get(),
+           adaptiveDryOversampling[phase][order].get() };
+}
+
+int
+Engine::getLatencyPadding(int const order) const
+{
+  if (order == mainOrder) {
+    return 0;
+  }
+  if (isMainLinearPhase && order > 0 && !isFftOversamplingReady(order)) {
+    return -1;
+  }
+  int const phase = isMainLinearPhase ? 1 : 0;
+  auto const pathLatency =
+    isMainLinearPhase && order > 0
+      ? signalFftOversampling[order]->getLatency()
+      : adaptiveSignalOversampling[phase][order]->getLatency();
+  int const padding = getLatency() - static_cast<int>(pathLatency);
+  return padding >= 0 && padding <= maxOversamplingLatency ? padding : -1;
+}
+
+void
+Engine::updateAdaptiveOversampling()
+{
+  int const order = getOversamplingOrder();
+  bool const isLinearPhase = isUsingLinearPhase();
+  bool const isOn = parameters.adaptiveOrder >= 0 && isAdaptiveBuilt;
+
+  // on a change of the oversampling settings, their order is used right away
+
+  if (order != mainOrder || isLinearPhase != isMainLinearPhase) {
+    bool const isAdapting = activeOrder != mainOrder || fadingOrder >= 0;
+    mainOrder = order;
+    isMainLinearPhase = isLinearPhase;
+    if (isAdapting) {
+      getResamplingPath(order, activeFftOversamplingOrder).reset();
+    }
+    activeOrder = order;
+    fadingOrder = -1;
+    wetCompensation[0].reset(0);
+    dryCompensation[0].reset(0);
+  }
+
+  // otherwise, a switch waits for the previous one to end; without adaptive
+  // oversampling, the path goes back to the order of the settings
+
+  if (fadingOrder >= 0) {
+    return;
+  }
+
+  int const newOrder =
+    isOn ? std::min(parameters.adaptiveOrder, mainOrder) : mainOrder;
+  if (newOrder == activeOrder) {
+    return;
+  }
+
+  // an order with more latency than the main one is refused, the caller sees
+  // it from getOversamplingOrderInUse
+  int const padding = getLatencyPadding(newOrder);
+  if (padding < 0) {
+    return;
+  }
+
+  beginPathSwitch(newOrder, padding);
+  getResamplingPath(activeOrder, activeFftOversamplingOrder).reset();
+}
+
+// Linear-phase oversampling may run on the partitioned FFT engines. At the
+// same order, a switch between them and the direct FIRs crossfades the two
+// paths as adaptive oversampling does, without padding as they have the same
+// latency, and waits for a switch or a pre-roll in progress to end. On a
+// change of the oversampling settings, or while the main path is not in use,
+// the engine takes over right away, reset as oversimple does on a change of
+// settings.
+void
+Engine::updateFftOversampling()
+{
+  int const fftOrder = getFftOversamplingOrder();
+  if (fftOrder == activeFftOversamplingOrder) {
+    return;
+  }
+
+  bool const isSettingChanged = getOversamplingOrder() != mainOrder ||
+                                isUsingLinearPhase() != isMainLinearPhase;
+  if (!isSettingChanged && (fadingOrder >= 0 || isPreRolling)) {
+    return;
+  }
+
+  bool const isCrossfading =
+    !isSettingChanged && !isIdle && activeOrder == mainOrder;
+  if (isCrossfading) {
+    beginPathSwitch(mainOrder, 0);
+  }
+
+  activeFftOversamplingOrder = fftOrder;
+
+  if (isCrossfading) {
+    getResamplingPath(mainOrder, fftOrder).reset();
+  }
+  else if (fftOrder > 0) {
+    signalFftOversampling[fftOrder]->reset();
+    dryFftOversampling[fftOrder]->reset();
+  }
+}
+
+// the outgoing path keeps its latency compensation and a copy of the
+// waveshapers, of the filters and of the crossover, the incoming one is reset
+// by the caller
+void
+Engine::beginPathSwitch(int const newOrder, int const padding)
+{
+  fadingOrder = activeOrder;
+  fadingFftOversamplingOrder = activeFftOversamplingOrder;
+  activeOrder = newOrder;
+  transitionPosition = 0;
+
+  std::swap(wetCompensation[0], wetCompensation[1]);
+  std::swap(dryCompensation[0], dryCompensation[1]);
+  wetCompensation[0].reset(padding);
+  dryCompensation[0].reset(padding);
+
+  for (int s = 0; s < numSplines; ++s) {
+    fadingWaveshapers[s]->copyStateFrom(*waveshapers[s]);
+  }
+  for (int i = 0; i < 2; ++i) {
+    *fadingFilters[i] = *filters[i];
+  }
+  *fadingCrossover = *crossover;
+}
+
+void
+Engine::waveshape(Waveshapers& pathWaveshapers,
+                  VecBuffer<Vec2d>& io,
+                  Crossover& pathCrossover,
+                  double const sampleAlpha,
+                  int const samplesPerVector)
+{
+  auto const& splineGainTarget = pending.splineGainTarget;
+  double const alpha =
+    samplesPerVector == 1 ? sampleAlpha : sampleAlpha * sampleAlpha;
+
+  auto& firstStage = *pathWaveshapers[0];
+  firstStage.setSmoothingAlpha(sampleAlpha, samplesPerVector);
+
+  if (numActiveBands > 1) {
+    for (int b = 0; b < numActiveBands - 1; ++b) {
+      bandBuffers[b].setNumSamples(io.getNumSamples());
+    }
+    pathCrossover.split(io, bandBuffers.data(), alpha);
+    firstStage.waveshape(io, numKnots[0]);
+    for (int b = 1; b < numActiveBands; ++b) {
+      int const s = getBandSpline(b);
+      auto& band = bandBuffers[b - 1];
+      auto& waveshaper = *pathWaveshapers[s];
+      waveshaper.setSmoothingAlpha(sampleAlpha, samplesPerVector);
+      waveshaper.applyGain(band, Vec2d().load(splineGainTarget[s]), alpha);
+      waveshaper.waveshape(band, numKnots[s]);
+    }
+    pathCrossover.merge(io, bandBuffers.data());
+  }
+  else {
+    firstStage.waveshape(io, numKnots[0]);
+  }
+
+  for (int s = 1; s < numActiveStages; ++s) {
+    auto& waveshaper = *pathWaveshapers[s];
+    waveshaper.setSmoothingAlpha(sampleAlpha, samplesPerVector);
+    waveshaper.applyGain(io, Vec2d().load(splineGainTarget[s]), alpha);
+    waveshaper.waveshape(io, numKnots[s]);
+  }
+}
+
+void
+Engine::processBlock(double* const* io, int const numSamples)
+{
+  if (beginBlock(io, numSamples)) {
+    waveshape(
+      waveshapers, getUpsampledIo(), *crossover, pending.upsampledAlpha, 1);
+  }
+  endBlock();
+}
+
+bool
+Engine::beginBlock(double* const* io, int const numSamples)
+{
+  auto const& p = parameters;
+
+  double const smoothingTime = 0.001 * p.smoothingTime;
+  double const alpha = getSmoothingAlpha(smoothingTime, sampleRate);
+
+  pending.io[0] = io[0];
+  pending.io[1] = io[1];
+  pending.numSamples = numSamples;
+  pending.smoothingTime = smoothingTime;
+  pending.alpha = alpha;
+  pending.isMidSideEnabled = p.isMidSideEnabled;
+  pending.isWetPending = false;
+
+  auto& gainTarget = pending.gainTarget;
+  auto& wetAmountTarget = pending.wetAmountTarget;
+  auto& splineGainTarget = pending.splineGainTarget;
+
+  for (int c = 0; c < 2; ++c) {
+    gainTarget[0][c] = dbToGain(p.inputGain[c]);
+    gainTarget[1][c] = dbToGain(p.outputGain[c]);
+    wetAmountTarget[c] = 0.01 * std::clamp(p.wet[c], 0.0, 100.0);
+  }
+
+  for (int s = 0; s < numSplines; ++s) {
+    for (int c = 0; c < 2; ++c) {
+      splineGainTarget[s][c] = dbToGain(p.splineGain[s][c]);
+      waveshapers[s]->setIsSymmetric(c, p.isSymmetric[s][c]);
+    }
+    waveshapers[s]->setControlRateAutomation(
+      p.isControlRateAutomationEnabled);
+  }
+
+  int const numStages = std::clamp(p.numStages, 1, maxNumStages);
+  for (int s = numActiveStages; s < numStages; ++s) {
+    activateSpline(s);
+  }
+  numActiveStages = numStages;
+
+  int const numBands = std::clamp(p.numBands, 1, maxNumBands);
+  for (int b = numActiveBands; b < numBands; ++b) {
+    activateSpline(getBandSpline(b));
+  }
+  numActiveBands = numBands;
+
+  // a silent side channel stays silent only through symmetric curves
+
+  pending.canSilenceSide = [&] {
+    if (!p.isMidSideEnabled) {
+      return false;
+    }
+    for (int s = 0; s < numStages; ++s) {
+      if (!p.isSymmetric[s][1]) {
+        return false;
+      }
+    }
+    return true;
+  }();
+
+  bool const isWetPassNeeded = [&] {
+    double m =
+      wetAmountTarget[0] * wetAmountTarget[1] * wetAmount[0] * wetAmount[1];
+    if (m == 1.0) {
+      return false;
+    }
+    if (m == 0.0) {
+      return !(wetAmountTarget[0] == 0.0 && wetAmountTarget[1] == 0.0 &&
+               wetAmount[0] == 0.0 && wetAmount[1] == 0.0);
+    }
+    return true;
+  }();
+
+  pending.isWetPassNeeded = isWetPassNeeded;
+  pending.isBypassing = !isWetPassNeeded && (wetAmount[0] == 0.0);
+  pending.latency = getLatency();
+  pending.fadeLength =
+    std::max(1, static_cast<int>(std::lround(fadeSeconds * sampleRate)));
+
+  // mid side
+
+  if (p.isMidSideEnabled) {
+    leftRightToMidSide(io, numSamples);
+  }
+
+  // dry signal and input gain
+
+  for (int c = 0; c < 2; ++c) {
+    std::copy(io[c], io[c] + numSamples, dryBuffer[c]);
+  }
+
+  for (int c = 0; c < 2; ++c) {
+    gain[0][c] = applyGainRamp<WideVec>(
+      io[c], gain[0][c], gainTarget[0][c], alpha, numSamples);
+  }
+
+  // affine shortcut, see Engine.h
+
+  updateAffineShortcut(io);
+
+  // the engine of linear-phase oversampling, and adaptive oversampling, which
+  // may use another order; both run two paths at once while switching, and
+  // wait for the pre-roll of the active one
+
+  updateFftOversampling();
+
+  if (!isIdle && !isPreRolling) {
+    updateAdaptiveOversampling();
+  }
+
+  pending.isFading = fadingOrder >= 0;
+  if (pending.isFading) {
+    for (int s = 0; s < numSplines; ++s) {
+      fadingWaveshapers[s]->copyTargetsFrom(*waveshapers[s]);
+      fadingWaveshapers[s]->setControlRateAutomation(
+        p.isControlRateAutomationEnabled);
+    }
+  }
+  path = getResamplingPath(activeOrder, activeFftOversamplingOrder);
+  fadingPath = pending.isFading
+                 ? getResamplingPath(fadingOrder, fadingFftOversamplingOrder)
+                 : ResamplingPath{};
+
+  for (auto* resamplingPath : { &path, &fadingPath }) {
+    if (resamplingPath->signalFft) {
+      resamplingPath->signalFft->setWorkerPool(workerPool);
+      resamplingPath->dryFft->setWorkerPool(workerPool);
+    }
+  }
+
+  preRollResampling();
+
+  if (p.isAffineShortcutEnabled) {
+    wetHistory.write(io, numSamples);
+    dryHistory.write(dryBuffer, numSamples);
+  }
+
+  pending.isEmpty = false;
+  if (isIdle) {
+    return false;
+  }
+
+  // the dry and the wet signals are resampled independently: with a worker
+  // pool, the dry one goes to a worker until endBlock
+
+  if (workerPool) {
+    workerPool->submit(dryTaskGroup, dryTask);
+    isDryTaskPending = true;
+  }
+  else {
+    resampleAllDry();
+  }
+
+  if (pending.isFading) {
+    processWet(
+      fadingPath, fadingWaveshapers, fadingFilters, *fadingCrossover, false);
+  }
+  uint32_t const numUpsampledSamples =
+    processWet(path, waveshapers, filters, *crossover, true);
+
+  pending.isEmpty = numUpsampledSamples == 0;
+  return pending.isWetPending;
+}
+
+void
+Engine::updateAffineShortcut(double* const* io)
+{
+  auto const& p = parameters;
+  int const numSamples = pending.numSamples;
+  int const latency = pending.latency;
+  int const fadeLength = pending.fadeLength;
+  int const numStages = numActiveStages;
+
+  AffineMap newAffineMap;
+
+  bool const isAffineMapAvailable = [&] {
+    if (!p.isAffineShortcutEnabled || !isUsingLinearPhase() ||
+        numActiveBands > 1 || fadingOrder >= 0) {
+      return false;
+    }
+    for (auto& filter : p.filters) {
+      if (filter.type != Svf::Type::off) {
+        return false;
+      }
+    }
+    if (!waveshapers[0]->getAffineMap(numKnots[0], newAffineMap)) {
+      return false;
+    }
+    for (int s = 1; s < numStages; ++s) {
+      auto& waveshaper = *waveshapers[s];
+      AffineMap stageMap;
+      if (!isRampSettled(waveshaper.gain,
+                         Vec2d().load(pending.splineGainTarget[s])) ||
+          !waveshaper.getAffineMap(numKnots[s], stageMap)) {
+        return false;
+      }
+      newAffineMap.append(pending.splineGainTarget[s], stageMap);
+    }
+    for (int c = 0; c < 2; ++c) {
+      newAffineMap.halfWidth[c] *= affineHeadroom;
+    }
+    return true;
+  }();
+
+  // the map in use changes only when the shortcut is faded out, as its
+  // delayed output still holds the old one
+
+  if (isAffineMapAvailable && affineMix == 0.0) {
+    affineMap = newAffineMap;
+  }
+
+  bool const isAffineRunning = isAffineMapAvailable || affineMix > 0.0;
+
+  affineFirstOutside =
+    isAffineRunning ? affineMap.findFirstOutside(io, numSamples) : numSamples;
+
+  bool const isAffineInRange = isAffineMapAvailable &&
+                               affineMap.isSameAs(newAffineMap) &&
+                               affineFirstOutside == numSamples;
+
+  // when the shortcut fades in, the delays of its outputs and the history are
+  // full of samples in the range
+
+  int const affineHoldSamples = std::max(
+    wetHistory.getLength() + fadeLength,
+    static_cast<int>(std::lround(affineHoldSeconds * sampleRate)));
+
+  affineQuietSamples =
+    isAffineInRange
+      ? std::min(affineQuietSamples + numSamples, affineHoldSamples)
+      : 0;
+
+  affineTarget = affineQuietSamples >= affineHoldSamples ? 1.0 : 0.0;
+
+  // the resampling stops once the input has been calm for as long, and is
+  // brought back in steps from when it is not anymore, see preRollResampling
+
+  bool const isAffineCalm = [&] {
+    if (!isAffineInRange) {
+      return false;
+    }
+    AffineMap innerMap = affineMap;
+    for (int c = 0; c < 2; ++c) {
+      innerMap.halfWidth[c] *= affinePreRollThreshold;
+    }
+    return innerMap.findFirstOutside(io, numSamples) == numSamples;
+  }();
+
+  affineCalmSamples =
+    isAffineCalm ? std::min(affineCalmSamples + numSamples, affineHoldSamples)
+                 : 0;
+  pending.canGoIdle = affineCalmSamples >= affineHoldSamples;
+
+  bool const wasIdle = isIdle;
+  if (wasIdle && !isAffineCalm && !isPreRolling) {
+    isPreRolling = true;
+    preRollBacklog = -1;
+  }
+  bool const isPreRollEnding = isPreRolling && preRollBacklog >= 0 &&
+                               preRollBacklog <= getPreRollStep();
+  isIdle = wasIdle && affineTarget == 1.0 && !isPreRollEnding;
+
+  if (affineWetDelay.getDelay() != latency) {
+    affineWetDelay.reset(latency);
+    affineDryDelay.reset(latency);
+  }
+
+  if (isAffineRunning) {
+    affineMap.apply(io, affineWetOutput, numSamples);
+    affineWetDelay.process(affineWetOutput, affineWetOutput, numSamples);
+    affineDryDelay.process(dryBuffer, affineDryOutput, numSamples);
+  }
+}
+
+// Back from the affine shortcut, the active path runs on the history, with
+// the affine map in place of the waveshaping, and its output is dropped.
+// While idle, it runs on at most getPreRollStep samples of it per block, from
+// the oldest, and the block adds to what is left; the engine leaves idle once
+// that fits in a step, or when the input leaves the range, and the rest runs
+// at once. It starts over if the active path changes meanwhile.
+void
+Engine::preRollResampling()
+{
+  if (!isPreRolling) {
+    return;
+  }
+
+  int const historyLength = wetHistory.getLength();
+
+  bool const isPathChanged = path.signal != preRollPath.signal ||
+                             path.signalFft != preRollPath.signalFft ||
+                             pending.latency != preRollLatency;
+  if (preRollBacklog < 0 || isPathChanged) {
+    path.reset();
+    wetCompensation[0].reset(wetCompensation[0].getDelay());
+    dryCompensation[0].reset(dryCompensation[0].getDelay());
+    preRollPath = path;
+    preRollLatency = pending.latency;
+    preRollBacklog = historyLength;
+  }
+
+  int const numToRun =
+    isIdle ? std::min(preRollBacklog, getPreRollStep()) : preRollBacklog;
+  int const first = historyLength - preRollBacklog;
+  int const end = first + numToRun;
+  for (int begin = first; begin < end; begin += maxNumSamples) {
+    int const n = std::min(maxNumSamples, end - begin);
+    auto const numPreRollSamples = static_cast<uint32_t>(n);
+    dryHistory.read(affineScratch, begin, n);
+    path.resampleDry(affineScratch, numPreRollSamples);
+    wetHistory.read(affineScratch, begin, n);
+    auto const numUpsampled = path.upSample(affineScratch, numPreRollSamples);
+    affineMap.apply(path.getUpsampledIo(), static_cast<int>(numUpsampled));
+    path.downSample(numPreRollSamples);
+    wetCompensation[0].process(path.getWetOutput(), n);
+    dryCompensation[0].process(path.getDryOutput(), n);
+  }
+
+  preRollBacklog -= numToRun;
+  if (isIdle) {
+    preRollBacklog =
+      std::min(preRollBacklog + pending.numSamples, historyLength);
+  }
+  else {
+    isPreRolling = false;
+  }
+}
+
+void
+Engine::resampleAllDry()
+{
+  auto const numInputSamples = static_cast<uint32_t>(pending.numSamples);
+  path.resampleDry(dryBuffer, numInputSamples);
+  if (pending.isFading) {
+    fadingPath.resampleDry(dryBuffer, numInputSamples);
+  }
+}
+
+// a stage or a band that is switched on starts from its current settings
+// instead of smoothing from the ones it had when it was switched off, on both
+// paths while switching order
+void
+Engine::activateSpline(int const spline)
+{
+  auto& waveshaper = *waveshapers[spline];
+  waveshaper.reset();
+  waveshaper.gain = Vec2d().load(pending.splineGainTarget[spline]);
+  if (fadingOrder >= 0) {
+    fadingWaveshapers[spline]->copyStateFrom(waveshaper);
+  }
+}
+
+bool
+Engine::areChannelsLinked(Waveshapers& pathWaveshapers)
+{
+  auto const& p = parameters;
+  for (int s = 0; s < numActiveStages; ++s) {
+    auto& waveshaper = *pathWaveshapers[s];
+    if (!waveshaper.areChannelsLinked(numKnots[s]) ||
+        p.isSymmetric[s][0] != p.isSymmetric[s][1]) {
+      return false;
+    }
+    if (s > 0 && (p.splineGain[s][0] != p.splineGain[s][1] ||
+                  waveshaper.gain[0] != waveshaper.gain[1])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t
+Engine::processWet(ResamplingPath& wetPath,
+                   Waveshapers& pathWaveshapers,
+                   Filters& pathFilters,
+                   Crossover& pathCrossover,
+                   bool const isCallerWaveshaping)
+{
+  auto const numInputSamples = static_cast<uint32_t>(pending.numSamples);
+
+  uint32_t const numUpsampledSamples =
+    wetPath.upSample(pending.io, numInputSamples);
+
+  if (numUpsampledSamples == 0) {
+    return numUpsampledSamples;
+  }
+
+  auto& upsampledIo = wetPath.getUpsampledIo();
+
+  double const upsampledSampleRate =
+    sampleRate * wetPath.getOversamplingRate();
+  double const upsampledAlpha =
+    getSmoothingAlpha(pending.smoothingTime, upsampledSampleRate);
+
+  // pre and post filters
+
+  setFilterTargets(pathFilters, upsampledSampleRate);
+  setCrossoverTarget(pathCrossover, numActiveBands, upsampledSampleRate);
+
+  if (!pending.isBypassing) {
+    pathFilters[0]->process(upsampledIo, upsampledAlpha);
+
+    auto const n = static_cast<int>(numUpsampledSamples);
+    // the crossover runs across time on each channel, so the bands are never
+    // packed
+    auto const monoPacking =
+      numActiveBands == 1 && areChannelsLinked(pathWaveshapers)
+        ? getMonoPacking(upsampledIo, n, pending.canSilenceSide)
+        : MonoPacking::none;
+
+    if (monoPacking == MonoPacking::none) {
+      // the waveshaping and the rest of the path are left to the caller and
+      // to endBlock
+      if (isCallerWaveshaping) {
+        pending.upsampledAlpha = upsampledAlpha;
+        pending.isWetPending = true;
+        return numUpsampledSamples;
+      }
+      waveshape(
+        pathWaveshapers, upsampledIo, pathCrossover, upsampledAlpha, 1);
+    }
+    else {
+      auto& packedMono = bandBuffers[0];
+      packMono(upsampledIo, packedMono, n);
+      waveshape(pathWaveshapers, packedMono, pathCrossover, upsampledAlpha, 2);
+      unpackMono(packedMono, upsampledIo, n, monoPacking);
+    }
+
+    pathFilters[1]->process(upsampledIo, upsampledAlpha);
+  }
+
+  wetPath.downSample(numInputSamples);
+
+  return numUpsampledSamples;
+}
+
+void
+Engine::endBlock()
+{
+  double* const* io = pending.io;
+  int const numSamples = pending.numSamples;
+  int const fadeLength = pending.fadeLength;
+
+  if (pending.isWetPending) {
+    filters[1]->process(getUpsampledIo(), pending.upsampledAlpha);
+    path.downSample(static_cast<uint32_t>(numSamples));
+    pending.isWetPending = false;
+  }
+
+  if (isDryTaskPending) {
+    workerPool->wait(dryTaskGroup);
+    isDryTaskPending = false;
+  }
+
+  if (!isIdle && pending.isEmpty) {
+    for (int c = 0; c < 2; ++c) {
+      std::fill(io[c], io[c] + numSamples, 0.0);
+    }
+    return;
+  }
+
+  // latency compensation and crossfade of adaptive oversampling; while idle,
+  // nothing is upsampled, so the band buffers hold the outputs of the affine
+  // shortcut
+
+  if (isIdle) {
+    interleave(affineWetOutput, bandBuffers[0], numSamples);
+    interleave(affineDryOutput, bandBuffers[1], numSamples);
+  }
+  auto& wetData = isIdle ? bandBuffers[0] : path.getWetOutput();
+  auto& dryData = isIdle ? bandBuffers[1] : path.getDryOutput();
+
+  if (!isIdle) {
+    wetCompensation[0].process(wetData, numSamples);
+    dryCompensation[0].process(dryData, numSamples);
+  }
+
+  if (pending.isFading) {
+    auto& fadingWetData = fadingPath.getWetOutput();
+    auto& fadingDryData = fadingPath.getDryOutput();
+    wetCompensation[1].process(fadingWetData, numSamples);
+    dryCompensation[1].process(fadingDryData, numSamples);
+
+    // the fade starts when the filters of the incoming path are full, about
+    // twice their latency for the linear-phase ones, with some room for the
+    // tails of the minimum-phase ones
+    int const fadeStart = 2 * pending.latency + fadeLength;
+    double const fadeStep = 1.0 / fadeLength;
+
+    for (int i = 0; i < numSamples; ++i) {
+      int const fadePosition = transitionPosition + i - fadeStart;
+      double const amount =
+        fadePosition < 0 ? 0.0 : std::min(1.0, (fadePosition + 1) * fadeStep);
+      Vec2d const wet = wetData[i];
+      Vec2d const fadingWet = fadingWetData[i];
+      wetData[i] = amount * (wet - fadingWet) + fadingWet;
+      Vec2d const dry = dryData[i];
+      Vec2d const fadingDry = fadingDryData[i];
+      dryData[i] = amount * (dry - fadingDry) + fadingDry;
+    }
+
+    transitionPosition += numSamples;
+    if (transitionPosition >= fadeStart + fadeLength) {
+      fadingOrder = -1;
+    }
+  }
+
+  if (!isIdle) {
+    mixAffineShortcut(wetData, dryData);
+  }
+
+  mixDryWet(wetData, dryData);
+
+  // mid side
+
+  if (pending.isMidSideEnabled) {
+    midSideToLeftRight(io, numSamples);
+  }
+}
+
+// crossfade of the affine shortcut: back to the resampling paths, the fade
+// ends before the first sample out of the range reaches the output
+void
+Engine::mixAffineShortcut(VecBuffer<Vec2d>& wetData, VecBuffer<Vec2d>& dryData)
+{
+  if (affineMix == 0.0 && affineTarget == 0.0) {
+    return;
+  }
+
+  int const numSamples = pending.numSamples;
+  int const fadeLength = pending.fadeLength;
+
+  if (affineTarget > affineMix) {
+    affineFadeOutStep = 0.0;
+  }
+  else if (affineTarget < affineMix) {
+    int const fadeOutLength =
+      affineFirstOutside < numSamples
+        ? std::clamp(pending.latency + affineFirstOutside, 1, fadeLength)
+        : fadeLength;
+    affineFadeOutStep = std::max(affineFadeOutStep, affineMix / fadeOutLength);
+  }
+  double const fadeInStep = 1.0 / fadeLength;
+
+  for (int i = 0; i < numSamples; ++i) {
+    affineMix = affineTarget > affineMix
+                  ? std::min(affineTarget, affineMix + fadeInStep)
+                  : std::max(affineTarget, affineMix - affineFadeOutStep);
+    Vec2d const wet = wetData[i];
+    Vec2d const affineWet(affineWetOutput[0][i], affineWetOutput[1][i]);
+    wetData[i] = affineMix * (affineWet - wet) + wet;
+    Vec2d const dry = dryData[i];
+    Vec2d const affineDry(affineDryOutput[0][i], affineDryOutput[1][i]);
+    dryData[i] = affineMix * (affineDry - dry) + dry;
+  }
+
+  if (affineMix == 0.0) {
+    affineFadeOutStep = 0.0;
+  }
+  isIdle = affineMix == 1.0 && pending.canGoIdle;
+}
+
+// dry-wet and output gain, into the output, with the vu meters
+void
+Engine::mixDryWet(VecBuffer<Vec2d>& wetData, VecBuffer<Vec2d>& dryData)
+{
+  double* const* io = pending.io;
+  int const numSamples = pending.numSamples;
+  double const alpha = pending.alpha;
+  auto const& gainTarget = pending.gainTarget;
+
+  constexpr double vuMeterFrequency = 10.0;
+
+  Vec2d vuMeterAlpha = std::exp(-twoPi * vuMeterFrequency / sampleRate);
+
+  Vec2d outputGain = Vec2d().load(gain[1]);
+  Vec2d outputGainTarget = Vec2d().load(gainTarget[1]);
+
+  Vec2d vuMeterDry = Vec2d().load_a(vuMeterState);
+  Vec2d vuMeterWet = Vec2d().load_a(vuMeterState + 2);
+  Vec2d vuMeter = Vec2d().load_a(vuMeterState + 4);
+
+  // the output gain and the dry-wet amount are ramped in closed form, see
+  // Ramp.h, and are constants once they have reached their targets
+
+  auto const updateVuMeters = [&](Vec2d const wet, Vec2d const dry) {
+    Vec2d wet2 = wet * wet;
+    Vec2d dry2 = dry * dry;
+    vuMeterWet = vuMeterAlpha * (vuMeterWet - wet2) + wet2;
+    vuMeterDry = vuMeterAlpha * (vuMeterDry - dry2) + dry2;
+  };
+
+  double const rampDecay = std::pow(alpha, numSamples);
+
+  bool const isOutputGainSettled = isRampSettled(outputGain, outputGainTarget);
+  Vec2d const outputGainDistance = outputGain - outputGainTarget;
+
+  if (pending.isWetPassNeeded) {
+
+    Vec2d amount = Vec2d().load(wetAmount);
+    Vec2d amountTarget = Vec2d().load(pending.wetAmountTarget);
+
+    if (isOutputGainSettled && isRampSettled(amount, amountTarget)) {
+      for (int i = 0; i < numSamples; ++i) {
+        Vec2d wet = outputGainTarget * wetData[i];
+        Vec2d dry = dryData[i];
+        wetData[i] = amountTarget * (wet - dry) + dry;
+        updateVuMeters(wet, dry);
+      }
+      amount = amountTarget;
+    }
+    else {
+      Vec2d const amountDistance = amount - amountTarget;
+      forEachRampPower(
+        numSamples, alpha, [&](int const i, double const power) {
+          Vec2d g = outputGainTarget + outputGainDistance * power;
+          Vec2d a = amountTarget + amountDistance * power;
+          Vec2d wet = g * wetData[i];
+          Vec2d dry = dryData[i];
+          wetData[i] = a * (wet - dry) + dry;
+          updateVuMeters(wet, dry);
+        });
+      amount = amountTarget + amountDistance * rampDecay;
+    }
+
+    amount.store(wetAmount);
+  }
+  else if (!pending.isBypassing) {
+    if (isOutputGainSettled) {
+      for (int i = 0; i < numSamples; ++i) {
+        Vec2d wet = outputGainTarget * wetData[i];
+        wetData[i] = wet;
+        updateVuMeters(wet, dryData[i]);
+      }
+    }
+    else {
+      forEachRampPower(
+        numSamples, alpha, [&](int const i, double const power) {
+          Vec2d g = outputGainTarget + outputGainDistance * power;
+          Vec2d wet = g * wetData[i];
+          wetData[i] = wet;
+          updateVuMeters(wet, dryData[i]);
+        });
+    }
+  }
+
+  outputGain = isOutputGainSettled
+                 ? outputGainTarget
+                 : outputGainTarget + outputGainDistance * rampDecay;
+
+  if (pending.isBypassing) {
+    vuMeter = 0.0;
+    deinterleave(dryData, io, numSamples);
+  }
+  else {
+    outputGain.store(gain[1]);
+    vuMeterDry.store_a(vuMeterState);
+    vuMeterWet.store_a(vuMeterState + 2);
+    Vec2d gainOffset = outputGainTarget * Vec2d().load(gainTarget[0]);
+    for (int s = 1; s < numActiveStages; ++s) {
+      gainOffset *= Vec2d().load(pending.splineGainTarget[s]);
+    }
+    gainOffset *= gainOffset;
+    vuMeter = toDB(vuMeterWet) - toDB(gainOffset * vuMeterDry);
+
+    deinterleave(wetData, io, numSamples);
+  }
+
+  vuMeter.store_a(vuMeterState + 4);
+}
+
+} // namespace overdraw
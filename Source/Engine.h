@@ -0,0 +1,584 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "AdaptiveOversampling.h"
+#include "AffineShortcut.h"
+#include "Arena.h"
+#include "Crossover.h"
+#include "FftOversampling.h"
+#include "OverdrawDsp.h"
+#include "Svf.h"
+#include "WorkerPool.h"
+#include "oversimple/Oversampling.hpp"
+#include <array>
+#include <memory>
+
+namespace overdraw {
+
+/**
+ * The processing of Overdraw, used by the plug-in and by the overdraw_dsp
+ * library: mid side, input gain, oversampling of the signal and of the dry
+ * signal, pre filter, the waveshaping stages and bands, post filter, dry-wet
+ * and output gain.
+ * The parameters are plain values, in the units of the plug-in parameters,
+ * which process smooths toward. prepare, setOversampling and
+ * buildAdaptiveOversamplers allocate, the other functions do not. An engine
+ * is not thread safe: the calls on the same engine must not overlap.
+ * The plug-in adds around it true bypass, the choice of the order of adaptive
+ * oversampling from the load it measures, and the worker pool of offline
+ * rendering.
+ */
+class Engine final
+{
+public:
+  static constexpr int maxNumStages = 3;
+  static constexpr int maxNumBands = Crossover::maxNumBands;
+  // 1x to 32x
+  static constexpr int numOversamplingOrders = 6;
+
+  // the first stage, the stages after it, then the bands after the first one
+  static constexpr int numSplines = maxNumStages + maxNumBands - 1;
+
+  static constexpr int getBandSpline(int band)
+  {
+    return maxNumStages + band - 1;
+  }
+
+  enum class LinearPhaseEngine
+  {
+    directFir,
+    partitionedFft
+  };
+
+  struct Filter final
+  {
+    Svf::Type type = Svf::Type::off;
+    double frequency[2] = { 1000.0, 1000.0 };
+    double q[2] = { 0.707, 0.707 };
+    double gain[2] = { 0.0, 0.0 };
+  };
+
+  struct Parameters final
+  {
+    bool isMidSideEnabled = false;
+    // milliseconds
+    double smoothingTime = 50.0;
+    // see Dsp::setControlRateAutomation
+    bool isControlRateAutomationEnabled = false;
+    // decibels
+    double inputGain[2] = { 0.0, 0.0 };
+    double outputGain[2] = { 0.0, 0.0 };
+    // percent
+    double wet[2] = { 100.0, 100.0 };
+    int numStages = 1;
+    int numBands = 1;
+    bool isSymmetric[numSplines][2];
+    // decibels, in front of each spline but the first one
+    double splineGain[numSplines][2] = {};
+    // hertz, between each band and the next one
+    double crossover[maxNumBands - 1][2] = { { 150.0, 150.0 },
+                                             { 1000.0, 1000.0 },
+                                             { 5000.0, 5000.0 } };
+    // the pre and post filters
+    std::array<Filter, 2> filters;
+    // which engine runs linear-phase oversampling at each order: both have
+    // the same latency, so this can change while processing, with a
+    // crossfade
+    std::array<LinearPhaseEngine, numOversamplingOrders> linearPhaseEngines;
+    // see the affine shortcut below
+    bool isAffineShortcutEnabled = false;
+    // the order to run at for adaptive oversampling, never above the one of
+    // the oversampling settings, or -1 for the one of the settings, see
+    // buildAdaptiveOversamplers
+    int adaptiveOrder = -1;
+
+    Parameters();
+  };
+
+  Parameters parameters;
+
+  Engine();
+  ~Engine();
+
+  Engine(Engine const&) = delete;
+  Engine& operator=(Engine const&) = delete;
+
+  /**
+   * Allocates the buffers and the FFT oversampling engines, and resets the
+   * state. Blocks longer than maxNumSamples are processed in chunks.
+   */
+  void prepare(double sampleRate, int maxNumSamples);
+
+  /**
+   * Frees what prepare allocated. The engine is not prepared anymore.
+   */
+  void release();
+
+  /**
+   * Rebuilds the oversamplers, if the engine is prepared.
+   * @param order from 0 (1x) to numOversamplingOrders - 1 (32x)
+   */
+  void setOversampling(int order, bool isLinearPhase);
+
+  /**
+   * The settings and the oversamplers of the oversampling order, for the
+   * plug-in, which reconfigures them in place from its parameters instead of
+   * calling setOversampling. They keep their address until setOversampling.
+   */
+  oversimple::OversamplingSettings& getOversamplingSettings()
+  {
+    return oversamplingSettings;
+  }
+  oversimple::TOversampling<double>& getSignalOversampling()
+  {
+    return *signalOversampling;
+  }
+  oversimple::TOversampling<double>& getDryOversampling()
+  {
+    return *dryOversampling;
+  }
+
+  int getOversamplingOrder() const
+  {
+    return static_cast<int>(oversamplingSettings.order);
+  }
+
+  bool isUsingLinearPhase() const
+  {
+    return oversamplingSettings.isUsingLinearPhase;
+  }
+
+  bool isPrepared() const { return maxNumSamples > 0; }
+
+  /**
+   * @return the latency in samples, once prepared
+   */
+  int getLatency() const;
+
+  /**
+   * @return the largest latency of any oversampling setting, once prepared
+   */
+  int getMaxLatency() const { return maxOversamplingLatency; }
+
+  /**
+   * Adaptive oversampling. The oversamplers of the orders below the highest
+   * one are built in advance, and the order of the oversampling settings
+   * keeps using the main ones. With linear phase, the orders above 1x run on
+   * the FFT engines, which prepare already holds in the arena, so only the
+   * minimum-phase oversamplers and the linear-phase 1x ones are built. The
+   * latency of each path is padded to the one of the main oversamplers, so a
+   * switch can crossfade the two paths: the outgoing one keeps running, with
+   * its own copy of the waveshapers, until the incoming one has filled its
+   * latency, then the fade takes fadeSeconds. Orders with more latency than
+   * the main one are skipped. Without an adaptive order, the order of the
+   * settings is faded back to in the same way; a change of the oversampling
+   * settings goes straight to its order. Allocates, and does nothing if the
+   * engine is not prepared; once built, each prepare prepares them again and
+   * release frees them.
+   */
+  void buildAdaptiveOversamplers();
+
+  bool areAdaptiveOversamplersBuilt() const { return isAdaptiveBuilt; }
+
+  /**
+   * The order in use, which differs from the one of the oversampling settings
+   * when adaptive oversampling has lowered it.
+   */
+  int getOversamplingOrderInUse() const { return activeOrder; }
+
+  bool isSwitchingOversamplingOrder() const { return fadingOrder >= 0; }
+
+  /**
+   * When set, the dry signal is resampled on the pool while the wet one is
+   * processed, and so are the channels of the FFT engines. Offline rendering
+   * only, see WorkerPool. The pool must outlive the blocks that use it.
+   */
+  void setWorkerPool(WorkerPool* pool) { workerPool = pool; }
+
+  /**
+   * Sets a knot of a spline, see Dsp::setKnot. The knots are smoothed toward
+   * like the other parameters.
+   */
+  void setKnot(int spline,
+               int knot,
+               int channel,
+               double x,
+               double y,
+               double tangent,
+               double smoothness);
+
+  void setNumKnots(int spline, int numKnots);
+
+  /**
+   * The target knots of a spline, for the callers that write all of them at
+   * once, as the plug-in does with SplineParameters::updateSpline.
+   */
+  AutoSpline& getKnots(int spline) { return waveshapers[spline]->autoSpline; }
+
+  /**
+   * Clears the state, and jumps to the parameters and knots.
+   */
+  void reset();
+
+  // stereo, in place
+  void process(double* const* io, int numSamples);
+  void process(float* const* io, int numSamples);
+  void processInterleaved(double* io, int numSamples);
+  void processInterleaved(float* io, int numSamples);
+
+  /**
+   * @return true if the wet amount is zero on both channels and is not
+   * moving
+   */
+  bool isWetSilent() const;
+
+  /**
+   * @return the level of the wet signal relative to the dry one, in
+   * decibels, compensated for the gains and measured at the last block
+   */
+  double getVuMeter(int channel) const { return vuMeterState[4 + channel]; }
+
+  /**
+   * @return true while the affine shortcut stands in for the resampling
+   */
+  bool isResamplingIdle() const { return isIdle; }
+
+  struct MemoryFootprint final
+  {
+    // the arena holding the buffers and the FFT engines
+    size_t arena = 0;
+    // the interleaved output buffers of the FFT engines
+    size_t fftOversamplingBuffers = 0;
+    // the interleaved output buffers of the oversimple oversamplers at the
+    // current factor, without their filter states, which oversimple does not
+    // expose
+    size_t oversamplingBuffers = 0;
+    // the buffers of the wide spline kernel, shared by all the waveshapers
+    size_t splineBuffers = 0;
+    // the upsampled bands, which the mono fast path shares
+    size_t engineBuffers = 0;
+
+    size_t getTotal() const
+    {
+      return arena + fftOversamplingBuffers + oversamplingBuffers +
+             splineBuffers + engineBuffers;
+    }
+  };
+
+  // Memory used by the audio buffers, in bytes. The buffers are sized for the
+  // longest blocks in prepare, so this is what the engine holds whatever it
+  // processes.
+  MemoryFootprint getMemoryFootprint() const;
+
+  // Affine shortcut. While the curves of all the stages are settled and the
+  // input, after the input gain, stays in the range where they are straight
+  // lines, the waveshaping is an affine map: it is applied at the base rate
+  // and delayed by the latency, and nothing is resampled. Only with
+  // linear-phase oversampling, without bands and with the pre and post
+  // filters off. The resampling is then taken as a pure delay, which skips
+  // the passband ripple of its filters and their rolloff toward the base-rate
+  // Nyquist frequency: the shortcut is close to the resampled output, not
+  // equal to it, and differs from it the most at the top of the spectrum.
+  // The input has to stay in the range for affineHoldSeconds before the
+  // shortcut fades in, and within affinePreRollThreshold of it for as long
+  // before the resampling stops. The resampling paths are brought back to the
+  // state they would be in had they kept running, by running them on the last
+  // input samples through the affine map: over several blocks, at most two
+  // blocks of history each, once the input goes past affinePreRollThreshold
+  // of the range, or at once with what is left when it leaves the range. The
+  // fade back ends before the first sample out of the range reaches the
+  // output. The range is checked on the base-rate input, so it is narrowed by
+  // affineHeadroom for the peaks between samples.
+  static constexpr double affineHoldSeconds = 0.05;
+  static constexpr double affineHeadroom = 0.5;
+  static constexpr double affinePreRollThreshold = 0.75;
+  // history beyond twice the latency, for the tails of the filters
+  static constexpr int affineHistoryMargin = 512;
+
+  // the crossfades of adaptive oversampling and of the affine shortcut
+  static constexpr double fadeSeconds = 0.01;
+
+private:
+  friend class EngineBatch;
+
+  using Waveshapers = std::array<aligned_ptr<Dsp>, numSplines>;
+  using Filters = std::array<aligned_ptr<Svf>, 2>;
+
+  // the oversamplers of the signal and of the dry signal at one order, with
+  // the FFT engines that replace them when they are in use
+  struct ResamplingPath final
+  {
+    oversimple::TOversampling<double>* signal = nullptr;
+    oversimple::TOversampling<double>* dry = nullptr;
+    FftOversampling* signalFft = nullptr;
+    FftOversampling* dryFft = nullptr;
+
+    uint32_t getOversamplingRate() const
+    {
+      return signalFft ? signalFft->getOversamplingRate()
+                       : signal->getOversamplingRate();
+    }
+
+    uint32_t getLatency() const
+    {
+      return signalFft ? signalFft->getLatency() : signal->getLatency();
+    }
+
+    VecBuffer<Vec2d>& getUpsampledIo()
+    {
+      return signalFft ? signalFft->getUpSampleOutput()
+                       : signal->getUpSampleOutputInterleaved().getBuffer2(0);
+    }
+
+    VecBuffer<Vec2d>& getWetOutput()
+    {
+      return signalFft ? signalFft->getDownSampleOutput()
+                       : signal->getDownSampleOutputInterleaved().getBuffer2(0);
+    }
+
+    VecBuffer<Vec2d>& getDryOutput()
+    {
+      return dryFft ? dryFft->getDownSampleOutput()
+                    : dry->getDownSampleOutputInterleaved().getBuffer2(0);
+    }
+
+    void reset();
+    void resampleDry(double* const* input, uint32_t numSamples);
+    uint32_t upSample(double* const* input, uint32_t numSamples);
+    void downSample(uint32_t numSamples);
+  };
+
+  // the longest upsampled block, at the highest oversampling factor
+  int getMaxNumUpsampledSamples() const
+  {
+    return maxNumSamples << (numOversamplingOrders - 1);
+  }
+
+  void buildOversamplers();
+  void configureFftOversampling();
+  void carveBuffers(Arena& arena);
+  void processBlock(double* const* io, int numSamples);
+
+  // processBlock in two parts around the waveshaping, so that EngineBatch can
+  // waveshape several engines together: beginBlock runs up to the pre filter
+  // and returns false if there is nothing left to waveshape, endBlock runs
+  // the rest of the block in any case
+  bool beginBlock(double* const* io, int numSamples);
+  void endBlock();
+
+  VecBuffer<Vec2d>& getUpsampledIo() { return path.getUpsampledIo(); }
+
+  // the smoothing runs once per vector: when two samples are packed in a
+  // vector, it takes twice the steps
+  void waveshape(Waveshapers& pathWaveshapers,
+                 VecBuffer<Vec2d>& io,
+                 Crossover& pathCrossover,
+                 double sampleAlpha,
+                 int samplesPerVector);
+
+  void setFilterTargets(Filters& filtersToSet, double upsampledSampleRate);
+  void setCrossoverTarget(Crossover& crossoverToSet,
+                          int numBands,
+                          double upsampledSampleRate);
+
+  // for a stage or a band that is switched on
+  void activateSpline(int spline);
+  // the mono fast path needs the same settings on both channels
+  bool areChannelsLinked(Waveshapers& pathWaveshapers);
+
+  bool isFftOversamplingReady(int order) const;
+  int getFftOversamplingOrder() const;
+  // @param fftOrder the order of the FFT engines the main order runs on, or
+  // -1 for oversimple
+  ResamplingPath getResamplingPath(int order, int fftOrder);
+  // -1 if the order has more latency than the main oversamplers
+  int getLatencyPadding(int order) const;
+  void updateFftOversampling();
+  void updateAdaptiveOversampling();
+  // starts the crossfade from the active path to another one, see
+  // buildAdaptiveOversamplers
+  void beginPathSwitch(int newOrder, int padding);
+
+  void updateAffineShortcut(double* const* io);
+  void preRollResampling();
+  // the most history the pre-roll runs on in a block while idle
+  int getPreRollStep() const { return 2 * pending.numSamples; }
+
+  void resampleAllDry();
+  uint32_t processWet(ResamplingPath& wetPath,
+                      Waveshapers& pathWaveshapers,
+                      Filters& pathFilters,
+                      Crossover& pathCrossover,
+                      bool isCallerWaveshaping);
+  void mixAffineShortcut(VecBuffer<Vec2d>& wetData,
+                         VecBuffer<Vec2d>& dryData);
+  void mixDryWet(VecBuffer<Vec2d>& wetData, VecBuffer<Vec2d>& dryData);
+
+  Waveshapers waveshapers;
+  std::array<int, numSplines> numKnots;
+  Filters filters;
+  aligned_ptr<Crossover> crossover;
+  // the upsampled signal of the bands above the first one. The mono fast
+  // path, see Engine.cpp, only runs without bands, and packs the upsampled
+  // signal of a single channel, two samples per vector, in the first one.
+  std::array<VecBuffer<Vec2d>, maxNumBands - 1> bandBuffers{
+    VecBuffer<Vec2d>{ 0 },
+    VecBuffer<Vec2d>{ 0 },
+    VecBuffer<Vec2d>{ 0 }
+  };
+
+  oversimple::OversamplingSettings oversamplingSettings;
+  std::unique_ptr<oversimple::TOversampling<double>> signalOversampling;
+  std::unique_ptr<oversimple::TOversampling<double>> dryOversampling;
+
+  // partitioned FFT alternatives to the linear-phase FIRs of oversimple, one
+  // per oversampling order. They are all prepared in prepare, so choosing the
+  // engine of an order never allocates.
+  using FftOversamplingEngines =
+    std::array<std::unique_ptr<FftOversampling>, numOversamplingOrders>;
+  FftOversamplingEngines signalFftOversampling;
+  FftOversamplingEngines dryFftOversampling;
+  std::array<bool, numOversamplingOrders> isFftOrderConfigured{};
+  int activeFftOversamplingOrder = -1;
+
+  // The buffers of plain samples, and the memory of the filters and states of
+  // all the FFT oversampling engines, are carved from a single arena in
+  // prepare. The vector buffers that the waveshapers, the crossover and the
+  // oversamplers work on own their memory, as avec does not take it from
+  // outside; prepare allocates them once, for the longest blocks.
+  Arena arena;
+  double* dryBuffer[2] = { nullptr, nullptr };
+  // for the conversions from single precision and from interleaved buffers
+  double* scratch[2] = { nullptr, nullptr };
+
+  double sampleRate = 0.0;
+  int maxNumSamples = 0;
+  int maxOversamplingLatency = 0;
+
+  double gain[2][2] = { { 1.0, 1.0 }, { 1.0, 1.0 } };
+  double wetAmount[2] = { 1.0, 1.0 };
+  int numActiveStages = 1;
+  int numActiveBands = 1;
+
+  // dry and wet vu meter states, then the vu meter values
+  alignas(16) double vuMeterState[6] = {};
+
+  WorkerPool* workerPool = nullptr;
+
+  // adaptive oversampling, [linear phase][order], only 1x with linear phase
+  using Oversamplers =
+    std::array<std::unique_ptr<oversimple::TOversampling<double>>,
+               numOversamplingOrders - 1>;
+  std::array<Oversamplers, 2> adaptiveSignalOversampling;
+  std::array<Oversamplers, 2> adaptiveDryOversampling;
+  bool isAdaptiveBuilt = false;
+
+  int mainOrder = -1;
+  bool isMainLinearPhase = false;
+  int activeOrder = -1;
+  int fadingOrder = -1;
+  // the FFT engines of the outgoing path, if it is the main order
+  int fadingFftOversamplingOrder = -1;
+  int transitionPosition = 0;
+  // the waveshapers, the filters and the crossover of the outgoing path while
+  // fading
+  Waveshapers fadingWaveshapers;
+  Filters fadingFilters;
+  aligned_ptr<Crossover> fadingCrossover;
+  // of the wet and dry outputs, of the active path then of the fading one
+  std::array<LatencyCompensation, 2> wetCompensation;
+  std::array<LatencyCompensation, 2> dryCompensation;
+
+  // the paths of the current block
+  ResamplingPath path;
+  ResamplingPath fadingPath;
+
+  // the dry signal is resampled on the worker pool, if any, between
+  // beginBlock and endBlock
+  struct DryTask final
+  {
+    Engine* engine = nullptr;
+    void operator()() { engine->resampleAllDry(); }
+  };
+  DryTask dryTask;
+  TaskGroup dryTaskGroup;
+  bool isDryTaskPending = false;
+
+  // affine shortcut
+  AffineMap affineMap;
+  LatencyCompensation affineWetDelay;
+  LatencyCompensation affineDryDelay;
+  double* affineWetOutput[2] = { nullptr, nullptr };
+  double* affineDryOutput[2] = { nullptr, nullptr };
+  // the input after the input gain, and the dry input
+  SignalHistory wetHistory;
+  SignalHistory dryHistory;
+  double* affineScratch[2] = { nullptr, nullptr };
+  // 0 for the resampling paths, 1 for the affine map
+  double affineMix = 0.0;
+  // per sample while fading back to the resampling paths, 0 otherwise
+  double affineFadeOutStep = 0.0;
+  double affineTarget = 0.0;
+  int affineFirstOutside = 0;
+  int affineQuietSamples = 0;
+  // within affinePreRollThreshold of the range
+  int affineCalmSamples = 0;
+  bool isIdle = false;
+  // the history the active path has yet to run on, from the newest sample,
+  // or -1 to start over, and the path and latency it runs with
+  bool isPreRolling = false;
+  int preRollBacklog = 0;
+  ResamplingPath preRollPath;
+  int preRollLatency = 0;
+
+  // the block between beginBlock and endBlock
+  struct PendingBlock final
+  {
+    double* io[2] = { nullptr, nullptr };
+    int numSamples = 0;
+    double smoothingTime = 0.0;
+    double alpha = 0.0;
+    double upsampledAlpha = 0.0;
+    double gainTarget[2][2] = {};
+    double wetAmountTarget[2] = {};
+    double splineGainTarget[numSplines][2] = {};
+    int numStages = 1;
+    int numBands = 1;
+    int latency = 0;
+    int fadeLength = 1;
+    bool isMidSideEnabled = false;
+    bool isWetPassNeeded = false;
+    bool isBypassing = false;
+    bool canSilenceSide = false;
+    bool isFading = false;
+    // the input has been within affinePreRollThreshold of the range for long
+    // enough to stop the resampling
+    bool canGoIdle = false;
+    // the active path waits for the waveshaping, its post filter and its
+    // downsampling are left to endBlock
+    bool isWetPending = false;
+    // nothing was upsampled yet, the output is silent
+    bool isEmpty = false;
+  };
+  PendingBlock pending;
+};
+
+} // namespace overdraw
@@ -0,0 +1,259 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "EngineBatch.h"
+#include <algorithm>
+
+namespace overdraw {
+
+EngineBatch::EngineBatch()
+  : wideSpline(Aligned<WideSpline>::make())
+{}
+
+EngineBatch::~EngineBatch() = default;
+
+void
+EngineBatch::add(Engine& engine)
+{
+  engines.push_back(&engine);
+  chunks.resize(engines.size());
+  waveshaping.reserve(engines.size());
+  settled.reserve(engines.size());
+}
+
+void
+EngineBatch::remove(Engine& engine)
+{
+  auto const it = std::find(engines.begin(), engines.end(), &engine);
+  if (it != engines.end()) {
+    engines.erase(it);
+    chunks.resize(engines.size());
+  }
+}
+
+int
+EngineBatch::getChunkSize() const
+{
+  int chunkSize = 0;
+  for (auto* engine : engines) {
+    if (engine->isPrepared()) {
+      chunkSize = chunkSize == 0
+                    ? engine->maxNumSamples
+                    : std::min(chunkSize, engine->maxNumSamples);
+    }
+  }
+  return chunkSize;
+}
+
+void
+EngineBatch::process(double* const* const* io, int const numSamples)
+{
+  int const chunkSize = getChunkSize();
+  if (chunkSize == 0) {
+    return;
+  }
+  int const numEngines = getNumEngines();
+  for (int offset = 0; offset < numSamples; offset += chunkSize) {
+    int const n = std::min(chunkSize, numSamples - offset);
+    for (int e = 0; e < numEngines; ++e) {
+      chunks[e] = { io[e][0] + offset, io[e][1] + offset };
+    }
+    processChunk(n);
+  }
+}
+
+void
+EngineBatch::process(float* const* const* io, int const numSamples)
+{
+  int const chunkSize = getChunkSize();
+  if (chunkSize == 0) {
+    return;
+  }
+  int const numEngines = getNumEngines();
+  for (int offset = 0; offset < numSamples; offset += chunkSize) {
+    int const n = std::min(chunkSize, numSamples - offset);
+    for (int e = 0; e < numEngines; ++e) {
+      auto& engine = *engines[e];
+      if (!engine.isPrepared()) {
+        continue;
+      }
+      for (int c = 0; c < 2; ++c) {
+        std::copy(io[e][c] + offset, io[e][c] + offset + n, engine.scratch[c]);
+      }
+      chunks[e] = { engine.scratch[0], engine.scratch[1] };
+    }
+    processChunk(n);
+    for (int e = 0; e < numEngines; ++e) {
+      auto& engine = *engines[e];
+      if (!engine.isPrepared()) {
+        continue;
+      }
+      for (int c = 0; c < 2; ++c) {
+        for (int i = 0; i < n; ++i) {
+          io[e][c][offset + i] = static_cast<float>(engine.scratch[c][i]);
+        }
+      }
+    }
+  }
+}
+
+void
+EngineBatch::processChunk(int const numSamples)
+{
+  int const numEngines = getNumEngines();
+
+  waveshaping.clear();
+  for (int e = 0; e < numEngines; ++e) {
+    auto& engine = *engines[e];
+    if (!engine.isPrepared() ||
+        !engine.beginBlock(chunks[e].data(), numSamples)) {
+      continue;
+    }
+    // the bands are split and merged around the first stage, so the engines
+    // that use them are waveshaped on their own
+    if (engine.numActiveBands > 1) {
+      engine.waveshape(engine.waveshapers,
+                       engine.getUpsampledIo(),
+                       *engine.crossover,
+                       engine.pending.upsampledAlpha,
+                       1);
+    }
+    else {
+      waveshaping.push_back(&engine);
+    }
+  }
+
+  for (int s = 0; s < Engine::maxNumStages; ++s) {
+    waveshapeStage(s);
+  }
+
+  for (auto* engine : engines) {
+    if (engine->isPrepared()) {
+      engine->endBlock();
+    }
+  }
+}
+
+// the stage of each engine, as Engine::waveshape does it with a single band
+void
+EngineBatch::waveshapeStage(int const stage)
+{
+  settled.clear();
+  for (auto* engine : waveshaping) {
+    if (stage >= engine->numActiveStages) {
+      continue;
+    }
+    auto& io = engine->getUpsampledIo();
+    auto& waveshaper = *engine->waveshapers[stage];
+    int const numKnots = engine->numKnots[stage];
+    double const alpha = engine->pending.upsampledAlpha;
+    waveshaper.setSmoothingAlpha(alpha);
+    if (stage > 0) {
+      waveshaper.applyGain(
+        io, Vec2d().load(engine->pending.splineGainTarget[stage]), alpha);
+    }
+    if (waveshaper.isSettledFor(numKnots, io.getNumSamples())) {
+      settled.push_back(engine);
+    }
+    else {
+      waveshaper.waveshape(io, numKnots);
+    }
+  }
+
+  // groups the engines with the same number of knots and of samples
+  while (!settled.empty()) {
+    Engine* group[maxNumEnginesPerSpline];
+    group[0] = settled.back();
+    settled.pop_back();
+    int groupSize = 1;
+    int const numKnots = group[0]->numKnots[stage];
+    int const numSamples = group[0]->getUpsampledIo().getNumSamples();
+    for (int i = static_cast<int>(settled.size()) - 1;
+         i >= 0 && groupSize < maxNumEnginesPerSpline;
+         --i) {
+      auto* engine = settled[i];
+      if (engine->numKnots[stage] == numKnots &&
+          engine->getUpsampledIo().getNumSamples() == numSamples) {
+        group[groupSize++] = engine;
+        settled.erase(settled.begin() + i);
+      }
+    }
+    if (groupSize == 1) {
+      group[0]->waveshapers[stage]->waveshape(group[0]->getUpsampledIo(),
+                                              numKnots);
+    }
+    else {
+      waveshapeGroup(group, groupSize, stage);
+    }
+  }
+}
+
+// Lane 2 * e + c holds the channel c of the engine e of the group, and each
+// wide vector a sample of all of them. The lanes past the group repeat the
+// first engine.
+void
+EngineBatch::waveshapeGroup(Engine* const* group,
+                            int const groupSize,
+                            int const stage)
+{
+  int const numKnots = group[0]->numKnots[stage];
+
+  VecBuffer<Vec2d>* ios[maxNumEnginesPerSpline];
+  for (int e = 0; e < maxNumEnginesPerSpline; ++e) {
+    ios[e] = &group[e < groupSize ? e : 0]->getUpsampledIo();
+  }
+  int const numSamples = ios[0]->getNumSamples();
+
+  auto& spline = *wideSpline;
+  for (int lane = 0; lane < width; ++lane) {
+    int const e = lane / 2;
+    auto const& waveshaper = *group[e < groupSize ? e : 0]->waveshapers[stage];
+    waveshaper.setupLane(spline, lane, lane % 2, numKnots);
+  }
+  spline.automator.setSmoothingAlpha(0.0);
+  spline.reset();
+
+  alignas(64) double lanes[width];
+
+  for (int begin = 0; begin < numSamples; begin += tileSize) {
+    int const end = std::min(begin + tileSize, numSamples);
+    wideBuffer.setNumSamples(end - begin);
+
+    for (int i = begin; i < end; ++i) {
+      for (int e = 0; e < maxNumEnginesPerSpline; ++e) {
+        Vec2d const x = (*ios[e])[i];
+        lanes[2 * e] = x[0];
+        lanes[2 * e + 1] = x[1];
+      }
+      wideBuffer[i - begin] = WideVec().load_a(lanes);
+    }
+
+    spline.processBlock(wideBuffer, wideBuffer, numKnots);
+
+    for (int i = begin; i < end; ++i) {
+      WideVec const y = wideBuffer[i - begin];
+      y.store_a(lanes);
+      for (int e = 0; e < groupSize; ++e) {
+        (*ios[e])[i] = Vec2d(lanes[2 * e], lanes[2 * e + 1]);
+      }
+    }
+  }
+}
+
+} // namespace overdraw
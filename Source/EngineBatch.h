@@ -0,0 +1,95 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Engine.h"
+#include <array>
+#include <vector>
+
+namespace overdraw {
+
+/**
+ * Processes several engines in the same call, waveshaping them together: the
+ * settled splines of up to WideVec::size() / 2 engines run as the lanes of a
+ * single wide spline, a lane per channel, with the knots of each lane taken
+ * from its own engine. Everything else, and the splines that are moving, run
+ * per engine.
+ * The output is the same as the one of each engine processed on its own with
+ * blocks of at most the smallest maxNumSamples of the batch, as the spline is
+ * evaluated independently on each lane.
+ * Only the engines that use a single band and whose upsampled blocks have the
+ * same length and the same number of knots share the wide splines, so the
+ * batch is worth it with engines that have the same oversampling settings.
+ * Engines that are processed concurrently, on different threads, must not
+ * be in the same batch: they can be processed on their own with
+ * Engine::process.
+ */
+class EngineBatch final
+{
+public:
+  EngineBatch();
+  ~EngineBatch();
+
+  EngineBatch(EngineBatch const&) = delete;
+  EngineBatch& operator=(EngineBatch const&) = delete;
+
+  /**
+   * Adds an engine after the ones already in the batch. Allocates, process
+   * does not.
+   */
+  void add(Engine& engine);
+
+  void remove(Engine& engine);
+
+  int getNumEngines() const { return static_cast<int>(engines.size()); }
+
+  /**
+   * Processes numSamples samples of each engine, in place: io[e] holds the
+   * two channels of the engine added e-th. Engines that are not prepared are
+   * left untouched.
+   */
+  void process(double* const* const* io, int numSamples);
+  void process(float* const* const* io, int numSamples);
+
+private:
+  static constexpr int width = WideVec::size();
+  static constexpr int maxNumEnginesPerSpline = width / 2;
+  // the wide vectors that are gathered, waveshaped and scattered at once,
+  // few enough to stay in the L1 cache
+  static constexpr int tileSize = 64;
+
+  int getChunkSize() const;
+  void processChunk(int numSamples);
+  void waveshapeStage(int stage);
+  void waveshapeGroup(Engine* const* group, int groupSize, int stage);
+
+  std::vector<Engine*> engines;
+  // the chunks of the current call, per engine
+  std::vector<std::array<double*, 2>> chunks;
+  // the engines that waveshape the current chunk
+  std::vector<Engine*> waveshaping;
+  // the engines whose stage is settled, to be grouped
+  std::vector<Engine*> settled;
+
+  aligned_ptr<WideSpline> wideSpline;
+  VecBuffer<WideVec> wideBuffer{ tileSize };
+};
+
+} // namespace overdraw
@@ -0,0 +1,472 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "FftOversampling.h"
+#include "WorkerPool.h"
+#include "pffft_double/pffft_double.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace overdraw {
+
+namespace {
+
+constexpr double pi = 3.14159265358979323846;
+
+constexpr int minPartitionSize = 16;
+constexpr int maxPartitionSize = 512;
+constexpr int minTapsPerBranch = 16;
+
+// stopband attenuation of the Kaiser window design
+constexpr double stopbandAttenuation = 120.0;
+
+double
+besselI0(double x)
+{
+  double sum = 1.0;
+  double term = 1.0;
+  double const halfX = 0.5 * x;
+  for (int k = 1; k < 64; ++k) {
+    double const f = halfX / k;
+    term *= f * f;
+    sum += term;
+    if (term < 1e-21 * sum) {
+      break;
+    }
+  }
+  return sum;
+}
+
+void
+zero(double* data, int n)
+{
+  std::fill(data, data + n, 0.0);
+}
+
+} // namespace
+
+template<class Function>
+void
+FftOversampling::forEachChannel(Function&& function)
+{
+  static_assert(numChannels == 2);
+  if (workerPool) {
+    TaskGroup group;
+    auto secondChannel = [&] { function(1); };
+    workerPool->submit(group, secondChannel);
+    function(0);
+    workerPool->wait(group);
+  }
+  else {
+    for (int c = 0; c < numChannels; ++c) {
+      function(c);
+    }
+  }
+}
+
+FftOversampling::FftOversampling() = default;
+
+FftOversampling::~FftOversampling()
+{
+  if (setup) {
+    pffftd_destroy_setup(setup);
+  }
+}
+
+bool
+FftOversampling::prepare(uint32_t oversamplingFactor,
+                         uint32_t maxNumSamples,
+                         uint32_t latency)
+{
+  if (!configure(oversamplingFactor, maxNumSamples, latency)) {
+    return false;
+  }
+  ownArena.build([this](Arena& arena) { carve(arena); });
+  initialize();
+  return true;
+}
+
+bool
+FftOversampling::configure(uint32_t oversamplingFactor,
+                           uint32_t maxNumSamples,
+                           uint32_t latency)
+{
+  if (setup) {
+    pffftd_destroy_setup(setup);
+    setup = nullptr;
+  }
+  filterSpectra = nullptr;
+  upSampleOutput = VecBuffer<Vec2d>{ 0 };
+  downSampleOutput = VecBuffer<Vec2d>{ 0 };
+
+  if (oversamplingFactor < 2) {
+    return false;
+  }
+
+  // The latency is 2 * partitionSize + tapsPerBranch - 1. The partition is
+  // the largest power of two that leaves room for at least two partitions of
+  // taps: larger partitions mean fewer, cheaper spectral products, longer
+  // branches mean a steeper transition band.
+  int const latencyBudget = static_cast<int>(latency);
+  int newPartitionSize = 0;
+  for (int size = minPartitionSize; size <= maxPartitionSize; size *= 2) {
+    int const taps = latencyBudget - 2 * size + 1;
+    if (taps >= std::max(minTapsPerBranch, 2 * size)) {
+      newPartitionSize = size;
+    }
+  }
+  if (newPartitionSize == 0) {
+    int const taps = latencyBudget - 2 * minPartitionSize + 1;
+    if (taps < minTapsPerBranch) {
+      return false;
+    }
+    newPartitionSize = minPartitionSize;
+  }
+
+  factor = oversamplingFactor;
+  maxNumInputSamples = maxNumSamples;
+  partitionSize = newPartitionSize;
+  fftSize = 2 * partitionSize;
+  tapsPerBranch = latencyBudget - 2 * partitionSize + 1;
+  numPartitions = (tapsPerBranch + partitionSize - 1) / partitionSize;
+
+  setup = pffftd_new_setup(fftSize, PFFFT_REAL);
+
+  return setup != nullptr;
+}
+
+void
+FftOversampling::carve(Arena& arena)
+{
+  size_t const numBranches = factor;
+  size_t const size = fftSize;
+  size_t const partitions = numPartitions;
+  size_t const partition = partitionSize;
+
+  filterSpectra = arena.carve<double>(numBranches * partitions * size);
+
+  for (auto& channelScratch : scratch) {
+    channelScratch.work = arena.carve<double>(size);
+    channelScratch.spectrum = arena.carve<double>(size);
+    channelScratch.timeDomain = arena.carve<double>(size);
+  }
+
+  for (auto& channel : upChannels) {
+    channel.frame = arena.carve<double>(size);
+    channel.delayLine = arena.carve<double>(partitions * size);
+    channel.outputBlock = arena.carve<double>(partition * numBranches);
+  }
+
+  for (auto& channel : downChannels) {
+    channel.input = arena.carve<double>((partition + 1) * numBranches);
+    channel.branchFrames = arena.carve<double>(numBranches * size);
+    channel.accumulators = arena.carve<double>(partitions * size);
+    channel.outputBlock = arena.carve<double>(partition);
+  }
+}
+
+void
+FftOversampling::initialize()
+{
+  designFilter();
+  auto const maxIn = static_cast<int>(maxNumInputSamples);
+  upSampleOutput = VecBuffer<Vec2d>{ maxIn * static_cast<int>(factor) };
+  downSampleOutput = VecBuffer<Vec2d>{ maxIn };
+  reset();
+}
+
+void
+FftOversampling::designFilter()
+{
+  // Kaiser-windowed sinc of (tapsPerBranch - 1) * factor + 1 taps at the
+  // upsampled rate, so that the group delays of the up and down filters sum
+  // to a whole number of base-rate samples. The stopband starts at the
+  // base-rate Nyquist frequency, the transition band is the narrowest that
+  // the length allows for the target attenuation.
+
+  int const numBranches = static_cast<int>(factor);
+  int const numTaps = (tapsPerBranch - 1) * numBranches + 1;
+  double const center = 0.5 * (numTaps - 1);
+
+  double const transitionBand = (stopbandAttenuation - 8.0) /
+                                (2.285 * 2.0 * pi * (numTaps - 1));
+  double const cutoff =
+    std::max(0.25 / numBranches, 0.5 / numBranches - 0.5 * transitionBand);
+
+  double const beta = 0.1102 * (stopbandAttenuation - 8.7);
+  double const windowNormalization = 1.0 / besselI0(beta);
+
+  auto taps = std::vector<double>(
+    static_cast<size_t>(tapsPerBranch) * numBranches, 0.0);
+
+  double sum = 0.0;
+  for (int i = 0; i < numTaps; ++i) {
+    double const t = i - center;
+    double const sinc =
+      t == 0.0 ? 2.0 * cutoff
+               : std::sin(2.0 * pi * cutoff * t) / (pi * t);
+    double const r = center > 0.0 ? t / center : 0.0;
+    double const window =
+      besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) *
+      windowNormalization;
+    taps[i] = sinc * window;
+    sum += taps[i];
+  }
+  for (auto& tap : taps) {
+    tap /= sum;
+  }
+
+  // branch b is h[k * factor + b]; each of its partitions is zero padded to
+  // the fft size and transformed in pffft's internal layout, which is what
+  // pffftd_zconvolve_accumulate expects
+
+  double* timeDomain = scratch[0].timeDomain;
+
+  for (int b = 0; b < numBranches; ++b) {
+    for (int p = 0; p < numPartitions; ++p) {
+      zero(timeDomain, fftSize);
+      for (int i = 0; i < partitionSize; ++i) {
+        int const k = p * partitionSize + i;
+        if (k < tapsPerBranch) {
+          timeDomain[i] = taps[static_cast<size_t>(k) * numBranches + b];
+        }
+      }
+      pffftd_transform(setup,
+                       timeDomain,
+                       getFilterSpectrum(b, p),
+                       scratch[0].work,
+                       PFFFT_FORWARD);
+    }
+  }
+}
+
+void
+FftOversampling::prepareBuffers(uint32_t numInputSamples)
+{
+  auto const numUpsampledSamples = static_cast<int>(numInputSamples * factor);
+  if (upSampleOutput.getNumSamples() < numUpsampledSamples) {
+    upSampleOutput.setNumSamples(numUpsampledSamples);
+  }
+  if (downSampleOutput.getNumSamples() < static_cast<int>(numInputSamples)) {
+    downSampleOutput.setNumSamples(static_cast<int>(numInputSamples));
+  }
+}
+
+void
+FftOversampling::reset()
+{
+  if (!isPrepared()) {
+    return;
+  }
+
+  int const numBranches = static_cast<int>(factor);
+
+  for (auto& channel : upChannels) {
+    zero(channel.frame, fftSize);
+    zero(channel.delayLine, numPartitions * fftSize);
+    zero(channel.outputBlock, partitionSize * numBranches);
+  }
+  for (auto& channel : downChannels) {
+    zero(channel.input, (partitionSize + 1) * numBranches);
+    zero(channel.branchFrames, numBranches * fftSize);
+    zero(channel.accumulators, numPartitions * fftSize);
+    zero(channel.outputBlock, partitionSize);
+  }
+
+  upDelayLineHead = 0;
+  upFill = 0;
+  downAccumulatorHead = 0;
+  downFill = 0;
+}
+
+uint32_t
+FftOversampling::upSample(double* const* input, uint32_t numSamples)
+{
+  int const numBranches = static_cast<int>(factor);
+  int const n = static_cast<int>(numSamples);
+
+  upSampleOutput.setNumSamples(n * numBranches);
+
+  // The output of each complete block is read while the next one is being
+  // filled, which is where the partitionSize samples of latency come from.
+
+  int done = 0;
+  while (done < n) {
+    int const k = std::min(n - done, partitionSize - upFill);
+
+    for (int c = 0; c < numChannels; ++c) {
+      std::copy(input[c] + done,
+                input[c] + done + k,
+                upChannels[c].frame + partitionSize + upFill);
+    }
+
+    double const* left = upChannels[0].outputBlock + upFill * numBranches;
+    double const* right =
+      upChannels[1].outputBlock + upFill * numBranches;
+    int const offset = done * numBranches;
+    for (int i = 0; i < k * numBranches; ++i) {
+      upSampleOutput[offset + i] = Vec2d(left[i], right[i]);
+    }
+
+    upFill += k;
+    done += k;
+
+    if (upFill == partitionSize) {
+      upDelayLineHead = (upDelayLineHead + numPartitions - 1) % numPartitions;
+      forEachChannel([this](int c) { processUpSamplingBlock(c); });
+      upFill = 0;
+    }
+  }
+
+  return static_cast<uint32_t>(n * numBranches);
+}
+
+void
+FftOversampling::processUpSamplingBlock(int c)
+{
+  int const numBranches = static_cast<int>(factor);
+  double const scale = static_cast<double>(numBranches) / fftSize;
+
+  auto& channel = upChannels[c];
+  double* frame = channel.frame;
+  double* delayLine = channel.delayLine;
+  double* spectrum = scratch[c].spectrum;
+  double* timeDomain = scratch[c].timeDomain;
+  double* work = scratch[c].work;
+
+  pffftd_transform(
+    setup, frame, delayLine + upDelayLineHead * fftSize, work, PFFFT_FORWARD);
+
+  for (int b = 0; b < numBranches; ++b) {
+    zero(spectrum, fftSize);
+    for (int p = 0; p < numPartitions; ++p) {
+      int const slot = (upDelayLineHead + p) % numPartitions;
+      pffftd_zconvolve_accumulate(setup,
+                                  delayLine + slot * fftSize,
+                                  getFilterSpectrum(b, p),
+                                  spectrum,
+                                  scale);
+    }
+    pffftd_transform(setup, spectrum, timeDomain, work, PFFFT_BACKWARD);
+
+    double* output = channel.outputBlock + b;
+    for (int i = 0; i < partitionSize; ++i) {
+      output[i * numBranches] = timeDomain[partitionSize + i];
+    }
+  }
+
+  std::copy(frame + partitionSize, frame + fftSize, frame);
+}
+
+void
+FftOversampling::downSample(VecBuffer<Vec2d>& input, uint32_t numOutputSamples)
+{
+  int const numBranches = static_cast<int>(factor);
+  int const n = static_cast<int>(numOutputSamples);
+
+  downSampleOutput.setNumSamples(n);
+
+  int done = 0;
+  while (done < n) {
+    int const k = std::min(n - done, partitionSize - downFill);
+
+    double* left =
+      downChannels[0].input + (1 + downFill) * numBranches;
+    double* right =
+      downChannels[1].input + (1 + downFill) * numBranches;
+    int const offset = done * numBranches;
+    for (int i = 0; i < k * numBranches; ++i) {
+      Vec2d const x = input[offset + i];
+      left[i] = x[0];
+      right[i] = x[1];
+    }
+
+    double const* outputLeft = downChannels[0].outputBlock + downFill;
+    double const* outputRight = downChannels[1].outputBlock + downFill;
+    for (int i = 0; i < k; ++i) {
+      downSampleOutput[done + i] = Vec2d(outputLeft[i], outputRight[i]);
+    }
+
+    downFill += k;
+    done += k;
+
+    if (downFill == partitionSize) {
+      forEachChannel([this](int c) { processDownSamplingBlock(c); });
+      downAccumulatorHead = (downAccumulatorHead + 1) % numPartitions;
+      downFill = 0;
+    }
+  }
+}
+
+void
+FftOversampling::processDownSamplingBlock(int c)
+{
+  int const numBranches = static_cast<int>(factor);
+  double const scale = 1.0 / fftSize;
+
+  auto& channel = downChannels[c];
+  double* input = channel.input;
+  double* accumulators = channel.accumulators;
+  double* spectrum = scratch[c].spectrum;
+  double* timeDomain = scratch[c].timeDomain;
+  double* work = scratch[c].work;
+
+  // branch b sees x[n * factor - b]: input[0, factor) holds the tail of the
+  // previous block, so input[factor + i * factor - b] is the sample of the
+  // branch at the i-th output of this block
+
+  for (int b = 0; b < numBranches; ++b) {
+    double* frame = channel.branchFrames + b * fftSize;
+    for (int i = 0; i < partitionSize; ++i) {
+      frame[partitionSize + i] = input[(i + 1) * numBranches - b];
+    }
+
+    pffftd_transform(setup, frame, spectrum, work, PFFFT_FORWARD);
+
+    for (int p = 0; p < numPartitions; ++p) {
+      int const slot = (downAccumulatorHead + p) % numPartitions;
+      pffftd_zconvolve_accumulate(setup,
+                                  spectrum,
+                                  getFilterSpectrum(b, p),
+                                  accumulators + slot * fftSize,
+                                  scale);
+    }
+
+    std::copy(frame + partitionSize, frame + fftSize, frame);
+  }
+
+  // the current block has now received the contributions of all the
+  // partitions
+
+  double* current = accumulators + downAccumulatorHead * fftSize;
+  pffftd_transform(setup, current, timeDomain, work, PFFFT_BACKWARD);
+  zero(current, fftSize);
+
+  std::copy(timeDomain + partitionSize,
+            timeDomain + fftSize,
+            channel.outputBlock);
+
+  std::copy(input + partitionSize * numBranches,
+            input + (partitionSize + 1) * numBranches,
+            input);
+}
+
+} // namespace overdraw
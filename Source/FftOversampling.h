@@ -0,0 +1,205 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Arena.h"
+#include "avec/Avec.hpp"
+#include <cstdint>
+
+struct PFFFTD_Setup;
+
+namespace overdraw {
+
+class WorkerPool;
+
+/**
+ * Stereo linear-phase oversampling by an integer factor, as an alternative to
+ * the direct-form linear-phase FIR cascade of oversimple.
+ * A single Kaiser-windowed sinc is split in its polyphase branches, which are
+ * run at the base rate with uniformly partitioned overlap-save convolution on
+ * pffft: upsampling shares one forward FFT of the input among all the
+ * branches, downsampling accumulates all the branches in the frequency domain
+ * and needs a single inverse FFT. The cost of the branches grows with the
+ * factor only through cheap spectral multiply-adds.
+ * The up and down filters are sized so that their total latency, including
+ * the block buffering of the partitioned convolution, is exactly the one
+ * requested in prepare(), so the engine can replace the direct one without
+ * changing the latency reported to the host.
+ * The interface mirrors oversimple::TOversampling for interleaved buffers.
+ */
+class FftOversampling final
+{
+public:
+  static constexpr int numChannels = 2;
+
+  FftOversampling();
+  ~FftOversampling();
+
+  FftOversampling(FftOversampling const&) = delete;
+  FftOversampling& operator=(FftOversampling const&) = delete;
+
+  /**
+   * Designs the filters and allocates the buffers in a memory block of its
+   * own. Shorthand for configure, carve on an own Arena and initialize.
+   * @param oversamplingFactor the oversampling factor, at least 2
+   * @param maxNumInputSamples the expected maximum number of samples per block
+   * @param latency the latency, in base-rate samples, of upsampling and
+   * downsampling together
+   * @return false if no filter of acceptable length fits in the latency, in
+   * which case the engine is left unprepared.
+   */
+  bool prepare(uint32_t oversamplingFactor,
+               uint32_t maxNumInputSamples,
+               uint32_t latency);
+
+  /**
+   * Chooses the partition and filter sizes, see prepare. The engine is
+   * prepared after carving its memory and initializing.
+   */
+  bool configure(uint32_t oversamplingFactor,
+                 uint32_t maxNumInputSamples,
+                 uint32_t latency);
+
+  /**
+   * Takes the memory of the filter and of the convolution state from an
+   * arena, after configure.
+   */
+  void carve(Arena& arena);
+
+  /**
+   * Designs the filter and resets the state, after the final carve.
+   */
+  void initialize();
+
+  bool isPrepared() const { return setup != nullptr && filterSpectra; }
+
+  /**
+   * @return the bytes used by the buffers that are not carved from the arena,
+   * which initialize sizes for the longest blocks
+   */
+  size_t getBufferMemory() const
+  {
+    return isPrepared() ? sizeof(Vec2d) * maxNumInputSamples * (factor + 1)
+                        : 0;
+  }
+
+  uint32_t getOversamplingRate() const { return factor; }
+
+  uint32_t getLatency() const
+  {
+    return static_cast<uint32_t>(2 * partitionSize + tapsPerBranch - 1);
+  }
+
+  /**
+   * Makes sure the output buffers can hold the result of a block of
+   * numInputSamples. Allocates only if they can't.
+   */
+  void prepareBuffers(uint32_t numInputSamples);
+
+  void reset();
+
+  /**
+   * When set, the two channels of each partition are processed in parallel on
+   * the pool. Offline rendering only, see WorkerPool.
+   */
+  void setWorkerPool(WorkerPool* pool) { workerPool = pool; }
+
+  /**
+   * Upsamples numSamples samples from each of the two channels.
+   * @return the number of upsampled samples
+   */
+  uint32_t upSample(double* const* input, uint32_t numSamples);
+
+  VecBuffer<Vec2d>& getUpSampleOutput() { return upSampleOutput; }
+
+  /**
+   * Downsamples numOutputSamples * getOversamplingRate() interleaved samples.
+   */
+  void downSample(VecBuffer<Vec2d>& input, uint32_t numOutputSamples);
+
+  VecBuffer<Vec2d>& getDownSampleOutput() { return downSampleOutput; }
+
+private:
+  void designFilter();
+  void processUpSamplingBlock(int channel);
+  void processDownSamplingBlock(int channel);
+
+  template<class Function>
+  void forEachChannel(Function&& function);
+
+  double* getFilterSpectrum(int branch, int partition)
+  {
+    return filterSpectra + (branch * numPartitions + partition) * fftSize;
+  }
+
+  uint32_t factor = 1;
+  uint32_t maxNumInputSamples = 0;
+  int partitionSize = 0;
+  int fftSize = 0;
+  int tapsPerBranch = 1;
+  int numPartitions = 0;
+
+  PFFFTD_Setup* setup = nullptr;
+  Arena ownArena;
+  double* filterSpectra = nullptr;
+
+  // per channel, so that the channels can be processed concurrently
+  struct Scratch final
+  {
+    double* work = nullptr;
+    double* spectrum = nullptr;
+    double* timeDomain = nullptr;
+  };
+  Scratch scratch[numChannels];
+
+  WorkerPool* workerPool = nullptr;
+
+  // upsampling: the input frames of the overlap-save, a frequency domain
+  // delay line of their spectra and the output of the last complete block,
+  // which is read while the next block is being filled
+  struct UpSamplingChannel final
+  {
+    double* frame = nullptr;
+    double* delayLine = nullptr;
+    double* outputBlock = nullptr;
+  };
+  UpSamplingChannel upChannels[numChannels];
+  int upDelayLineHead = 0;
+  int upFill = 0;
+
+  // downsampling: the upsampled input (preceded by the last factor samples of
+  // the previous block), one overlap-save frame per polyphase branch, and the
+  // spectra of the output blocks still receiving contributions
+  struct DownSamplingChannel final
+  {
+    double* input = nullptr;
+    double* branchFrames = nullptr;
+    double* accumulators = nullptr;
+    double* outputBlock = nullptr;
+  };
+  DownSamplingChannel downChannels[numChannels];
+  int downAccumulatorHead = 0;
+  int downFill = 0;
+
+  VecBuffer<Vec2d> upSampleOutput{ 0 };
+  VecBuffer<Vec2d> downSampleOutput{ 0 };
+};
+
+} // namespace overdraw
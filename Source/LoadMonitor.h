@@ -0,0 +1,184 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace overdraw {
+
+/**
+ * Statistics of the time spent processing each block, relative to the
+ * duration of the block, which is the real-time budget of the callback.
+ * The audio thread is the only writer, so recording is wait-free and takes
+ * no read-modify-write instructions. Any thread can read a report or ask for
+ * a reset, which the audio thread performs at the next block.
+ */
+class LoadMonitor final
+{
+public:
+  // 5% wide bins up to 100%, then one bin for the blocks over budget
+  static constexpr int numBins = 21;
+  static constexpr double binWidth = 0.05;
+
+  struct Report final
+  {
+    std::array<uint64_t, numBins> histogram{};
+    uint64_t numBlocks = 0;
+    uint64_t numDeadlineMisses = 0;
+    // as fractions of the budget
+    double averageLoad = 0.0;
+    double worstLoad = 0.0;
+  };
+
+  /**
+   * Times the scope and records it against the given budget.
+   */
+  class Scope final
+  {
+  public:
+    Scope(LoadMonitor& monitor, double budgetSeconds)
+      : monitor(monitor)
+      , budgetSeconds(budgetSeconds)
+      , start(std::chrono::steady_clock::now())
+    {}
+
+    ~Scope()
+    {
+      auto const elapsed = std::chrono::steady_clock::now() - start;
+      monitor.record(std::chrono::duration<double>(elapsed).count(),
+                     budgetSeconds);
+    }
+
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+  private:
+    LoadMonitor& monitor;
+    double const budgetSeconds;
+    std::chrono::steady_clock::time_point const start;
+  };
+
+  /**
+   * Audio thread only.
+   */
+  void record(double elapsedSeconds, double budgetSeconds)
+  {
+    if (budgetSeconds <= 0.0) {
+      return;
+    }
+    if (isResetRequested.exchange(false, std::memory_order_acquire)) {
+      clear();
+    }
+    double const load = elapsedSeconds / budgetSeconds;
+    lastLoad.store(load, std::memory_order_relaxed);
+    int const bin = std::min(numBins - 1, static_cast<int>(load / binWidth));
+    increment(histogram[bin]);
+    increment(numBlocks);
+    if (load > 1.0) {
+      increment(numDeadlineMisses);
+    }
+    totalLoad.store(totalLoad.load(std::memory_order_relaxed) + load,
+                    std::memory_order_relaxed);
+    if (load > worstLoad.load(std::memory_order_relaxed)) {
+      worstLoad.store(load, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * The counters are read one by one, so a report taken while processing may
+   * be off by a block.
+   */
+  Report getReport() const
+  {
+    Report report;
+    for (int i = 0; i < numBins; ++i) {
+      report.histogram[i] = histogram[i].load(std::memory_order_relaxed);
+    }
+    report.numBlocks = numBlocks.load(std::memory_order_relaxed);
+    report.numDeadlineMisses =
+      numDeadlineMisses.load(std::memory_order_relaxed);
+    report.worstLoad = worstLoad.load(std::memory_order_relaxed);
+    if (report.numBlocks > 0) {
+      report.averageLoad = totalLoad.load(std::memory_order_relaxed) /
+                           static_cast<double>(report.numBlocks);
+    }
+    return report;
+  }
+
+  /**
+   * @return the load of the last recorded block, which is not cleared by a
+   * reset
+   */
+  double getLastLoad() const
+  {
+    return lastLoad.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Audio thread only. Replaces the load of the last recorded block, for a
+   * replay of a captured session, see SessionCapture.
+   */
+  void setLastLoad(double load)
+  {
+    lastLoad.store(load, std::memory_order_relaxed);
+  }
+
+  uint64_t getNumDeadlineMisses() const
+  {
+    return numDeadlineMisses.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Clears the statistics before the next recorded block. Any thread.
+   */
+  void reset() { isResetRequested.store(true, std::memory_order_release); }
+
+private:
+  static void increment(std::atomic<uint64_t>& counter)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  }
+
+  void clear()
+  {
+    for (auto& bin : histogram) {
+      bin.store(0, std::memory_order_relaxed);
+    }
+    numBlocks.store(0, std::memory_order_relaxed);
+    numDeadlineMisses.store(0, std::memory_order_relaxed);
+    totalLoad.store(0.0, std::memory_order_relaxed);
+    worstLoad.store(0.0, std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<uint64_t>, numBins> histogram{};
+  std::atomic<uint64_t> numBlocks{ 0 };
+  std::atomic<uint64_t> numDeadlineMisses{ 0 };
+  std::atomic<double> totalLoad{ 0.0 };
+  std::atomic<double> worstLoad{ 0.0 };
+  std::atomic<double> lastLoad{ 0.0 };
+  std::atomic<bool> isResetRequested{ false };
+};
+
+} // namespace overdraw
@@ -0,0 +1,115 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "LoadOverlay.h"
+
+LoadOverlay::LoadOverlay(OverdrawAudioProcessor& processor)
+  : processor(processor)
+{
+  setInterceptsMouseClicks(true, false);
+}
+
+void
+LoadOverlay::visibilityChanged()
+{
+  if (isVisible()) {
+    timerCallback();
+    startTimerHz(4);
+  }
+  else {
+    stopTimer();
+  }
+}
+
+void
+LoadOverlay::timerCallback()
+{
+  auto const newReport = processor.getLoadReport();
+  // nothing to redraw while the host is not processing
+  if (newReport.numBlocks != report.numBlocks) {
+    report = newReport;
+    repaint();
+  }
+}
+
+void
+LoadOverlay::mouseDown(MouseEvent const&)
+{
+  processor.resetLoadReport();
+  report = {};
+  repaint();
+}
+
+void
+LoadOverlay::paint(Graphics& g)
+{
+  auto bounds = getLocalBounds();
+
+  g.setColour(backgroundColour);
+  g.fillRect(bounds);
+  g.setColour(lineColour);
+  g.drawRect(bounds, 1);
+
+  bounds.reduce(6, 4);
+
+  auto const toPercent = [](double load) {
+    return String(roundToInt(100.0 * load)) + "%";
+  };
+
+  int const lineHeight = roundToInt(getHeight() * 0.14f);
+  g.setColour(Colours::white);
+  g.setFont(Font(lineHeight * 0.8f));
+  g.drawText("Load " + toPercent(report.averageLoad) + ", worst " +
+               toPercent(report.worstLoad),
+             bounds.removeFromTop(lineHeight),
+             Justification::centredLeft);
+  g.drawText("Deadline misses " + String(report.numDeadlineMisses) + " / " +
+               String(report.numBlocks),
+             bounds.removeFromTop(lineHeight),
+             Justification::centredLeft);
+  if (processor.isAdaptiveOversamplingEnabled()) {
+    int const order = processor.getOversamplingOrderInUse();
+    g.drawText("Adaptive oversampling " + String(1 << order) + "x",
+               bounds.removeFromTop(lineHeight),
+               Justification::centredLeft);
+  }
+
+  bounds.removeFromTop(4);
+
+  // log scaled bars, 0% on the left, over budget on the right
+  uint64_t const maxCount = *std::max_element(report.histogram.begin(),
+                                              report.histogram.end());
+  if (maxCount == 0) {
+    return;
+  }
+  float const barWidth =
+    bounds.getWidth() / static_cast<float>(overdraw::LoadMonitor::numBins);
+  float const logMax = std::log1p(static_cast<float>(maxCount));
+  for (int i = 0; i < overdraw::LoadMonitor::numBins; ++i) {
+    float const height =
+      bounds.getHeight() *
+      std::log1p(static_cast<float>(report.histogram[i])) / logMax;
+    g.setColour(i == overdraw::LoadMonitor::numBins - 1 ? Colours::red
+                                                        : lineColour);
+    g.fillRect(bounds.getX() + i * barWidth,
+               bounds.getBottom() - height,
+               barWidth - 1.f,
+               height);
+  }
+}
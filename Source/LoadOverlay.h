@@ -0,0 +1,49 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "PluginProcessor.h"
+#include <JuceHeader.h>
+
+/**
+ * Shows the load statistics of the processor: average and worst load,
+ * deadline misses and the histogram of the load of each block.
+ * A click resets the statistics.
+ */
+class LoadOverlay final
+  : public Component
+  , private Timer
+{
+public:
+  explicit LoadOverlay(OverdrawAudioProcessor& processor);
+
+  void paint(Graphics& g) override;
+  void mouseDown(MouseEvent const& event) override;
+  void visibilityChanged() override;
+
+  Colour lineColour = Colours::white;
+  Colour backgroundColour = Colours::black.withAlpha(0.8f);
+
+private:
+  void timerCallback() override;
+
+  OverdrawAudioProcessor& processor;
+  overdraw::LoadMonitor::Report report;
+};
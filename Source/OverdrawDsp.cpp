@@ -23,13 +23,579 @@ along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
 // Clang frontend over the bus-error threshold.
 
 #include "OverdrawDsp.h"
+#include "Ramp.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
 
 namespace overdraw {
 
+void
+Dsp::prepare(int const maxNumSamples)
+{
+  constexpr int width = WideVec::size();
+  wideCapacity = (maxNumSamples + width - 1) / width;
+  bufferOwner = nullptr;
+  for (auto& buffer : wideBuffers) {
+    buffer = VecBuffer<WideVec>{ wideCapacity };
+  }
+  probeBuffer = VecBuffer<WideVec>{ numProbeVectors };
+}
+
+void
+Dsp::prepare(Dsp& owner)
+{
+  wideCapacity = owner.wideCapacity;
+  bufferOwner = &owner;
+  for (auto& buffer : wideBuffers) {
+    buffer = VecBuffer<WideVec>{ 0 };
+  }
+  probeBuffer = VecBuffer<WideVec>{ 0 };
+}
+
+void
+Dsp::reset()
+{
+  autoSpline.reset();
+  for (int k = 0; k < maxNumKnots; ++k) {
+    auto const& knot = autoSpline.spline.knots[k];
+    for (int c = 0; c < 2; ++c) {
+      controlKnots[k][0][c] = knot.x[c];
+      controlKnots[k][1][c] = knot.y[c];
+      controlKnots[k][2][c] = knot.t[c];
+      controlKnots[k][3][c] = knot.s[c];
+    }
+  }
+  // the state is on the targets, the wide splines are set on the next block
+  numSamplesSinceChange = std::numeric_limits<int64_t>::max() / 2;
+  areWideSplinesReady = false;
+  isAffineMapReady = false;
+}
+
+void
+Dsp::copyStateFrom(Dsp const& other)
+{
+  autoSpline = other.autoSpline;
+  wideSplines = other.wideSplines;
+  gain = other.gain;
+  std::copy(&other.lastKnots[0][0][0],
+            &other.lastKnots[0][0][0] + maxNumKnots * 4 * 2,
+            &lastKnots[0][0][0]);
+  for (int c = 0; c < 2; ++c) {
+    isSymmetric[c] = other.isSymmetric[c];
+    lastIsSymmetric[c] = other.lastIsSymmetric[c];
+  }
+  lastNumActiveKnots = other.lastNumActiveKnots;
+  numSamplesSinceChange = other.numSamplesSinceChange;
+  numSamplesToSettle = other.numSamplesToSettle;
+  numSamplesPerVector = other.numSamplesPerVector;
+  areWideSplinesReady = other.areWideSplinesReady;
+  std::copy(&other.controlKnots[0][0][0],
+            &other.controlKnots[0][0][0] + maxNumKnots * 4 * 2,
+            &controlKnots[0][0][0]);
+  smoothingAlpha = other.smoothingAlpha;
+  numVectorsPerUpdate = other.numVectorsPerUpdate;
+  isControlRateAutomationEnabled = other.isControlRateAutomationEnabled;
+  affineMap = other.affineMap;
+  isAffineMapReady = other.isAffineMapReady;
+}
+
+void
+Dsp::copyTargetsFrom(Dsp const& other)
+{
+  auto const& knots = other.autoSpline.spline.knots;
+  std::copy(
+    std::begin(knots), std::end(knots), std::begin(autoSpline.spline.knots));
+  for (int c = 0; c < 2; ++c) {
+    setIsSymmetric(c, other.isSymmetric[c]);
+  }
+}
+
+void
+Dsp::onKnotsChanged()
+{
+  numSamplesSinceChange = 0;
+  areWideSplinesReady = false;
+  isAffineMapReady = false;
+}
+
+void
+Dsp::setupSettledWideSplines(int const numActiveKnots)
+{
+  // the control-rate smoothing, if it was running, lands on the targets
+  std::copy(&lastKnots[0][0][0],
+            &lastKnots[0][0][0] + numActiveKnots * 4 * 2,
+            &controlKnots[0][0][0]);
+  setupWideSplines(numActiveKnots, lastKnots);
+}
+
+void
+Dsp::setSmoothingAlpha(double const alpha, int const samplesPerVector)
+{
+  // the settling is counted in samples, so that it carries over between
+  // buffers that pack a different number of samples in a vector
+  double const vectorAlpha = std::pow(alpha, samplesPerVector);
+  autoSpline.automator.setSmoothingAlpha(vectorAlpha);
+  numSamplesPerVector = samplesPerVector;
+
+  // samples until the smoothing is within 1e-12 of its target
+  constexpr double tolerance = 1.0e-12;
+  numSamplesToSettle =
+    alpha <= 0.0 ? 0
+    : alpha >= 1.0
+      ? std::numeric_limits<int64_t>::max()
+      : static_cast<int64_t>(std::ceil(std::log(tolerance) / std::log(alpha)));
+
+  // a few control-rate updates per time constant of the smoothing, in runs
+  // long enough to amortize setting up the wide splines
+  constexpr double updatesPerTimeConstant = 8.0;
+  constexpr double minVectorsPerUpdate = 4 * WideVec::size();
+  constexpr double maxVectorsPerUpdate = 1024.0;
+  smoothingAlpha = vectorAlpha;
+  constexpr double infinity = std::numeric_limits<double>::infinity();
+  double const timeConstant =
+    vectorAlpha <= 0.0   ? 0.0
+    : vectorAlpha >= 1.0 ? infinity
+                         : -1.0 / std::log(vectorAlpha);
+  numVectorsPerUpdate =
+    static_cast<int>(std::clamp(timeConstant / updatesPerTimeConstant,
+                                minVectorsPerUpdate,
+                                maxVectorsPerUpdate));
+}
+
+bool
+Dsp::haveKnotsChanged(int const numActiveKnots)
+{
+  bool hasChanged = numActiveKnots != lastNumActiveKnots ||
+                    isSymmetric[0] != lastIsSymmetric[0] ||
+                    isSymmetric[1] != lastIsSymmetric[1];
+  for (int k = 0; k < numActiveKnots; ++k) {
+    auto const& knot = autoSpline.spline.knots[k];
+    for (int c = 0; c < 2; ++c) {
+      double const values[4] = { knot.x[c], knot.y[c], knot.t[c], knot.s[c] };
+      for (int v = 0; v < 4; ++v) {
+        hasChanged = hasChanged || lastKnots[k][v][c] != values[v];
+        lastKnots[k][v][c] = values[v];
+      }
+    }
+  }
+  lastNumActiveKnots = numActiveKnots;
+  lastIsSymmetric[0] = isSymmetric[0];
+  lastIsSymmetric[1] = isSymmetric[1];
+  return hasChanged;
+}
+
+// the knots are given as x, y, t, s per channel, as lastKnots
+void
+Dsp::setupWideSplines(int const numActiveKnots,
+                      double const (*knots)[4][2])
+{
+  constexpr int width = WideVec::size();
+  for (int c = 0; c < 2; ++c) {
+    auto& wideSpline = wideSplines[c];
+    for (int k = 0; k < numActiveKnots; ++k) {
+      auto const& knot = knots[k];
+      auto& wideKnot = wideSpline.spline.knots[k];
+      for (int lane = 0; lane < width; ++lane) {
+        wideKnot.x[lane] = knot[0][c];
+        wideKnot.y[lane] = knot[1][c];
+        wideKnot.t[lane] = knot[2][c];
+        wideKnot.s[lane] = knot[3][c];
+      }
+    }
+    for (int lane = 0; lane < width; ++lane) {
+      wideSpline.spline.setIsSymmetric(lane, isSymmetric[c]);
+    }
+    wideSpline.automator.setSmoothingAlpha(0.0);
+    wideSpline.reset();
+  }
+  areWideSplinesReady = true;
+}
+
 void
 Dsp::waveshape(VecBuffer<Vec2d>& io, int const numActiveKnots)
 {
-  autoSpline.processBlock(io, io, numActiveKnots);
+  int const numSamples = io.getNumSamples();
+
+  if (haveKnotsChanged(numActiveKnots)) {
+    onKnotsChanged();
+  }
+
+  constexpr int width = WideVec::size();
+  bool const isSettled = numSamplesSinceChange >= numSamplesToSettle;
+  bool const fitsWideBuffers = (numSamples + width - 1) / width <= wideCapacity;
+
+  if (isSettled && fitsWideBuffers && numSamples >= width) {
+    if (!areWideSplinesReady) {
+      setupSettledWideSplines(numActiveKnots);
+    }
+    waveshapeWide(io, 0, numSamples, numActiveKnots);
+  }
+  else if (!isSettled && isControlRateAutomationEnabled && wideCapacity > 0) {
+    waveshapeControlRate(io, numActiveKnots);
+  }
+  else {
+    autoSpline.processBlock(io, io, numActiveKnots);
+    advanceControlKnots(numActiveKnots, numSamples);
+    numSamplesSinceChange += numSamples * numSamplesPerVector;
+  }
+}
+
+void
+Dsp::setControlRateAutomation(bool const isEnabled)
+{
+  if (isEnabled == isControlRateAutomationEnabled) {
+    return;
+  }
+  isControlRateAutomationEnabled = isEnabled;
+  if (isEnabled || lastNumActiveKnots <= 0) {
+    return;
+  }
+  // the per-sample smoothing did not run at control rate, so its state is
+  // moved to the control-rate knots, keeping the targets
+  auto& knots = autoSpline.spline.knots;
+  double targets[maxNumKnots][4][2];
+  for (int k = 0; k < lastNumActiveKnots; ++k) {
+    for (int c = 0; c < 2; ++c) {
+      targets[k][0][c] = knots[k].x[c];
+      targets[k][1][c] = knots[k].y[c];
+      targets[k][2][c] = knots[k].t[c];
+      targets[k][3][c] = knots[k].s[c];
+      knots[k].x[c] = controlKnots[k][0][c];
+      knots[k].y[c] = controlKnots[k][1][c];
+      knots[k].t[c] = controlKnots[k][2][c];
+      knots[k].s[c] = controlKnots[k][3][c];
+    }
+  }
+  autoSpline.reset();
+  for (int k = 0; k < lastNumActiveKnots; ++k) {
+    for (int c = 0; c < 2; ++c) {
+      knots[k].x[c] = targets[k][0][c];
+      knots[k].y[c] = targets[k][1][c];
+      knots[k].t[c] = targets[k][2][c];
+      knots[k].s[c] = targets[k][3][c];
+    }
+  }
+}
+
+// the per-sample smoothing of numVectors vectors, in closed form, see Ramp.h
+void
+Dsp::advanceControlKnots(int const numActiveKnots, int const numVectors)
+{
+  double const decay = std::pow(smoothingAlpha, numVectors);
+  for (int k = 0; k < numActiveKnots; ++k) {
+    for (int v = 0; v < 4; ++v) {
+      for (int c = 0; c < 2; ++c) {
+        double const target = lastKnots[k][v][c];
+        controlKnots[k][v][c] =
+          target + (controlKnots[k][v][c] - target) * decay;
+      }
+    }
+  }
+}
+
+bool
+Dsp::isSettledFor(int const numActiveKnots, int const numSamples)
+{
+  if (haveKnotsChanged(numActiveKnots)) {
+    onKnotsChanged();
+  }
+  constexpr int width = WideVec::size();
+  bool const isSettled = numSamplesSinceChange >= numSamplesToSettle;
+  bool const fitsWideBuffers = (numSamples + width - 1) / width <= wideCapacity;
+  if (!isSettled || !fitsWideBuffers || numSamples < width) {
+    return false;
+  }
+  // keeps the state as if waveshape had run
+  if (!areWideSplinesReady) {
+    setupSettledWideSplines(numActiveKnots);
+  }
+  return true;
+}
+
+void
+Dsp::setupLane(WideSpline& spline,
+               int const lane,
+               int const channel,
+               int const numActiveKnots) const
+{
+  for (int k = 0; k < numActiveKnots; ++k) {
+    auto const& knot = lastKnots[k];
+    auto& wideKnot = spline.spline.knots[k];
+    wideKnot.x[lane] = knot[0][channel];
+    wideKnot.y[lane] = knot[1][channel];
+    wideKnot.t[lane] = knot[2][channel];
+    wideKnot.s[lane] = knot[3][channel];
+  }
+  spline.spline.setIsSymmetric(lane, isSymmetric[channel]);
+}
+
+void
+Dsp::waveshapeControlRate(VecBuffer<Vec2d>& io, int const numActiveKnots)
+{
+  constexpr int width = WideVec::size();
+  int const numSamples = io.getNumSamples();
+  int const maxRunLength = std::min(numVectorsPerUpdate, wideCapacity * width);
+
+  double heldKnots[maxNumKnots][4][2];
+
+  for (int begin = 0; begin < numSamples; begin += maxRunLength) {
+    int const runLength = std::min(maxRunLength, numSamples - begin);
+    // the smoothing in closed form, see Ramp.h, held at the middle of the run
+    double const halfDecay = std::pow(smoothingAlpha, 0.5 * runLength);
+    double const decay = halfDecay * halfDecay;
+    for (int k = 0; k < numActiveKnots; ++k) {
+      for (int v = 0; v < 4; ++v) {
+        for (int c = 0; c < 2; ++c) {
+          double const target = lastKnots[k][v][c];
+          double const distance = controlKnots[k][v][c] - target;
+          heldKnots[k][v][c] = target + distance * halfDecay;
+          controlKnots[k][v][c] = target + distance * decay;
+        }
+      }
+    }
+    setupWideSplines(numActiveKnots, heldKnots);
+    waveshapeWide(io, begin, runLength, numActiveKnots);
+  }
+
+  areWideSplinesReady = false;
+  numSamplesSinceChange += numSamples * numSamplesPerVector;
+
+  // the per-sample smoothing did not run, so it jumps to the targets for the
+  // blocks that are too short for the wide kernel
+  if (numSamplesSinceChange >= numSamplesToSettle) {
+    autoSpline.reset();
+  }
+}
+
+// processes numSamples vectors of io from begin
+void
+Dsp::waveshapeWide(VecBuffer<Vec2d>& io,
+                   int const begin,
+                   int const numSamples,
+                   int const numActiveKnots)
+{
+  constexpr int width = WideVec::size();
+  int const numWide = (numSamples + width - 1) / width;
+
+  alignas(64) double lanes[2][width];
+
+  // de-interleave, repeating the last sample in the lanes past the end
+  VecBuffer<WideVec>* buffers[2] = { &getWideBuffer(0), &getWideBuffer(1) };
+  for (auto* buffer : buffers) {
+    buffer->setNumSamples(numWide);
+  }
+  for (int j = 0; j < numWide; ++j) {
+    for (int lane = 0; lane < width; ++lane) {
+      int const i = std::min(j * width + lane, numSamples - 1);
+      Vec2d const x = io[begin + i];
+      lanes[0][lane] = x[0];
+      lanes[1][lane] = x[1];
+    }
+    for (int c = 0; c < 2; ++c) {
+      (*buffers[c])[j] = WideVec().load_a(lanes[c]);
+    }
+  }
+
+  for (int c = 0; c < 2; ++c) {
+    wideSplines[c].processBlock(*buffers[c], *buffers[c], numActiveKnots);
+  }
+
+  for (int j = 0; j < numWide; ++j) {
+    for (int c = 0; c < 2; ++c) {
+      WideVec const y = (*buffers[c])[j];
+      y.store_a(lanes[c]);
+    }
+    int const numLanes = std::min(width, numSamples - j * width);
+    for (int lane = 0; lane < numLanes; ++lane) {
+      io[begin + j * width + lane] = Vec2d(lanes[0][lane], lanes[1][lane]);
+    }
+  }
+}
+
+void
+Dsp::applyGain(VecBuffer<Vec2d>& io, Vec2d const target, double const alpha)
+{
+  int const numSamples = io.getNumSamples();
+  if (isRampSettled(gain, target)) {
+    gain = target;
+    if (!(target[0] == 1.0 && target[1] == 1.0)) {
+      for (int i = 0; i < numSamples; ++i) {
+        Vec2d const x = io[i];
+        io[i] = target * x;
+      }
+    }
+    return;
+  }
+  Vec2d const distance = gain - target;
+  forEachRampPower(numSamples, alpha, [&](int const i, double const power) {
+    Vec2d const x = io[i];
+    io[i] = (target + distance * power) * x;
+  });
+  gain = target + distance * std::pow(alpha, numSamples);
+}
+
+void
+Dsp::setKnot(int const knotIndex,
+             int const channel,
+             double const x,
+             double const y,
+             double const tangent,
+             double const smoothness)
+{
+  auto& knot = autoSpline.spline.knots[knotIndex];
+  knot.x[channel] = x;
+  knot.y[channel] = y;
+  knot.t[channel] = tangent;
+  knot.s[channel] = smoothness;
+}
+
+void
+Dsp::setIsSymmetric(int const channel, bool const isChannelSymmetric)
+{
+  isSymmetric[channel] = isChannelSymmetric;
+  autoSpline.spline.setIsSymmetric(channel, isChannelSymmetric);
+}
+
+bool
+Dsp::getAffineMap(int const numActiveKnots, AffineMap& map)
+{
+  if (haveKnotsChanged(numActiveKnots)) {
+    onKnotsChanged();
+  }
+  if (numSamplesSinceChange < numSamplesToSettle ||
+      getProbeBuffer().getNumSamples() == 0) {
+    return false;
+  }
+  if (!isAffineMapReady) {
+    auto* cached = findCachedAffineMap(numActiveKnots);
+    if (cached) {
+      affineMap = cached->map;
+    }
+    else {
+      if (!areWideSplinesReady) {
+        setupSettledWideSplines(numActiveKnots);
+      }
+      analyseAffineRegion(numActiveKnots);
+      // in place of the least recently used one
+      cached = &*std::min_element(
+        affineMapCache.begin(),
+        affineMapCache.end(),
+        [](auto const& a, auto const& b) { return a.lastUse < b.lastUse; });
+      std::copy(&lastKnots[0][0][0],
+                &lastKnots[0][0][0] + numActiveKnots * 4 * 2,
+                &cached->knots[0][0][0]);
+      cached->isSymmetric[0] = isSymmetric[0];
+      cached->isSymmetric[1] = isSymmetric[1];
+      cached->numActiveKnots = numActiveKnots;
+      cached->map = affineMap;
+    }
+    cached->lastUse = ++numAffineMapUses;
+    isAffineMapReady = true;
+  }
+  map = affineMap;
+  return true;
+}
+
+Dsp::CachedAffineMap*
+Dsp::findCachedAffineMap(int const numActiveKnots)
+{
+  for (auto& cached : affineMapCache) {
+    if (cached.numActiveKnots == numActiveKnots &&
+        cached.isSymmetric[0] == isSymmetric[0] &&
+        cached.isSymmetric[1] == isSymmetric[1] &&
+        std::equal(&lastKnots[0][0][0],
+                   &lastKnots[0][0][0] + numActiveKnots * 4 * 2,
+                   &cached.knots[0][0][0])) {
+      return &cached;
+    }
+  }
+  return nullptr;
+}
+
+void
+Dsp::analyseAffineRegion(int const numActiveKnots)
+{
+  constexpr int width = WideVec::size();
+  constexpr int numProbes = 2 * numAffineProbes + 1;
+  constexpr double step = affineProbeRange / numAffineProbes;
+  // relative to the output, well below what can be heard
+  constexpr double tolerance = 1.0e-9;
+
+  alignas(64) double lanes[width];
+  double y[numProbes];
+
+  auto& probes = getProbeBuffer();
+  int const numVectors = probes.getNumSamples();
+
+  for (int c = 0; c < 2; ++c) {
+    // the probes from -affineProbeRange to affineProbeRange, repeating the
+    // last one in the lanes past the end
+    for (int j = 0; j < numVectors; ++j) {
+      for (int lane = 0; lane < width; ++lane) {
+        int const i = std::min(j * width + lane, numProbes - 1);
+        lanes[lane] = (i - numAffineProbes) * step;
+      }
+      probes[j] = WideVec().load_a(lanes);
+    }
+
+    wideSplines[c].processBlock(probes, probes, numActiveKnots);
+
+    for (int j = 0; j < numVectors; ++j) {
+      WideVec const values = probes[j];
+      values.store_a(lanes);
+      int const numLanes = std::min(width, numProbes - j * width);
+      for (int lane = 0; lane < numLanes; ++lane) {
+        y[j * width + lane] = lanes[lane];
+      }
+    }
+
+    double const slope =
+      (y[numAffineProbes + 1] - y[numAffineProbes - 1]) / (2.0 * step);
+    double const offset = y[numAffineProbes];
+
+    auto const isOnLine = [&](int const i) {
+      double const line = slope * (i - numAffineProbes) * step + offset;
+      return std::abs(y[i] - line) <= tolerance * (1.0 + std::abs(line));
+    };
+
+    int extent = 0;
+    while (extent < numAffineProbes &&
+           isOnLine(numAffineProbes + extent + 1) &&
+           isOnLine(numAffineProbes - extent - 1)) {
+      ++extent;
+    }
+
+    affineMap.slope[c] = slope;
+    affineMap.offset[c] = offset;
+    // the curve bends somewhere between the last probe on the line and the
+    // next one
+    affineMap.halfWidth[c] = extent * step;
+  }
+}
+
+bool
+Dsp::areChannelsLinked(int const numActiveKnots)
+{
+  if (haveKnotsChanged(numActiveKnots)) {
+    onKnotsChanged();
+  }
+  // while the knots move, the smoothed state of the channels can differ even
+  // if their targets are the same
+  if (numSamplesSinceChange < numSamplesToSettle ||
+      isSymmetric[0] != isSymmetric[1]) {
+    return false;
+  }
+  for (int k = 0; k < numActiveKnots; ++k) {
+    auto const& knot = lastKnots[k];
+    for (int v = 0; v < 4; ++v) {
+      if (knot[v][0] != knot[v][1]) {
+        return false;
+      }
+    }
+  }
+  return true;
 }
 
 } // namespace overdraw
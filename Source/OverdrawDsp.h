@@ -25,7 +25,11 @@ along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
 // frontend bus error that fires when JUCE and the spline NEON intrinsics are
 // codegen'd in the same TU. Same rationale as Curvessor's CurvessorDsp split.
 
+#include "AffineShortcut.h"
 #include "adsp/Spline.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
 
 namespace overdraw {
 
@@ -33,13 +37,186 @@ inline constexpr int maxNumKnots = 15;
 
 using AutoSpline = adsp::AutoSpline<Vec2d, maxNumKnots>;
 
+// the widest vector of doubles of the target instruction set, for the spline
+// kernel that packs consecutive samples of a channel
+#if INSTRSET >= 9
+using WideVec = Vec8d;
+#else
+using WideVec = Vec4d;
+#endif
+
+using WideSpline = adsp::AutoSpline<WideVec, maxNumKnots>;
+
 struct Dsp
 {
   AutoSpline autoSpline;
 
+  // When the knots have not changed for long enough for the smoothing to
+  // settle, waveshape runs each channel through a spline whose lanes hold
+  // consecutive samples, at full vector width. The spline evaluation is the
+  // same as the one of AutoSpline, which selects the segment of each lane with
+  // comparisons and blends instead of gathers.
+  std::array<WideSpline, 2> wideSplines;
+  std::array<VecBuffer<WideVec>, 2> wideBuffers{ VecBuffer<WideVec>{ 0 },
+                                                 VecBuffer<WideVec>{ 0 } };
+
+  // smoothed gain in front of the spline, used by the stages that run after
+  // the first one, in the oversampled domain
+  Vec2d gain = 1.0;
+
   Dsp() { AVEC_ASSERT_ALIGNMENT(this, Vec2d); }
 
+  // allocates the buffers of the wide kernel, which is not used on blocks
+  // longer than maxNumSamples
+  void prepare(int const maxNumSamples);
+
+  // Frees its buffers and uses the ones of owner, which must be prepared and
+  // outlive it. They only hold data inside waveshape and getAffineMap, so the
+  // Dsp that are never waveshaped at the same time can share them.
+  void prepare(Dsp& owner);
+
+  // jumps to the target knots
+  void reset();
+
+  // Copies the state and the settings of another Dsp, without its buffers, so
+  // that it can carry on waveshaping another signal from where the other one
+  // is. Does not allocate.
+  void copyStateFrom(Dsp const& other);
+
+  // copies the target knots and the symmetry of another Dsp
+  void copyTargetsFrom(Dsp const& other);
+
+  // the bytes of the buffers it owns, as prepare sized them
+  size_t getBufferMemory() const
+  {
+    if (bufferOwner) {
+      return 0;
+    }
+    return sizeof(WideVec) * (2 * static_cast<size_t>(wideCapacity) +
+                              probeBuffer.getNumSamples());
+  }
+
+  // per sample; the buffers given to waveshape hold samplesPerVector
+  // consecutive samples of a channel in each vector, 2 for the mono path
+  void setSmoothingAlpha(double const alpha, int const samplesPerVector = 1);
+
+  // When enabled, the knots are smoothed at control rate while they move: the
+  // smoothing is advanced in closed form once every few vectors, derived from
+  // the smoothing time, and each run of vectors in between goes through the
+  // wide kernel with the knots held at their value in its middle. Switching
+  // while the knots are moving carries the smoothed knots over to the other
+  // mode.
+  void setControlRateAutomation(bool const isEnabled);
+
   void waveshape(VecBuffer<Vec2d>& io, int const numActiveKnots);
+
+  void applyGain(VecBuffer<Vec2d>& io, Vec2d const target, double const alpha);
+
+  // Direct knot access for JUCE-free callers (benchmarks, tools). The plug-in
+  // goes through SplineParameters::updateSpline instead.
+  void setKnot(int const knotIndex,
+               int const channel,
+               double const x,
+               double const y,
+               double const tangent,
+               double const smoothness);
+
+  void setIsSymmetric(int const channel, bool const isChannelSymmetric);
+
+  // true if the first numActiveKnots knots and the symmetry are the same on
+  // both channels, and the smoothing of the knots has settled
+  bool areChannelsLinked(int const numActiveKnots);
+
+  // The range of inputs around zero in which the spline is an affine map, and
+  // that map. The spline is probed on a grid once the knots settle, and the
+  // range stops at the last probe on the line through the ones next to zero.
+  // The maps of the last few settled knots are kept, so that automation that
+  // goes back and forth between them probes each one once.
+  // Returns false while the knots are moving, and before prepare.
+  bool getAffineMap(int const numActiveKnots, AffineMap& map);
+
+  // For the batches of EngineBatch, which waveshape several Dsp together with
+  // a lane of a wide spline for each channel. Returns true if waveshape
+  // would run the settled wide kernel on numSamples vectors, in which case
+  // the batch may run it instead, with the lanes set by setupLane.
+  bool isSettledFor(int const numActiveKnots, int const numSamples);
+
+  // copies the settled knots and the symmetry of a channel to a lane
+  void setupLane(WideSpline& spline,
+                 int const lane,
+                 int const channel,
+                 int const numActiveKnots) const;
+
+private:
+  // probes on each side of zero, and the largest one
+  static constexpr int numAffineProbes = 512;
+  static constexpr double affineProbeRange = 4.0;
+  static constexpr int numProbeVectors =
+    (2 * numAffineProbes + WideVec::size()) / WideVec::size();
+  static constexpr int numCachedAffineMaps = 4;
+
+  struct CachedAffineMap final
+  {
+    double knots[maxNumKnots][4][2] = {};
+    bool isSymmetric[2] = { false, false };
+    int numActiveKnots = -1;
+    int64_t lastUse = 0;
+    AffineMap map;
+  };
+
+  VecBuffer<WideVec>& getWideBuffer(int const channel)
+  {
+    return bufferOwner ? bufferOwner->wideBuffers[channel]
+                       : wideBuffers[channel];
+  }
+
+  VecBuffer<WideVec>& getProbeBuffer()
+  {
+    return bufferOwner ? bufferOwner->probeBuffer : probeBuffer;
+  }
+
+  // the map of the settled knots, if it is cached
+  CachedAffineMap* findCachedAffineMap(int const numActiveKnots);
+  bool haveKnotsChanged(int const numActiveKnots);
+  void onKnotsChanged();
+  void setupSettledWideSplines(int const numActiveKnots);
+  void analyseAffineRegion(int const numActiveKnots);
+  void setupWideSplines(int const numActiveKnots, double const (*knots)[4][2]);
+  void waveshapeWide(VecBuffer<Vec2d>& io,
+                     int const begin,
+                     int const numSamples,
+                     int const numActiveKnots);
+  void waveshapeControlRate(VecBuffer<Vec2d>& io, int const numActiveKnots);
+  void advanceControlKnots(int const numActiveKnots, int const numVectors);
+
+  // the knots, the symmetry and the number of active knots of the previous
+  // block, to tell when the smoothing has settled
+  double lastKnots[maxNumKnots][4][2] = {};
+  bool isSymmetric[2] = { false, false };
+  bool lastIsSymmetric[2] = { false, false };
+  int lastNumActiveKnots = -1;
+
+  // the Dsp whose buffers it uses, see prepare
+  Dsp* bufferOwner = nullptr;
+  int wideCapacity = 0;
+  int64_t numSamplesSinceChange = 0;
+  int64_t numSamplesToSettle = 0;
+  int numSamplesPerVector = 1;
+  bool areWideSplinesReady = false;
+
+  // control-rate smoothing: the smoothed knots, as x, y, t, s per channel,
+  // kept in step with the per-sample smoothing when that runs instead, and
+  // the vectors between two of their updates
+  double controlKnots[maxNumKnots][4][2] = {};
+  double smoothingAlpha = 0.0;
+  int numVectorsPerUpdate = 1;
+  bool isControlRateAutomationEnabled = false;
+
+  VecBuffer<WideVec> probeBuffer{ 0 };
+  AffineMap affineMap;
+  bool isAffineMapReady = false;
+  std::array<CachedAffineMap, numCachedAffineMaps> affineMapCache;
+  int64_t numAffineMapUses = 0;
 };
 
 } // namespace overdraw
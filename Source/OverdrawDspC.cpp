@@ -0,0 +1,360 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "OverdrawDspC.h"
+#include "Engine.h"
+#include "EngineBatch.h"
+#include <algorithm>
+#include <new>
+
+using overdraw::Engine;
+
+static_assert(OVERDRAW_MAX_NUM_STAGES == Engine::maxNumStages);
+static_assert(OVERDRAW_MAX_NUM_BANDS == Engine::maxNumBands);
+static_assert(OVERDRAW_MAX_NUM_KNOTS == overdraw::maxNumKnots);
+static_assert(OVERDRAW_NUM_SPLINES == Engine::numSplines);
+static_assert(OVERDRAW_BAND_SPLINE(1) == Engine::getBandSpline(1));
+static_assert(OVERDRAW_FILTER_PEAK ==
+              static_cast<int>(overdraw::Svf::Type::peak));
+
+struct overdraw_engine final
+{
+  Engine engine;
+};
+
+struct overdraw_batch final
+{
+  overdraw::EngineBatch batch;
+};
+
+namespace {
+
+bool
+isInRange(int const value, int const size)
+{
+  return value >= 0 && value < size;
+}
+
+// sets one channel, or both with channel = -1
+template<class T>
+overdraw_status
+setChannels(T* values, int const channel, T const value)
+{
+  if (channel == -1) {
+    values[0] = values[1] = value;
+  }
+  else if (isInRange(channel, 2)) {
+    values[channel] = value;
+  }
+  else {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+  return OVERDRAW_OK;
+}
+
+} // namespace
+
+overdraw_engine*
+overdraw_create(void)
+{
+  try {
+    return new overdraw_engine{};
+  }
+  catch (std::bad_alloc const&) {
+    return nullptr;
+  }
+}
+
+void
+overdraw_destroy(overdraw_engine* engine)
+{
+  delete engine;
+}
+
+overdraw_status
+overdraw_prepare(overdraw_engine* engine,
+                 double const sample_rate,
+                 int const max_num_samples)
+{
+  if (!engine || !(sample_rate > 0.0) || max_num_samples < 1) {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+  try {
+    engine->engine.prepare(sample_rate, max_num_samples);
+  }
+  catch (std::bad_alloc const&) {
+    return OVERDRAW_OUT_OF_MEMORY;
+  }
+  return OVERDRAW_OK;
+}
+
+overdraw_status
+overdraw_set_oversampling(overdraw_engine* engine,
+                          int const order,
+                          int const is_linear_phase)
+{
+  if (!engine || !isInRange(order, Engine::numOversamplingOrders)) {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+  try {
+    engine->engine.setOversampling(order, is_linear_phase != 0);
+  }
+  catch (std::bad_alloc const&) {
+    return OVERDRAW_OUT_OF_MEMORY;
+  }
+  return OVERDRAW_OK;
+}
+
+int
+overdraw_get_latency(overdraw_engine const* engine)
+{
+  return engine ? engine->engine.getLatency() : 0;
+}
+
+overdraw_status
+overdraw_set_parameter(overdraw_engine* engine,
+                       overdraw_parameter const parameter,
+                       int const index,
+                       int const channel,
+                       double const value)
+{
+  if (!engine) {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+
+  auto& p = engine->engine.parameters;
+
+  switch (parameter) {
+    case OVERDRAW_MID_SIDE:
+      p.isMidSideEnabled = value != 0.0;
+      return OVERDRAW_OK;
+    case OVERDRAW_SMOOTHING_TIME:
+      p.smoothingTime = std::max(0.0, value);
+      return OVERDRAW_OK;
+    case OVERDRAW_CONTROL_RATE_AUTOMATION:
+      p.isControlRateAutomationEnabled = value != 0.0;
+      return OVERDRAW_OK;
+    case OVERDRAW_INPUT_GAIN:
+      return setChannels(p.inputGain, channel, value);
+    case OVERDRAW_OUTPUT_GAIN:
+      return setChannels(p.outputGain, channel, value);
+    case OVERDRAW_WET:
+      return setChannels(p.wet, channel, value);
+    case OVERDRAW_NUM_STAGES:
+      p.numStages =
+        std::clamp(static_cast<int>(value), 1, Engine::maxNumStages);
+      return OVERDRAW_OK;
+    case OVERDRAW_NUM_BANDS:
+      p.numBands =
+        std::clamp(static_cast<int>(value), 1, Engine::maxNumBands);
+      return OVERDRAW_OK;
+    case OVERDRAW_SYMMETRY:
+      if (!isInRange(index, Engine::numSplines)) {
+        return OVERDRAW_INVALID_ARGUMENT;
+      }
+      return setChannels(p.isSymmetric[index], channel, value != 0.0);
+    case OVERDRAW_SPLINE_GAIN:
+      if (!isInRange(index, Engine::numSplines)) {
+        return OVERDRAW_INVALID_ARGUMENT;
+      }
+      return setChannels(p.splineGain[index], channel, value);
+    case OVERDRAW_CROSSOVER_FREQUENCY:
+      if (!isInRange(index, Engine::maxNumBands - 1)) {
+        return OVERDRAW_INVALID_ARGUMENT;
+      }
+      return setChannels(p.crossover[index], channel, value);
+    default:
+      break;
+  }
+
+  // filters
+
+  if (!isInRange(index, 2)) {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+
+  auto& filter = p.filters[index];
+
+  switch (parameter) {
+    case OVERDRAW_FILTER_TYPE: {
+      int const type = static_cast<int>(value);
+      if (!isInRange(type, OVERDRAW_FILTER_PEAK + 1)) {
+        return OVERDRAW_INVALID_ARGUMENT;
+      }
+      filter.type = static_cast<overdraw::Svf::Type>(type);
+      return OVERDRAW_OK;
+    }
+    case OVERDRAW_FILTER_FREQUENCY:
+      return setChannels(filter.frequency, channel, value);
+    case OVERDRAW_FILTER_Q:
+      return setChannels(filter.q, channel, value);
+    case OVERDRAW_FILTER_GAIN:
+      return setChannels(filter.gain, channel, value);
+    default:
+      return OVERDRAW_INVALID_ARGUMENT;
+  }
+}
+
+overdraw_status
+overdraw_set_knot(overdraw_engine* engine,
+                  int const spline,
+                  int const knot,
+                  int const channel,
+                  double const x,
+                  double const y,
+                  double const tangent,
+                  double const smoothness)
+{
+  if (!engine || !isInRange(spline, Engine::numSplines) ||
+      !isInRange(knot, overdraw::maxNumKnots)) {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+  if (channel == -1) {
+    for (int c = 0; c < 2; ++c) {
+      engine->engine.setKnot(spline, knot, c, x, y, tangent, smoothness);
+    }
+    return OVERDRAW_OK;
+  }
+  if (!isInRange(channel, 2)) {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+  engine->engine.setKnot(spline, knot, channel, x, y, tangent, smoothness);
+  return OVERDRAW_OK;
+}
+
+overdraw_status
+overdraw_set_num_knots(overdraw_engine* engine,
+                       int const spline,
+                       int const num_knots)
+{
+  if (!engine || !isInRange(spline, Engine::numSplines) ||
+      !isInRange(num_knots, overdraw::maxNumKnots + 1)) {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+  engine->engine.setNumKnots(spline, num_knots);
+  return OVERDRAW_OK;
+}
+
+void
+overdraw_reset(overdraw_engine* engine)
+{
+  if (engine) {
+    engine->engine.reset();
+  }
+}
+
+void
+overdraw_process_planar_double(overdraw_engine* engine,
+                               double* const* io,
+                               int const num_samples)
+{
+  if (engine && io) {
+    engine->engine.process(io, num_samples);
+  }
+}
+
+void
+overdraw_process_planar_float(overdraw_engine* engine,
+                              float* const* io,
+                              int const num_samples)
+{
+  if (engine && io) {
+    engine->engine.process(io, num_samples);
+  }
+}
+
+void
+overdraw_process_interleaved_double(overdraw_engine* engine,
+                                    double* io,
+                                    int const num_samples)
+{
+  if (engine && io) {
+    engine->engine.processInterleaved(io, num_samples);
+  }
+}
+
+void
+overdraw_process_interleaved_float(overdraw_engine* engine,
+                                   float* io,
+                                   int const num_samples)
+{
+  if (engine && io) {
+    engine->engine.processInterleaved(io, num_samples);
+  }
+}
+
+overdraw_batch*
+overdraw_batch_create(void)
+{
+  try {
+    return new overdraw_batch{};
+  }
+  catch (std::bad_alloc const&) {
+    return nullptr;
+  }
+}
+
+void
+overdraw_batch_destroy(overdraw_batch* batch)
+{
+  delete batch;
+}
+
+overdraw_status
+overdraw_batch_add(overdraw_batch* batch, overdraw_engine* engine)
+{
+  if (!batch || !engine) {
+    return OVERDRAW_INVALID_ARGUMENT;
+  }
+  try {
+    batch->batch.add(engine->engine);
+  }
+  catch (std::bad_alloc const&) {
+    return OVERDRAW_OUT_OF_MEMORY;
+  }
+  return OVERDRAW_OK;
+}
+
+void
+overdraw_batch_remove(overdraw_batch* batch, overdraw_engine* engine)
+{
+  if (batch && engine) {
+    batch->batch.remove(engine->engine);
+  }
+}
+
+void
+overdraw_batch_process_planar_double(overdraw_batch* batch,
+                                     double* const* const* io,
+                                     int const num_samples)
+{
+  if (batch && io) {
+    batch->batch.process(io, num_samples);
+  }
+}
+
+void
+overdraw_batch_process_planar_float(overdraw_batch* batch,
+                                    float* const* const* io,
+                                    int const num_samples)
+{
+  if (batch && io) {
+    batch->batch.process(io, num_samples);
+  }
+}
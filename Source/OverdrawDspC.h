@@ -0,0 +1,246 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+/*
+ * C interface to overdraw::Engine, see Engine.h.
+ * Define OVERDRAW_DSP_SHARED when linking to the shared library.
+ */
+
+#if defined(OVERDRAW_DSP_SHARED)
+#if defined(_WIN32)
+#if defined(OVERDRAW_DSP_BUILDING)
+#define OVERDRAW_DSP_API __declspec(dllexport)
+#else
+#define OVERDRAW_DSP_API __declspec(dllimport)
+#endif
+#else
+#define OVERDRAW_DSP_API __attribute__((visibility("default")))
+#endif
+#else
+#define OVERDRAW_DSP_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct overdraw_engine overdraw_engine;
+typedef struct overdraw_batch overdraw_batch;
+
+typedef enum overdraw_status
+{
+  OVERDRAW_OK = 0,
+  OVERDRAW_INVALID_ARGUMENT = 1,
+  OVERDRAW_OUT_OF_MEMORY = 2
+} overdraw_status;
+
+/*
+ * Parameters, in the units of the plug-in. Those of a spline take its index
+ * as index, those of a filter take 0 for the pre filter and 1 for the post
+ * filter, the crossover frequencies take the index of the split. The others
+ * ignore it. A channel of -1 sets both channels.
+ */
+typedef enum overdraw_parameter
+{
+  // 0 or 1
+  OVERDRAW_MID_SIDE = 0,
+  // milliseconds
+  OVERDRAW_SMOOTHING_TIME,
+  // 0 or 1, smoothing of the knots at control rate
+  OVERDRAW_CONTROL_RATE_AUTOMATION,
+  // decibels
+  OVERDRAW_INPUT_GAIN,
+  OVERDRAW_OUTPUT_GAIN,
+  // percent
+  OVERDRAW_WET,
+  // 1 to OVERDRAW_MAX_NUM_STAGES
+  OVERDRAW_NUM_STAGES,
+  // 1 to OVERDRAW_MAX_NUM_BANDS
+  OVERDRAW_NUM_BANDS,
+  // 0 or 1
+  OVERDRAW_SYMMETRY,
+  // decibels
+  OVERDRAW_SPLINE_GAIN,
+  // hertz
+  OVERDRAW_CROSSOVER_FREQUENCY,
+  // an overdraw_filter_type
+  OVERDRAW_FILTER_TYPE,
+  // hertz
+  OVERDRAW_FILTER_FREQUENCY,
+  OVERDRAW_FILTER_Q,
+  // decibels
+  OVERDRAW_FILTER_GAIN
+} overdraw_parameter;
+
+typedef enum overdraw_filter_type
+{
+  OVERDRAW_FILTER_OFF = 0,
+  OVERDRAW_FILTER_HIGH_PASS,
+  OVERDRAW_FILTER_LOW_PASS,
+  OVERDRAW_FILTER_LOW_SHELF,
+  OVERDRAW_FILTER_HIGH_SHELF,
+  OVERDRAW_FILTER_PEAK
+} overdraw_filter_type;
+
+#define OVERDRAW_MAX_NUM_STAGES 3
+#define OVERDRAW_MAX_NUM_BANDS 4
+#define OVERDRAW_MAX_NUM_KNOTS 15
+
+/*
+ * The splines: the first stage, which is also the first band, the stages
+ * after it, then the bands after the first one.
+ */
+#define OVERDRAW_STAGE_SPLINE(stage) (stage)
+#define OVERDRAW_BAND_SPLINE(band)                                            \
+  ((band) == 0 ? 0 : OVERDRAW_MAX_NUM_STAGES + (band)-1)
+#define OVERDRAW_NUM_SPLINES                                                  \
+  (OVERDRAW_MAX_NUM_STAGES + OVERDRAW_MAX_NUM_BANDS - 1)
+
+/*
+ * Creates an engine with the default parameters and identity splines.
+ * @return NULL if out of memory
+ */
+OVERDRAW_DSP_API overdraw_engine*
+overdraw_create(void);
+
+OVERDRAW_DSP_API void
+overdraw_destroy(overdraw_engine* engine);
+
+/*
+ * Allocates and resets. Must be called before processing, and again when the
+ * sample rate changes. Longer blocks are processed in chunks.
+ */
+OVERDRAW_DSP_API overdraw_status
+overdraw_prepare(overdraw_engine* engine,
+                 double sample_rate,
+                 int max_num_samples);
+
+/*
+ * @param order from 0 (1x) to 5 (32x)
+ * Allocates, if the engine is prepared. The latency changes.
+ */
+OVERDRAW_DSP_API overdraw_status
+overdraw_set_oversampling(overdraw_engine* engine,
+                          int order,
+                          int is_linear_phase);
+
+/*
+ * @return the latency in samples, 0 before overdraw_prepare
+ */
+OVERDRAW_DSP_API int
+overdraw_get_latency(overdraw_engine const* engine);
+
+/*
+ * Sets a parameter. The engine smooths toward it while processing.
+ */
+OVERDRAW_DSP_API overdraw_status
+overdraw_set_parameter(overdraw_engine* engine,
+                       overdraw_parameter parameter,
+                       int index,
+                       int channel,
+                       double value);
+
+/*
+ * Sets a knot of a spline. x and y are in the units of the input and of the
+ * output, tangent is the slope at the knot and smoothness goes from 0 to 1.
+ */
+OVERDRAW_DSP_API overdraw_status
+overdraw_set_knot(overdraw_engine* engine,
+                  int spline,
+                  int knot,
+                  int channel,
+                  double x,
+                  double y,
+                  double tangent,
+                  double smoothness);
+
+/*
+ * Sets how many knots of a spline are used, at most OVERDRAW_MAX_NUM_KNOTS.
+ */
+OVERDRAW_DSP_API overdraw_status
+overdraw_set_num_knots(overdraw_engine* engine, int spline, int num_knots);
+
+/*
+ * Clears the state and jumps to the parameters and knots, without smoothing.
+ */
+OVERDRAW_DSP_API void
+overdraw_reset(overdraw_engine* engine);
+
+/*
+ * Processes a stereo block in place, planar or interleaved.
+ */
+OVERDRAW_DSP_API void
+overdraw_process_planar_double(overdraw_engine* engine,
+                               double* const* io,
+                               int num_samples);
+
+OVERDRAW_DSP_API void
+overdraw_process_planar_float(overdraw_engine* engine,
+                              float* const* io,
+                              int num_samples);
+
+OVERDRAW_DSP_API void
+overdraw_process_interleaved_double(overdraw_engine* engine,
+                                    double* io,
+                                    int num_samples);
+
+OVERDRAW_DSP_API void
+overdraw_process_interleaved_float(overdraw_engine* engine,
+                                   float* io,
+                                   int num_samples);
+
+/*
+ * Batches process several engines in the same call, waveshaping those with
+ * settled splines together, see EngineBatch.h. The output is the same as the
+ * one of the engines processed on their own, in blocks of at most the
+ * smallest max_num_samples. An engine must be in a batch at most, and must
+ * be removed from it before being destroyed.
+ * @return NULL if out of memory
+ */
+OVERDRAW_DSP_API overdraw_batch*
+overdraw_batch_create(void);
+
+OVERDRAW_DSP_API void
+overdraw_batch_destroy(overdraw_batch* batch);
+
+OVERDRAW_DSP_API overdraw_status
+overdraw_batch_add(overdraw_batch* batch, overdraw_engine* engine);
+
+OVERDRAW_DSP_API void
+overdraw_batch_remove(overdraw_batch* batch, overdraw_engine* engine);
+
+/*
+ * Processes a stereo block of each engine in place, io[e] being the planar
+ * block of the engine added e-th.
+ */
+OVERDRAW_DSP_API void
+overdraw_batch_process_planar_double(overdraw_batch* batch,
+                                     double* const* const* io,
+                                     int num_samples);
+
+OVERDRAW_DSP_API void
+overdraw_batch_process_planar_float(overdraw_batch* batch,
+                                    float* const* const* io,
+                                    int num_samples);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -27,8 +27,74 @@ constexpr float kMinScale = 0.5f;
 constexpr float kMaxScale = 2.0f;
 constexpr float kDefaultScale = 0.75f;
 constexpr char const* kEditorWidthProperty = "editorWidth";
+constexpr char const* kLoadOverlayProperty = "loadOverlay";
 }
 
+OverdrawAudioProcessorEditor::Content::Stage::Stage(OverdrawAudioProcessor& p,
+                                                   int stageIndex)
+
+  : spline(*p.getOverdrawParameters().stages[stageIndex].spline,
+           *p.getOverdrawParameters().apvts,
+           &p.getOverdrawParameters().stages[stageIndex].symmetry)
+
+  , selectedKnot(*p.getOverdrawParameters().stages[stageIndex].spline,
+                 *p.getOverdrawParameters().apvts)
+
+  , symmetry(*p.getOverdrawParameters().apvts,
+             "Symmetry",
+             p.getOverdrawParameters().stages[stageIndex].symmetry)
+
+  , gain(*p.getOverdrawParameters().apvts,
+         "Stage " + String(stageIndex + 2) + " Gain",
+         p.getOverdrawParameters().stages[stageIndex].gain)
+{}
+
+OverdrawAudioProcessorEditor::Content::Band::Band(OverdrawAudioProcessor& p,
+                                                 int bandIndex)
+
+  : spline(*p.getOverdrawParameters().bands[bandIndex].spline,
+           *p.getOverdrawParameters().apvts,
+           &p.getOverdrawParameters().bands[bandIndex].symmetry)
+
+  , selectedKnot(*p.getOverdrawParameters().bands[bandIndex].spline,
+                 *p.getOverdrawParameters().apvts)
+
+  , symmetry(*p.getOverdrawParameters().apvts,
+             "Symmetry",
+             p.getOverdrawParameters().bands[bandIndex].symmetry)
+
+  , gain(*p.getOverdrawParameters().apvts,
+         "Band " + String(bandIndex + 2) + " Gain",
+         p.getOverdrawParameters().bands[bandIndex].gain)
+
+  , crossover(*p.getOverdrawParameters().apvts,
+              "Crossover",
+              p.getOverdrawParameters().crossovers[bandIndex])
+{}
+
+OverdrawAudioProcessorEditor::Content::Filter::Filter(
+  Component& parent,
+  OverdrawAudioProcessor& p,
+  int index)
+
+  : type(parent,
+         *p.getOverdrawParameters().apvts,
+         index == 0 ? "Pre-Filter-Type" : "Post-Filter-Type",
+         { "Off", "High Pass", "Low Pass", "Low Shelf", "High Shelf", "Peak" })
+
+  , frequency(*p.getOverdrawParameters().apvts,
+              "Frequency",
+              p.getOverdrawParameters().filters[index].frequency)
+
+  , q(*p.getOverdrawParameters().apvts,
+      "Q",
+      p.getOverdrawParameters().filters[index].q)
+
+  , gain(*p.getOverdrawParameters().apvts,
+         "Gain",
+         p.getOverdrawParameters().filters[index].gain)
+{}
+
 OverdrawAudioProcessorEditor::Content::Content(OverdrawAudioProcessor& p)
 
   : processor(p)
@@ -70,8 +136,26 @@ OverdrawAudioProcessorEditor::Content::Content(OverdrawAudioProcessor& p)
 
   , channelLabels(*p.getOverdrawParameters().apvts, "Mid-Side")
 
+  , numStages(*this,
+              *p.getOverdrawParameters().apvts,
+              "Stages",
+              { "1 Stage", "2 Stages", "3 Stages" })
+
+  , numBands(*this,
+             *p.getOverdrawParameters().apvts,
+             "Bands",
+             { "1 Band", "2 Bands", "3 Bands", "4 Bands" })
+
+  , filterChannelLabels(*p.getOverdrawParameters().apvts, "Mid-Side")
+
+  , loadOverlay(p)
+
+  , settingsPanel(p)
+
   , background(ImageCache::getFromMemory(BinaryData::background_png,
                                          BinaryData::background_pngSize))
+
+  , repaintScheduler(p, *this)
 {
   addAndMakeVisible(spline);
   addAndMakeVisible(selectedKnot);
@@ -89,6 +173,53 @@ OverdrawAudioProcessorEditor::Content::Content(OverdrawAudioProcessor& p)
 
   attachAndInitializeSplineEditors(spline, selectedKnot, 7);
 
+  for (int i = 0; i < OverdrawAudioProcessor::maxNumStages - 1; ++i) {
+    stages[i] = std::make_unique<Stage>(p, i);
+    auto& stage = *stages[i];
+    addChildComponent(stage.spline);
+    addChildComponent(stage.selectedKnot);
+    addChildComponent(stage.symmetry);
+    addChildComponent(stage.gain);
+    attachAndInitializeSplineEditors(stage.spline, stage.selectedKnot, 7);
+  }
+
+  for (int i = 0; i < OverdrawAudioProcessor::maxNumBands - 1; ++i) {
+    bands[i] = std::make_unique<Band>(p, i);
+    auto& band = *bands[i];
+    addChildComponent(band.spline);
+    addChildComponent(band.selectedKnot);
+    addChildComponent(band.symmetry);
+    addChildComponent(band.gain);
+    addChildComponent(band.crossover);
+    attachAndInitializeSplineEditors(band.spline, band.selectedKnot, 7);
+  }
+
+  addChildComponent(filterChannelLabels);
+  for (int i = 0; i < 2; ++i) {
+    filters[i] = std::make_unique<Filter>(*this, p, i);
+    auto& filter = *filters[i];
+    filter.type.getControl().setVisible(false);
+    addChildComponent(filter.typeLabel);
+    addChildComponent(filter.frequency);
+    addChildComponent(filter.q);
+    addChildComponent(filter.gain);
+    filter.typeLabel.setJustificationType(Justification::centred);
+  }
+
+  addAndMakeVisible(editedPage);
+  for (int i = 0; i < OverdrawAudioProcessor::maxNumStages; ++i) {
+    editedPage.addItem("Edit Stage " + String(i + 1), i + 1);
+  }
+  for (int i = 0; i < OverdrawAudioProcessor::maxNumBands - 1; ++i) {
+    editedPage.addItem("Edit Band " + String(i + 2), firstBandPage + i + 1);
+  }
+  editedPage.addItem("Edit Pre Filter", firstFilterPage + 1);
+  editedPage.addItem("Edit Post Filter", firstFilterPage + 2);
+  editedPage.setSelectedItemIndex(0, dontSendNotification);
+  editedPage.onChange = [this] {
+    showPage(editedPage.getSelectedItemIndex());
+  };
+
   oversamplingLabel.setJustificationType(Justification::centred);
   smoothingLabel.setJustificationType(Justification::centred);
 
@@ -123,6 +254,38 @@ OverdrawAudioProcessorEditor::Content::Content(OverdrawAudioProcessor& p)
     }
   }
 
+  for (auto& stage : stages) {
+    stage->selectedKnot.setTableSettings(tableSettings);
+    applyTableSettings(stage->symmetry);
+    applyTableSettings(stage->gain);
+    for (int c = 0; c < 2; ++c) {
+      stage->gain.getControl(c).setTextValueSuffix("dB");
+    }
+  }
+
+  for (auto& band : bands) {
+    band->selectedKnot.setTableSettings(tableSettings);
+    applyTableSettings(band->symmetry);
+    applyTableSettings(band->gain);
+    applyTableSettings(band->crossover);
+    for (int c = 0; c < 2; ++c) {
+      band->gain.getControl(c).setTextValueSuffix("dB");
+      band->crossover.getControl(c).setTextValueSuffix("Hz");
+    }
+  }
+
+  applyTableSettings(filterChannelLabels);
+
+  for (auto& filter : filters) {
+    applyTableSettings(filter->frequency);
+    applyTableSettings(filter->q);
+    applyTableSettings(filter->gain);
+    for (int c = 0; c < 2; ++c) {
+      filter->frequency.getControl(c).setTextValueSuffix("Hz");
+      filter->gain.getControl(c).setTextValueSuffix("dB");
+    }
+  }
+
   smoothing.getControl().setTextValueSuffix("ms");
 
   url.setFont({ 14._p, Font::bold });
@@ -140,9 +303,95 @@ OverdrawAudioProcessorEditor::Content::Content(OverdrawAudioProcessor& p)
   url.setText("www.unevens.net", dontSendNotification);
   url.setJustification(Justification::left);
 
+  auto& state = p.getOverdrawParameters().apvts->state;
+  bool const isLoadOverlayVisible =
+    state.getProperty(kLoadOverlayProperty, false);
+  addChildComponent(loadOverlay);
+  loadOverlay.lineColour = lineColour;
+  loadOverlay.setVisible(isLoadOverlayVisible);
+  addAndMakeVisible(loadOverlayButton);
+  loadOverlayButton.setClickingTogglesState(true);
+  loadOverlayButton.setToggleState(isLoadOverlayVisible, dontSendNotification);
+  loadOverlayButton.onClick = [this] {
+    bool const isVisible = loadOverlayButton.getToggleState();
+    loadOverlay.setVisible(isVisible);
+    processor.getOverdrawParameters().apvts->state.setProperty(
+      kLoadOverlayProperty, isVisible, nullptr);
+  };
+
+  addChildComponent(settingsPanel);
+  settingsPanel.lineColour = lineColour;
+  addAndMakeVisible(settingsButton);
+  settingsButton.setClickingTogglesState(true);
+  settingsButton.onClick = [this] {
+    settingsPanel.setVisible(settingsButton.getToggleState());
+  };
+
+  repaintScheduler.addParameterView(spline);
+  for (auto& stage : stages) {
+    repaintScheduler.addParameterView(stage->spline);
+  }
+  for (auto& band : bands) {
+    repaintScheduler.addParameterView(band->spline);
+  }
+  repaintScheduler.addMeter(
+    vuMeter, { &p.vuMeterResults[0], &p.vuMeterResults[1] }, 0.1f);
+
   setSize(kDesignWidth, kDesignHeight);
 }
 
+void
+OverdrawAudioProcessorEditor::Content::showPage(int newPageIndex)
+{
+  pageIndex = newPageIndex;
+
+  // the filter pages keep showing the first stage
+  int const filterIndex = pageIndex - firstFilterPage;
+  bool const isFilterPage = filterIndex >= 0;
+  int const bandIndex = isFilterPage ? -1 : pageIndex - firstBandPage;
+  bool const isBandPage = bandIndex >= 0;
+  int const stageIndex = isFilterPage ? 0 : isBandPage ? -1 : pageIndex;
+
+  bool const isFirstStage = stageIndex == 0;
+  spline.setVisible(isFirstStage);
+  selectedKnot.setVisible(isFirstStage && !isFilterPage);
+  symmetry.setVisible(isFirstStage);
+  gain[0].setVisible(isFirstStage);
+  gain[1].setVisible(!isBandPage);
+
+  for (int i = 0; i < OverdrawAudioProcessor::maxNumStages - 1; ++i) {
+    bool const isEdited = stageIndex == i + 1;
+    auto& stage = *stages[i];
+    stage.spline.setVisible(isEdited);
+    stage.selectedKnot.setVisible(isEdited);
+    stage.symmetry.setVisible(isEdited);
+    stage.gain.setVisible(isEdited);
+  }
+
+  for (int i = 0; i < OverdrawAudioProcessor::maxNumBands - 1; ++i) {
+    bool const isEdited = bandIndex == i;
+    auto& band = *bands[i];
+    band.spline.setVisible(isEdited);
+    band.selectedKnot.setVisible(isEdited);
+    band.symmetry.setVisible(isEdited);
+    band.gain.setVisible(isEdited);
+    band.crossover.setVisible(isEdited);
+  }
+
+  filterChannelLabels.setVisible(isFilterPage);
+  for (int i = 0; i < 2; ++i) {
+    bool const isEdited = filterIndex == i;
+    auto& filter = *filters[i];
+    filter.type.getControl().setVisible(isEdited);
+    filter.typeLabel.setVisible(isEdited);
+    filter.frequency.setVisible(isEdited);
+    filter.q.setVisible(isEdited);
+    filter.gain.setVisible(isEdited);
+  }
+
+  repaint();
+}
+
 void
 OverdrawAudioProcessorEditor::Content::paint(Graphics& g)
 {
@@ -161,9 +410,13 @@ OverdrawAudioProcessorEditor::Content::paint(Graphics& g)
     g.drawRect(r, 1);
   };
 
-  makeRect({ left, top, width, (int)40._p });
-  makeRect({ left, top + (int)80._p, width, (int)80._p });
-  makeRect({ left, top + (int)210._p, width, (int)120._p });
+  makeRect({ left, top, width, (int)160._p });
+  makeRect({ left, top + (int)170._p, width, (int)80._p });
+  makeRect({ left, top + (int)260._p, width, (int)120._p });
+
+  if (pageIndex >= firstFilterPage) {
+    makeRect(filterTypeArea);
+  }
 
   g.setColour(lineColour);
   g.drawRect(spline.getBounds().expanded(1, 1), 1);
@@ -195,16 +448,84 @@ OverdrawAudioProcessorEditor::Content::resized()
   resize(gain[1], 140._p);
   resize(wet, 140._p);
 
+  for (auto& stage : stages) {
+    stage->spline.setBounds(spline.getBounds());
+    stage->selectedKnot.setBounds(selectedKnot.getBounds());
+    stage->symmetry.setBounds(symmetry.getBounds());
+    stage->gain.setBounds(gain[0].getBounds());
+  }
+
+  for (auto& band : bands) {
+    band->spline.setBounds(spline.getBounds());
+    band->selectedKnot.setBounds(selectedKnot.getBounds());
+    band->symmetry.setBounds(symmetry.getBounds());
+    band->gain.setBounds(gain[0].getBounds());
+    band->crossover.setBounds(gain[1].getBounds());
+  }
+
+  left = offset;
+
+  auto const resizeFilterControl = [&](auto& c, int width) {
+    c.setTopLeftPosition(left, selectedKnot.getY());
+    c.setSize(width, 160._p);
+    left += width - 1;
+  };
+
+  resizeFilterControl(filterChannelLabels, 50._p);
+  filterTypeArea = { left, selectedKnot.getY(), (int)140._p, (int)160._p };
+  left += filterTypeArea.getWidth() - 1;
+
+  for (auto& filter : filters) {
+    filter->typeLabel.setBounds(filterTypeArea.withHeight(40._p));
+    filter->type.getControl().setSize(120._p, 30._p);
+    filter->type.getControl().setCentrePosition(filterTypeArea.getCentre());
+    int const filterLeft = left;
+    resizeFilterControl(filter->frequency, 140._p);
+    resizeFilterControl(filter->q, 140._p);
+    resizeFilterControl(filter->gain, 140._p);
+    left = filterLeft;
+  }
+
   left = splineEditorSide + 2 * offset;
   int top = splineEditorSide + 2 * offset;
   int const width = (190._p) - 1;
 
   using Track = Grid::TrackInfo;
 
-  midSide.getControl().setTopLeftPosition(left + 40._p, top);
-  midSide.getControl().setSize(100._p, 40._p);
+  {
+    Grid grid;
+    using Track = Grid::TrackInfo;
+
+    grid.templateColumns = { Track(1_fr) };
 
-  top += 80._p;
+    grid.templateRows = { Track(Grid::Px(40._p)),
+                          Track(Grid::Px(40._p)),
+                          Track(Grid::Px(40._p)),
+                          Track(Grid::Px(40._p)) };
+    grid.items = { GridItem(midSide.getControl())
+                     .withWidth(100._p)
+                     .withAlignSelf(GridItem::AlignSelf::center)
+                     .withJustifySelf(GridItem::JustifySelf::center),
+                   GridItem(numStages.getControl())
+                     .withWidth(135._p)
+                     .withHeight(30._p)
+                     .withAlignSelf(GridItem::AlignSelf::center)
+                     .withJustifySelf(GridItem::JustifySelf::center),
+                   GridItem(numBands.getControl())
+                     .withWidth(135._p)
+                     .withHeight(30._p)
+                     .withAlignSelf(GridItem::AlignSelf::center)
+                     .withJustifySelf(GridItem::JustifySelf::center),
+                   GridItem(editedPage)
+                     .withWidth(135._p)
+                     .withHeight(30._p)
+                     .withAlignSelf(GridItem::AlignSelf::center)
+                     .withJustifySelf(GridItem::JustifySelf::center) };
+
+    grid.performLayout(juce::Rectangle<int>(left, top, width, 160._p));
+  }
+
+  top += 170._p;
 
   {
     Grid grid;
@@ -226,7 +547,7 @@ OverdrawAudioProcessorEditor::Content::resized()
     grid.performLayout(juce::Rectangle<int>(left, top, width, 80._p));
   }
 
-  top += 130._p;
+  top += 90._p;
 
   {
     Grid grid;
@@ -257,11 +578,31 @@ OverdrawAudioProcessorEditor::Content::resized()
   url.setTopLeftPosition(10._p, getHeight() - 18._p);
   url.setSize(160._p, 16._p);
 
+  loadOverlayButton.setTopLeftPosition(180._p, getHeight() - 19._p);
+  loadOverlayButton.setSize(40._p, 18._p);
+
+  loadOverlay.setTopLeftPosition(offset + 10._p, offset + 10._p);
+  loadOverlay.setSize(240._p, 110._p);
+
+  settingsButton.setTopLeftPosition(225._p, getHeight() - 19._p);
+  settingsButton.setSize(60._p, 18._p);
+
+  settingsPanel.setSize(320._p, SettingsPanel::getIdealHeight(28._p));
+  settingsPanel.setTopLeftPosition(
+    spline.getRight() - settingsPanel.getWidth() - 10._p, offset + 10._p);
+
   spline.areaInWhichToDrawKnots = juce::Rectangle<int>(
     selectedKnot.getPosition().x,
     spline.getBottom() - offset,
     jmax(spline.getWidth(), selectedKnot.getWidth()),
     selectedKnot.getBottom() - spline.getBottom() + offset);
+
+  for (auto& stage : stages) {
+    stage->spline.areaInWhichToDrawKnots = spline.areaInWhichToDrawKnots;
+  }
+  for (auto& band : bands) {
+    band->spline.areaInWhichToDrawKnots = spline.areaInWhichToDrawKnots;
+  }
 }
 
 OverdrawAudioProcessorEditor::OverdrawAudioProcessorEditor(
@@ -20,7 +20,10 @@ along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
 #pragma once
 
 #include "GainVuMeter.h"
+#include "LoadOverlay.h"
 #include "PluginProcessor.h"
+#include "RepaintScheduler.h"
+#include "SettingsPanel.h"
 #include "SplineEditor.h"
 #include <JuceHeader.h>
 
@@ -42,6 +45,13 @@ private:
     void paint(Graphics&) override;
     void resized() override;
 
+    // pages: the waveshaping stages, the bands above the first one, then the
+    // pre and post filters
+    static constexpr int firstBandPage = OverdrawAudioProcessor::maxNumStages;
+    static constexpr int firstFilterPage =
+      firstBandPage + OverdrawAudioProcessor::maxNumBands - 1;
+    void showPage(int pageIndex);
+
     OverdrawAudioProcessor& processor;
 
     SplineEditor spline;
@@ -62,12 +72,78 @@ private:
     LinkableControl<AttachedToggle> symmetry;
     ChannelLabels channelLabels;
 
+    // the controls of the stages after the first one, which take the place of
+    // the spline editor, of the symmetry and of the input gain when selected
+    struct Stage
+    {
+      Stage(OverdrawAudioProcessor& processor, int stageIndex);
+
+      SplineEditor spline;
+      SplineKnotEditor selectedKnot;
+      LinkableControl<AttachedToggle> symmetry;
+      LinkableControl<AttachedSlider> gain;
+    };
+
+    std::array<std::unique_ptr<Stage>, OverdrawAudioProcessor::maxNumStages - 1>
+      stages;
+
+    AttachedComboBox numStages;
+
+    // the controls of the bands above the first one, which take the place of
+    // the spline editor, of the symmetry and of the gains when selected: the
+    // band gain in place of the input gain, the crossover below the band in
+    // place of the output gain
+    struct Band
+    {
+      Band(OverdrawAudioProcessor& processor, int bandIndex);
+
+      SplineEditor spline;
+      SplineKnotEditor selectedKnot;
+      LinkableControl<AttachedToggle> symmetry;
+      LinkableControl<AttachedSlider> gain;
+      LinkableControl<AttachedSlider> crossover;
+    };
+
+    std::array<std::unique_ptr<Band>, OverdrawAudioProcessor::maxNumBands - 1>
+      bands;
+
+    AttachedComboBox numBands;
+    ComboBox editedPage;
+    int pageIndex = 0;
+
+    // the pre and post filters, which take the place of the knot editor when
+    // selected
+    struct Filter
+    {
+      Filter(Component& parent, OverdrawAudioProcessor& processor, int index);
+
+      AttachedComboBox type;
+      Label typeLabel{ {}, "Type" };
+      LinkableControl<AttachedSlider> frequency;
+      LinkableControl<AttachedSlider> q;
+      LinkableControl<AttachedSlider> gain;
+    };
+
+    std::array<std::unique_ptr<Filter>, 2> filters;
+    ChannelLabels filterChannelLabels;
+    juce::Rectangle<int> filterTypeArea;
+
     TextEditor url;
 
+    // optional, stored in the state
+    LoadOverlay loadOverlay;
+    TextButton loadOverlayButton{ "CPU" };
+
+    SettingsPanel settingsPanel;
+    TextButton settingsButton{ "Settings" };
+
     Colour lineColour = Colours::white;
     Colour backgroundColour = Colours::black.withAlpha(0.6f);
 
     Image background;
+
+    // after the components it refreshes, so that it is destroyed first
+    RepaintScheduler repaintScheduler;
   };
 
   OverdrawAudioProcessor& processor;
@@ -20,17 +20,36 @@ along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace {
+// bit k is set if the order k uses the partitioned FFT engine: 16x and 32x by
+// default, where the direct linear-phase FIRs are the most expensive
+constexpr char const* kLinearPhaseFftOrdersProperty = "linearPhaseFftOrders";
+constexpr int kDefaultLinearPhaseFftOrders = (1 << 4) | (1 << 5);
+constexpr char const* kOfflineMultithreadingProperty = "offlineMultithreading";
+constexpr char const* kAdaptiveOversamplingProperty = "adaptiveOversampling";
+constexpr char const* kAdaptiveMinOrderProperty = "adaptiveOversamplingMin";
+constexpr char const* kAdaptiveMaxOrderProperty = "adaptiveOversamplingMax";
+constexpr char const* kControlRateAutomationProperty = "controlRateAutomation";
+constexpr char const* kAffineShortcutProperty = "affineShortcut";
+constexpr char const* kSessionCaptureVariable = "OVERDRAW_SESSION_CAPTURE";
+} // namespace
+
 OverdrawAudioProcessor::Parameters::Parameters(
   OverdrawAudioProcessor& processor)
 {
   AudioProcessorValueTreeState::ParameterLayout layout;
 
-  auto const createFloatParameter =
-    [&](String name, float value, float min, float max, float step = 0.01f) {
-      auto p = new AudioParameterFloat(name, name, { min, max, step }, value);
-      layout.add(std::unique_ptr<RangedAudioParameter>(p));
-      return static_cast<AudioParameterFloat*>(p);
-    };
+  auto const createFloatParameter = [&](String name,
+                                        float value,
+                                        float min,
+                                        float max,
+                                        float step = 0.01f,
+                                        float skew = 1.f) {
+    auto p =
+      new AudioParameterFloat(name, name, { min, max, step, skew }, value);
+    layout.add(std::unique_ptr<RangedAudioParameter>(p));
+    return static_cast<AudioParameterFloat*>(p);
+  };
 
   auto const createWrappedBoolParameter = [&](String name, bool value) {
     WrappedBoolParameter wrapper;
@@ -55,14 +74,18 @@ OverdrawAudioProcessor::Parameters::Parameters(
   String const ch1Suffix = "_ch1";
   String const linkSuffix = "_is_linked";
 
-  auto const createLinkableFloatParameters =
-    [&](String name, float value, float min, float max, float step = 0.01f) {
-      return LinkableParameter<AudioParameterFloat>{
-        createWrappedBoolParameter(name + linkSuffix, true),
-        { createFloatParameter(name + ch0Suffix, value, min, max, step),
-          createFloatParameter(name + ch1Suffix, value, min, max, step) }
-      };
+  auto const createLinkableFloatParameters = [&](String name,
+                                                 float value,
+                                                 float min,
+                                                 float max,
+                                                 float step = 0.01f,
+                                                 float skew = 1.f) {
+    return LinkableParameter<AudioParameterFloat>{
+      createWrappedBoolParameter(name + linkSuffix, true),
+      { createFloatParameter(name + ch0Suffix, value, min, max, step, skew),
+        createFloatParameter(name + ch1Suffix, value, min, max, step, skew) }
     };
+  };
 
   auto const createLinkableBoolParameters = [&](String name, bool value) {
     return LinkableParameter<WrappedBoolParameter>{
@@ -104,6 +127,54 @@ OverdrawAudioProcessor::Parameters::Parameters(
                          { -20.f, 20.f, 0.01f },
                          isKnotActive));
 
+  numStages = createChoiceParameter("Stages", { "1", "2", "3" });
+
+  auto const createStageParameters = [&](Stage& stage, String prefix) {
+    stage.gain =
+      createLinkableFloatParameters(prefix + "Gain", 0.f, -48.f, 48.f);
+    stage.symmetry = createLinkableBoolParameters(prefix + "Symmetry", true);
+    stage.spline = std::unique_ptr<SplineParameters>(
+      new SplineParameters(prefix,
+                           layout,
+                           OverdrawAudioProcessor::maxNumKnots,
+                           { -2.f, 2.f, 0.0001f },
+                           { -2.f, 2.f, 0.0001f },
+                           { -20.f, 20.f, 0.01f },
+                           isKnotActive));
+  };
+
+  for (int i = 0; i < maxNumStages - 1; ++i) {
+    createStageParameters(stages[i], "Stage-" + String(i + 2) + "-");
+  }
+
+  numBands = createChoiceParameter("Bands", { "1", "2", "3", "4" });
+
+  float const defaultCrossovers[maxNumBands - 1] = { 150.f, 1000.f, 5000.f };
+
+  for (int i = 0; i < maxNumBands - 1; ++i) {
+    String const name = "Crossover-" + String(i + 1) + "-Frequency";
+    crossovers[i] = createLinkableFloatParameters(
+      name, defaultCrossovers[i], 20.f, 20000.f, 1.f, 0.25f);
+  }
+
+  for (int i = 0; i < maxNumBands - 1; ++i) {
+    createStageParameters(bands[i], "Band-" + String(i + 2) + "-");
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    String const prefix = i == 0 ? "Pre-Filter-" : "Post-Filter-";
+    auto& filter = filters[i];
+    filter.type = createChoiceParameter(
+      prefix + "Type",
+      { "Off", "High Pass", "Low Pass", "Low Shelf", "High Shelf", "Peak" });
+    filter.frequency = createLinkableFloatParameters(
+      prefix + "Frequency", i == 0 ? 100.f : 8000.f, 20.f, 20000.f, 1.f, 0.25f);
+    filter.q = createLinkableFloatParameters(
+      prefix + "Q", 0.707f, 0.1f, 10.f, 0.001f, 0.5f);
+    filter.gain =
+      createLinkableFloatParameters(prefix + "Gain", 0.f, -24.f, 24.f);
+  }
+
   apvts = std::unique_ptr<AudioProcessorValueTreeState>(
     new AudioProcessorValueTreeState(
       processor, nullptr, "OVERDRAW-PARAMETERS", std::move(layout)));
@@ -119,30 +190,22 @@ OverdrawAudioProcessor::OverdrawAudioProcessor()
 
   , parameters(*this)
 
-  , dsp(Aligned<overdraw::Dsp>::make())
-
-  , oversamplingSettings([] {
-    auto s = oversimple::OversamplingSettings{};
-    s.numUpSampledChannels = 2;
-    s.numDownSampledChannels = 2;
-    s.upSampleOutputBufferType = oversimple::BufferType::interleaved;
-    s.downSampleInputBufferType = oversimple::BufferType::interleaved;
-    s.downSampleOutputBufferType = oversimple::BufferType::interleaved;
-    s.order = 1;
-    s.isUsingLinearPhase = false;
-    return s;
-  }())
-
-  , signalOversampling(oversamplingSettings)
-  , dryOversampling(oversamplingSettings)
-
-  , oversamplingAttachments(parameters.oversampling,
-                            *parameters.apvts,
-                            this,
-                            &oversamplingSettings,
-                            &oversamplingMutex,
-                            { &signalOversampling, &dryOversampling })
+  , oversamplingAttachments(
+      parameters.oversampling,
+      *parameters.apvts,
+      this,
+      &engine.getOversamplingSettings(),
+      &oversamplingMutex,
+      { &engine.getSignalOversampling(), &engine.getDryOversampling() })
 {
+  loadStateProperties();
+
+  auto const captureTarget =
+    SystemStats::getEnvironmentVariable(kSessionCaptureVariable, {});
+  if (File::isAbsolutePath(captureTarget)) {
+    sessionCaptureTarget = File(captureTarget);
+  }
+
   looks.simpleFontSize *= uiGlobalScaleFactor;
   looks.simpleSliderLabelFontSize *= uiGlobalScaleFactor;
   looks.simpleRotarySliderOffset *= uiGlobalScaleFactor;
@@ -153,39 +216,298 @@ OverdrawAudioProcessor::OverdrawAudioProcessor()
 void
 OverdrawAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-  floatToDouble = AudioBuffer<double>(2, samplesPerBlock);
-
-  dryBuffer.setNumSamples(samplesPerBlock);
+  maxNumSamples = jmax(1, samplesPerBlock);
 
   {
     auto const guard = std::lock_guard<std::recursive_mutex>(oversamplingMutex);
-    auto const maxIn = static_cast<uint32_t>(samplesPerBlock);
-    oversamplingSettings.maxNumInputSamples = maxIn;
-    signalOversampling.prepareBuffers(maxIn);
-    dryOversampling.prepareBuffers(maxIn);
+    engine.prepare(sampleRate, maxNumSamples);
+    if (isAdaptiveOversamplingOn) {
+      engine.buildAdaptiveOversamplers();
+    }
   }
 
+  arena.build([&](overdraw::Arena& a) { carveBuffers(a); });
+
   reset();
+
+  startSessionCapture(sampleRate);
+}
+
+void
+OverdrawAudioProcessor::carveBuffers(overdraw::Arena& a)
+{
+  auto const n = static_cast<size_t>(maxNumSamples);
+  for (int c = 0; c < 2; ++c) {
+    floatToDouble[c] = a.carve<double>(n);
+  }
+  for (int c = 0; c < 2; ++c) {
+    bypassBuffer[c] = a.carve<double>(n);
+  }
+  bypassDelay.carve(a, engine.getMaxLatency());
+}
+
+OverdrawAudioProcessor::MemoryFootprint
+OverdrawAudioProcessor::getMemoryFootprint() const
+{
+  auto footprint = engine.getMemoryFootprint();
+  footprint.arena += arena.getCapacity();
+  return footprint;
 }
 
 void
 OverdrawAudioProcessor::reset()
 {
-  parameters.spline->updateSpline(dsp->autoSpline);
-  dsp->autoSpline.reset();
+  setEngineParameters();
+  engine.reset();
 
-  constexpr double ln10 = 2.30258509299404568402;
-  constexpr double db_to_lin = ln10 / 20.0;
+  for (auto& vuMeterResult : vuMeterResults) {
+    vuMeterResult = 0.0;
+  }
 
-  vuMeterBuffer.fill(0.0);
+  // adaptive oversampling starts over from the order of the parameter
+  governedOrder = -1;
 
-  for (int c = 0; c < 2; ++c) {
-    wetAmount[c] = 0.01 * parameters.wet.get(c)->get();
-    for (int i = 0; i < 2; ++i) {
-      gain[i][c] = exp(db_to_lin * parameters.gain[i].get(c)->get());
-      vuMeterResults[c] = 0.0;
+  bypassDelay.reset(engine.getLatency());
+  isTrueBypassOn = false;
+  bypassMix = 0.0;
+  bypassWarmUp = 0;
+
+  sessionCapture.markReset();
+}
+
+void
+OverdrawAudioProcessor::setLinearPhaseEngine(
+  int oversamplingOrder,
+  LinearPhaseEngine linearPhaseEngine)
+{
+  jassert(oversamplingOrder >= 0 && oversamplingOrder < numOversamplingOrders);
+  linearPhaseEngines[oversamplingOrder] = linearPhaseEngine;
+
+  int fftOrders = 0;
+  for (int order = 0; order < numOversamplingOrders; ++order) {
+    if (linearPhaseEngines[order] == LinearPhaseEngine::partitionedFft) {
+      fftOrders |= 1 << order;
+    }
+  }
+  parameters.apvts->state.setProperty(
+    kLinearPhaseFftOrdersProperty, fftOrders, nullptr);
+}
+
+OverdrawAudioProcessor::LinearPhaseEngine
+OverdrawAudioProcessor::getLinearPhaseEngine(int oversamplingOrder) const
+{
+  jassert(oversamplingOrder >= 0 && oversamplingOrder < numOversamplingOrders);
+  return linearPhaseEngines[oversamplingOrder];
+}
+
+void
+OverdrawAudioProcessor::setOfflineMultithreading(bool isEnabled)
+{
+  if (isEnabled && !workerPool) {
+    workerPool = overdraw::WorkerPool::getShared();
+  }
+  offlineWorkerPool = isEnabled ? workerPool.get() : nullptr;
+  parameters.apvts->state.setProperty(
+    kOfflineMultithreadingProperty, isEnabled, nullptr);
+}
+
+bool
+OverdrawAudioProcessor::isOfflineMultithreadingEnabled() const
+{
+  return offlineWorkerPool.load() != nullptr;
+}
+
+void
+OverdrawAudioProcessor::setAdaptiveOversampling(bool isEnabled,
+                                                int minOrder,
+                                                int maxOrder)
+{
+  minOrder = jlimit(0, numOversamplingOrders - 1, minOrder);
+  maxOrder = jlimit(minOrder, numOversamplingOrders - 1, maxOrder);
+
+  // building the oversamplers allocates, so the audio thread waits for it
+  if (isEnabled && !engine.areAdaptiveOversamplersBuilt() &&
+      maxNumSamples > 0) {
+    suspendProcessing(true);
+    {
+      auto const guard =
+        std::lock_guard<std::recursive_mutex>(oversamplingMutex);
+      engine.buildAdaptiveOversamplers();
+    }
+    suspendProcessing(false);
+  }
+
+  adaptiveMinOrder = minOrder;
+  adaptiveMaxOrder = maxOrder;
+  isAdaptiveOversamplingOn = isEnabled;
+
+  auto& state = parameters.apvts->state;
+  state.setProperty(kAdaptiveOversamplingProperty, isEnabled, nullptr);
+  state.setProperty(kAdaptiveMinOrderProperty, minOrder, nullptr);
+  state.setProperty(kAdaptiveMaxOrderProperty, maxOrder, nullptr);
+}
+
+bool
+OverdrawAudioProcessor::isAdaptiveOversamplingEnabled() const
+{
+  return isAdaptiveOversamplingOn;
+}
+
+int
+OverdrawAudioProcessor::getAdaptiveOversamplingMinOrder() const
+{
+  return adaptiveMinOrder;
+}
+
+int
+OverdrawAudioProcessor::getAdaptiveOversamplingMaxOrder() const
+{
+  return adaptiveMaxOrder;
+}
+
+void
+OverdrawAudioProcessor::setControlRateAutomation(bool isEnabled)
+{
+  isControlRateAutomationOn = isEnabled;
+  parameters.apvts->state.setProperty(
+    kControlRateAutomationProperty, isEnabled, nullptr);
+}
+
+bool
+OverdrawAudioProcessor::isControlRateAutomationEnabled() const
+{
+  return isControlRateAutomationOn;
+}
+
+void
+OverdrawAudioProcessor::setAffineShortcut(bool isEnabled)
+{
+  isAffineShortcutOn = isEnabled;
+  parameters.apvts->state.setProperty(
+    kAffineShortcutProperty, isEnabled, nullptr);
+}
+
+bool
+OverdrawAudioProcessor::isAffineShortcutEnabled() const
+{
+  return isAffineShortcutOn;
+}
+
+void
+OverdrawAudioProcessor::setSessionCaptureTarget(File const& target)
+{
+  sessionCaptureTarget = target;
+  if (target == File()) {
+    sessionCapture.stop();
+  }
+}
+
+void
+OverdrawAudioProcessor::startSessionCapture(double sampleRate)
+{
+  sessionCapture.stop();
+  if (sessionCaptureTarget == File()) {
+    return;
+  }
+
+  // the instances that share a target, and the files of an instance, are
+  // told apart by the time and the identifier of the instance
+  auto const suffix = "-" +
+                      Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") +
+                      "-" + sessionCaptureId;
+  auto const isDirectory = sessionCaptureTarget.isDirectory();
+  auto const directory = isDirectory
+                           ? sessionCaptureTarget
+                           : sessionCaptureTarget.getParentDirectory();
+  auto const prefix = isDirectory
+                        ? String("overdraw")
+                        : sessionCaptureTarget.getFileNameWithoutExtension();
+  auto const extension =
+    isDirectory || sessionCaptureTarget.getFileExtension().isEmpty()
+      ? String(".ovdrsession")
+      : sessionCaptureTarget.getFileExtension();
+  auto const file =
+    directory.getNonexistentChildFile(prefix + suffix, extension, false);
+
+  MemoryBlock state;
+  getStateInformation(state);
+  auto const* stateBytes = static_cast<char const*>(state.getData());
+
+  sessionParameterValues.resize(getParameters().size());
+  readSessionParameterValues();
+
+  // a file that can't be written leaves the capture off, see
+  // isCapturingSession
+  sessionCapture.start(
+    file.getFullPathName().toStdString(),
+    sampleRate,
+    maxNumSamples,
+    std::vector<char>(stateBytes, stateBytes + state.getSize()),
+    sessionParameterValues,
+    readSessionSettings());
+}
+
+float const*
+OverdrawAudioProcessor::readSessionParameterValues()
+{
+  auto const& processorParameters = getParameters();
+  for (int i = 0; i < processorParameters.size(); ++i) {
+    sessionParameterValues[i] = processorParameters[i]->getValue();
+  }
+  return sessionParameterValues.data();
+}
+
+int32_t const*
+OverdrawAudioProcessor::readSessionSettings()
+{
+  using Setting = overdraw::SessionFormat::Setting;
+
+  int32_t fftOrders = 0;
+  for (int order = 0; order < numOversamplingOrders; ++order) {
+    if (linearPhaseEngines[order] == LinearPhaseEngine::partitionedFft) {
+      fftOrders |= 1 << order;
     }
   }
+  sessionSettings[Setting::linearPhaseFftOrders] = fftOrders;
+  sessionSettings[Setting::offlineMultithreading] =
+    offlineWorkerPool.load() != nullptr ? 1 : 0;
+  sessionSettings[Setting::adaptiveOversampling] =
+    isAdaptiveOversamplingOn ? 1 : 0;
+  sessionSettings[Setting::adaptiveMinOrder] = adaptiveMinOrder;
+  sessionSettings[Setting::adaptiveMaxOrder] = adaptiveMaxOrder;
+  sessionSettings[Setting::controlRateAutomation] =
+    isControlRateAutomationOn ? 1 : 0;
+  sessionSettings[Setting::affineShortcut] = isAffineShortcutOn ? 1 : 0;
+  return sessionSettings;
+}
+
+void
+OverdrawAudioProcessor::loadStateProperties()
+{
+  auto& state = parameters.apvts->state;
+
+  int const fftOrders = static_cast<int>(state.getProperty(
+    kLinearPhaseFftOrdersProperty, kDefaultLinearPhaseFftOrders));
+  for (int order = 0; order < numOversamplingOrders; ++order) {
+    linearPhaseEngines[order] = (fftOrders & (1 << order))
+                                  ? LinearPhaseEngine::partitionedFft
+                                  : LinearPhaseEngine::directFir;
+  }
+
+  setOfflineMultithreading(
+    static_cast<bool>(state.getProperty(kOfflineMultithreadingProperty, false)));
+
+  setAdaptiveOversampling(
+    static_cast<bool>(state.getProperty(kAdaptiveOversamplingProperty, false)),
+    static_cast<int>(state.getProperty(kAdaptiveMinOrderProperty, 0)),
+    static_cast<int>(state.getProperty(kAdaptiveMaxOrderProperty,
+                                       numOversamplingOrders - 1)));
+
+  setControlRateAutomation(static_cast<bool>(
+    state.getProperty(kControlRateAutomationProperty, false)));
+
+  setAffineShortcut(
+    static_cast<bool>(state.getProperty(kAffineShortcutProperty, false)));
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -201,26 +523,50 @@ OverdrawAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 #endif
 
 void
-OverdrawAudioProcessor::processBlock(AudioBuffer<float>& buffer,
-                                     MidiBuffer& midiMessages)
+OverdrawAudioProcessor::processBlock(AudioBuffer<float>& buffer, MidiBuffer&)
 {
   auto const totalNumInputChannels = getTotalNumInputChannels();
   auto const numSamples = buffer.getNumSamples();
 
-  floatToDouble.setSize(2, numSamples, false, false, true);
+  if (maxNumSamples == 0) {
+    return;
+  }
 
-  for (int c = 0; c < totalNumInputChannels; ++c) {
-    std::copy(buffer.getReadPointer(c),
-              buffer.getReadPointer(c) + numSamples,
-              floatToDouble.getWritePointer(c));
+  bool const isCapturing = sessionCapture.isRecording();
+  if (isCapturing) {
+    sessionCapture.beginBlock(buffer.getArrayOfReadPointers(),
+                              numSamples,
+                              loadMonitor.getLastLoad(),
+                              readSessionParameterValues(),
+                              readSessionSettings());
   }
 
-  processBlock(floatToDouble, midiMessages);
+  {
+    auto const timer = overdraw::LoadMonitor::Scope(
+      loadMonitor, numSamples / getSampleRate());
+
+    for (int offset = 0; offset < numSamples; offset += maxNumSamples) {
+      int const chunkSize = jmin(maxNumSamples, numSamples - offset);
+
+      for (int c = 0; c < totalNumInputChannels; ++c) {
+        std::copy(buffer.getReadPointer(c, offset),
+                  buffer.getReadPointer(c, offset) + chunkSize,
+                  floatToDouble[c]);
+      }
+
+      AudioBuffer<double> doubleBuffer(floatToDouble, 2, chunkSize);
+      process(doubleBuffer);
+
+      for (int c = 0; c < totalNumInputChannels; ++c) {
+        std::copy(floatToDouble[c],
+                  floatToDouble[c] + chunkSize,
+                  buffer.getWritePointer(c, offset));
+      }
+    }
+  }
 
-  for (int c = 0; c < totalNumInputChannels; ++c) {
-    std::copy(floatToDouble.getReadPointer(c),
-              floatToDouble.getReadPointer(c) + numSamples,
-              buffer.getWritePointer(c));
+  if (isCapturing) {
+    sessionCapture.endBlock(buffer.getArrayOfReadPointers(), numSamples);
   }
 }
 
@@ -240,6 +586,7 @@ OverdrawAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
   if (xmlState.get() != nullptr) {
     if (xmlState->hasTagName(parameters.apvts->state.getType())) {
       parameters.apvts->replaceState(ValueTree::fromXml(*xmlState));
+      loadStateProperties();
     }
   }
 }
@@ -247,7 +594,16 @@ OverdrawAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 void
 OverdrawAudioProcessor::releaseResources()
 {
-  floatToDouble = AudioBuffer<double>(0, 0);
+  {
+    auto const guard = std::lock_guard<std::recursive_mutex>(oversamplingMutex);
+    engine.release();
+  }
+  bypassDelay = {};
+  arena.release();
+  maxNumSamples = 0;
+  floatToDouble[0] = floatToDouble[1] = nullptr;
+  bypassBuffer[0] = bypassBuffer[1] = nullptr;
+  sessionCapture.stop();
 }
 
 //==============================================================================
@@ -19,12 +19,16 @@ along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include "AdaptiveOversampling.h"
+#include "Arena.h"
+#include "Engine.h"
 #include "Linkables.h"
-#include "OverdrawDsp.h"
+#include "LoadMonitor.h"
 #include "OversamplingAttachments.h"
+#include "SessionCapture.h"
 #include "SimpleLookAndFeel.h"
 #include "SplineParameters.h"
-#include "avec/Buffer.hpp"
+#include "WorkerPool.h"
 #include <JuceHeader.h>
 
 #ifndef OVERDRAW_UI_SCALE
@@ -43,6 +47,19 @@ class OverdrawAudioProcessor : public AudioProcessor
 public:
   static constexpr int maxNumKnots = overdraw::maxNumKnots;
 
+  // waveshaping stages in series inside the oversampled domain
+  static constexpr int maxNumStages = overdraw::Engine::maxNumStages;
+
+  // bands of the multiband mode, split and summed inside the oversampled
+  // domain, around the first stage
+  static constexpr int maxNumBands = overdraw::Engine::maxNumBands;
+
+  // 1x to 32x
+  static constexpr int numOversamplingOrders =
+    overdraw::Engine::numOversamplingOrders;
+
+  using LinearPhaseEngine = overdraw::Engine::LinearPhaseEngine;
+
 private:
   struct Parameters
   {
@@ -60,6 +77,46 @@ private:
 
     std::unique_ptr<SplineParameters> spline;
 
+    AudioParameterChoice* numStages;
+
+    // the stages after the first: each one has its own gain, applied in the
+    // oversampled domain, its own symmetry and its own spline
+    struct Stage
+    {
+      LinkableParameter<AudioParameterFloat> gain;
+
+      LinkableParameter<WrappedBoolParameter> symmetry;
+
+      std::unique_ptr<SplineParameters> spline;
+    };
+
+    std::array<Stage, maxNumStages - 1> stages;
+
+    AudioParameterChoice* numBands;
+
+    // the cutoff between each band and the next one
+    std::array<LinkableParameter<AudioParameterFloat>, maxNumBands - 1>
+      crossovers;
+
+    // the bands above the first one, which goes through the spline of the
+    // first stage: each one has the same controls as a stage
+    std::array<Stage, maxNumBands - 1> bands;
+
+    // the filters before and after the waveshaping stages, in the
+    // oversampled domain
+    struct Filter
+    {
+      AudioParameterChoice* type;
+
+      LinkableParameter<AudioParameterFloat> frequency;
+
+      LinkableParameter<AudioParameterFloat> q;
+
+      LinkableParameter<AudioParameterFloat> gain;
+    };
+
+    std::array<Filter, 2> filters;
+
     std::unique_ptr<AudioProcessorValueTreeState> apvts;
 
     Parameters(OverdrawAudioProcessor& processor);
@@ -67,25 +124,94 @@ private:
 
   Parameters parameters;
 
-  aligned_ptr<overdraw::Dsp> dsp;
-
-  double gain[2][2] = { { 1.0, 1.0 }, { 1.0, 1.0 } };
-  double wetAmount[2] = { 1.0, 1.0 };
+  // the processing, see Engine.h, with its parameters set from the plug-in
+  // ones at each block by setEngineParameters
+  overdraw::Engine engine;
 
-  avec::Buffer<double> dryBuffer{ 2 };
+  void setEngineParameters();
 
-  VecBuffer<Vec2d> vuMeterBuffer{ 3 };
+  // the buffers of the processor, around the ones of the engine, are carved
+  // from a single arena in prepareToPlay. Blocks longer than the one given to
+  // prepareToPlay are processed in chunks.
+  overdraw::Arena arena;
+  int maxNumSamples = 0;
 
   // buffer for single precision processing call
-  AudioBuffer<double> floatToDouble;
+  double* floatToDouble[2] = { nullptr, nullptr };
+
+  void carveBuffers(overdraw::Arena& arena);
+
+  // the body of processBlock, for blocks of up to maxNumSamples
+  void process(AudioBuffer<double>& buffer);
+
+  overdraw::LoadMonitor loadMonitor;
 
-  // oversampling
-  oversimple::OversamplingSettings oversamplingSettings;
-  oversimple::TOversampling<double> signalOversampling;
-  oversimple::TOversampling<double> dryOversampling;
+  // Session capture, see setSessionCaptureTarget. The normalized values of
+  // the parameters and the settings are read into sessionParameterValues and
+  // sessionSettings at each block. The names of the capture files end with
+  // sessionCaptureId, which tells the instances apart.
+  overdraw::SessionCapture sessionCapture;
+  File sessionCaptureTarget;
+  String const sessionCaptureId = Uuid().toString().substring(0, 8);
+  std::vector<float> sessionParameterValues;
+  int32_t sessionSettings[overdraw::SessionFormat::numSettings] = {};
+
+  void startSessionCapture(double sampleRate);
+  float const* readSessionParameterValues();
+  int32_t const* readSessionSettings();
+
+  // oversampling, the attachments reconfigure the oversamplers of the engine
+  // in place
   std::recursive_mutex oversamplingMutex;
   OversamplingAttachments<std::recursive_mutex> oversamplingAttachments;
 
+  std::array<std::atomic<LinearPhaseEngine>, numOversamplingOrders>
+    linearPhaseEngines;
+
+  // Adaptive oversampling, see overdraw::Engine::buildAdaptiveOversamplers.
+  // The governor chooses the order from the load of the processor, and the
+  // engine runs it once the switch is possible.
+  std::atomic<bool> isAdaptiveOversamplingOn{ false };
+  std::atomic<int> adaptiveMinOrder{ 0 };
+  std::atomic<int> adaptiveMaxOrder{ numOversamplingOrders - 1 };
+  std::atomic<int> oversamplingOrderInUse{ 0 };
+
+  overdraw::OversamplingGovernor governor;
+  // the order of the Oversampling parameter the governor started from, -1
+  // when adaptive oversampling is off
+  int governedOrder = -1;
+  bool isGovernedLinearPhase = false;
+
+  void updateAdaptiveOversampling(int numSamples);
+
+  // True bypass. While the wet amount is zero on both channels, nothing is
+  // resampled and the output is the input delayed by the latency reported to
+  // the host. The delay line always runs, so that entering bypass can
+  // crossfade from the processed output to the delayed input. When the wet
+  // amount rises again, the engine starts from a clear state and the delayed
+  // input is kept until its resampling paths have filled their latency, as
+  // when adaptive oversampling switches order, then the crossfade goes back.
+  // The wet amount is held at zero until the processed output has taken over.
+  overdraw::LatencyCompensation bypassDelay;
+  double* bypassBuffer[2] = { nullptr, nullptr };
+  bool isTrueBypassOn = false;
+  // 0 for the processed output, 1 for the delayed input
+  double bypassMix = 0.0;
+  // samples left before the processed output can fade in again
+  int bypassWarmUp = 0;
+
+  std::atomic<bool> isAffineShortcutOn{ false };
+
+  // offline multithreading: the pool is shared by all the instances and kept
+  // alive while the option is on, the audio thread only sees the raw pointer
+  std::shared_ptr<overdraw::WorkerPool> workerPool;
+  std::atomic<overdraw::WorkerPool*> offlineWorkerPool{ nullptr };
+
+  std::atomic<bool> isControlRateAutomationOn{ false };
+
+  // loads the settings that are stored in the state but are not parameters
+  void loadStateProperties();
+
 public:
   // for gui
   SimpleLookAndFeel looks;
@@ -93,6 +219,80 @@ public:
 
   Parameters& getOverdrawParameters() { return parameters; }
 
+  // Which engine runs linear-phase oversampling at each order. Both have the
+  // same latency, so this can change while playing: the engine crossfades
+  // them. Stored in the plug-in state. Message thread only.
+  void setLinearPhaseEngine(int oversamplingOrder,
+                            LinearPhaseEngine linearPhaseEngine);
+  LinearPhaseEngine getLinearPhaseEngine(int oversamplingOrder) const;
+
+  // When enabled, and only while the host renders offline, the dry and the
+  // signal resampling, and the channels of the FFT engines, run in parallel
+  // on a pool of worker threads. Stored in the plug-in state. Message thread
+  // only.
+  void setOfflineMultithreading(bool isEnabled);
+  bool isOfflineMultithreadingEnabled() const;
+
+  // When enabled, the processor measures its own load and, when it is high,
+  // lowers the oversampling order, down to minOrder, and raises it back when
+  // the load allows, up to maxOrder and never above the order of the
+  // Oversampling parameter. The latency reported to the host does not change.
+  // Stored in the plug-in state. Message thread only.
+  void setAdaptiveOversampling(bool isEnabled, int minOrder, int maxOrder);
+  bool isAdaptiveOversamplingEnabled() const;
+  int getAdaptiveOversamplingMinOrder() const;
+  int getAdaptiveOversamplingMaxOrder() const;
+
+  // When enabled, moving knots are smoothed at control rate instead of on
+  // every upsampled sample, see overdraw::Dsp::setControlRateAutomation.
+  // Stored in the plug-in state. Message thread only.
+  void setControlRateAutomation(bool isEnabled);
+  bool isControlRateAutomationEnabled() const;
+
+  // When enabled, quiet passages that stay where the curves are straight
+  // lines skip the resampling and the waveshaping, see the affine shortcut in
+  // Engine.h. Stored in the plug-in state. Message thread only.
+  void setAffineShortcut(bool isEnabled);
+  bool isAffineShortcutEnabled() const;
+
+  // Session capture: the input, the block sizes, the parameters, the settings
+  // above and the output of processBlock are recorded to a file from the next
+  // prepareToPlay on, where OverdrawReplay starts a fresh processor to run
+  // them again, see SessionCapture.h. Each prepareToPlay starts a new file,
+  // named after the time and the instance: in the target, if it is a
+  // directory, or next to it, with its name as a prefix. The
+  // OVERDRAW_SESSION_CAPTURE environment variable, an absolute path, sets the
+  // target of every instance. An empty File stops the capture. Not stored in
+  // the plug-in state. Message thread only.
+  void setSessionCaptureTarget(File const& target);
+  bool isCapturingSession() const { return sessionCapture.isRecording(); }
+
+  // OverdrawReplay only: the load that adaptive oversampling sees at the next
+  // block, instead of the measured one. Audio thread only.
+  void setLoadForReplay(double load) { loadMonitor.setLastLoad(load); }
+
+  // The oversampling order in use, which differs from the parameter when
+  // adaptive oversampling has lowered it. Any thread.
+  int getOversamplingOrderInUse() const { return oversamplingOrderInUse; }
+
+  // the arena of the engine also counts the one of the processor
+  using MemoryFootprint = overdraw::Engine::MemoryFootprint;
+
+  // Memory used by the audio buffers of this instance, in bytes.
+  MemoryFootprint getMemoryFootprint() const;
+
+  // Time spent in processBlock relative to the duration of each block, since
+  // the last reset. Any thread.
+  overdraw::LoadMonitor::Report getLoadReport() const
+  {
+    return loadMonitor.getReport();
+  }
+  uint64_t getNumDeadlineMisses() const
+  {
+    return loadMonitor.getNumDeadlineMisses();
+  }
+  void resetLoadReport() { loadMonitor.reset(); }
+
   // AudioProcessor interface
 
   //==============================================================================
@@ -19,249 +19,235 @@ along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "PluginProcessor.h"
 
-static void
-leftRightToMidSide(double** io, int const n)
+void
+OverdrawAudioProcessor::setEngineParameters()
 {
-  for (int i = 0; i < n; ++i) {
-    double m = 0.5 * (io[0][i] + io[1][i]);
-    double s = 0.5 * (io[0][i] - io[1][i]);
-    io[0][i] = m;
-    io[1][i] = s;
-  }
-}
+  auto& p = engine.parameters;
 
-static void
-midSideToLeftRight(double** io, int const n)
-{
-  for (int i = 0; i < n; ++i) {
-    double l = io[0][i] + io[1][i];
-    double r = io[0][i] - io[1][i];
-    io[0][i] = l;
-    io[1][i] = r;
-  }
-}
+  p.isMidSideEnabled = parameters.midSide->get();
+  p.smoothingTime = parameters.smoothingTime->get();
+  p.isControlRateAutomationEnabled = isControlRateAutomationOn;
+  p.isAffineShortcutEnabled = isAffineShortcutOn;
 
-static void
-applyGain(double** io,
-          double* gain_target,
-          double* gain_state,
-          double const alpha,
-          int const n)
-{
   for (int c = 0; c < 2; ++c) {
-    for (int i = 0; i < n; ++i) {
-      gain_state[c] = gain_target[c] + alpha * (gain_state[c] - gain_target[c]);
-      io[c][i] *= gain_state[c];
-    }
+    p.inputGain[c] = parameters.gain[0].get(c)->get();
+    p.outputGain[c] = parameters.gain[1].get(c)->get();
+    p.wet[c] = parameters.wet.get(c)->get();
   }
-}
-
-static inline Vec2d
-toDB(Vec2d linear)
-{
-  return (10.0 / 2.30258509299404568402) *
-         log(linear + std::numeric_limits<float>::min());
-}
-
-void
-OverdrawAudioProcessor::processBlock(AudioBuffer<double>& buffer,
-                                     MidiBuffer& midi)
-{
-  constexpr double ln10 = 2.30258509299404568402;
-  constexpr double db_to_lin = ln10 / 20.0;
 
-  ScopedNoDenormals noDenormals;
-
-  auto const totalNumOutputChannels = getTotalNumOutputChannels();
-  auto const numSamples = buffer.getNumSamples();
-
-  double* ioAudio[2] = { buffer.getWritePointer(0), buffer.getWritePointer(1) };
+  p.numStages = parameters.numStages->getIndex() + 1;
+  p.numBands = parameters.numBands->getIndex() + 1;
 
-  bool const isMidSideEnabled = parameters.midSide->get();
-
-  int numActiveKnots = parameters.spline->updateSpline(dsp->autoSpline);
-
-  double const smoothingTime = 0.001 * parameters.smoothingTime->get();
-
-  double const invSampleRate = 1.0 / getSampleRate();
-
-  double const automationAlpha =
-    smoothingTime == 0.0
-      ? 0.0
-      : exp(-MathConstants<double>::twoPi * invSampleRate / smoothingTime);
-
-  double const invUpsampledSampleRate =
-    invSampleRate / signalOversampling.getOversamplingRate();
-
-  double const upsampledAutomationAlpha =
-    smoothingTime == 0.0 ? 0.0
-                         : exp(-MathConstants<double>::twoPi *
-                               invUpsampledSampleRate / smoothingTime);
-
-  dsp->autoSpline.automator.setSmoothingAlpha(upsampledAutomationAlpha);
-
-  double gainTarget[2][2];
-  double wetAmountTarget[2];
-
-  for (int c = 0; c < 2; ++c) {
-
-    wetAmountTarget[c] = 0.01 * parameters.wet.get(c)->get();
+  auto const setSpline =
+    [&](int const s,
+        SplineParameters& spline,
+        LinkableParameter<WrappedBoolParameter>& symmetry) {
+      engine.setNumKnots(s, spline.updateSpline(engine.getKnots(s)));
+      for (int c = 0; c < 2; ++c) {
+        p.isSymmetric[s][c] = symmetry.get(c)->getValue();
+      }
+    };
 
-    for (int i = 0; i < 2; ++i) {
-      gainTarget[i][c] = exp(db_to_lin * parameters.gain[i].get(c)->get());
+  auto const setStage = [&](int const s, Parameters::Stage& stage) {
+    setSpline(s, *stage.spline, stage.symmetry);
+    for (int c = 0; c < 2; ++c) {
+      p.splineGain[s][c] = stage.gain.get(c)->get();
     }
+  };
 
-    dsp->autoSpline.spline.setIsSymmetric(
-      c, parameters.symmetry.get(c)->getValue());
+  setSpline(0, *parameters.spline, parameters.symmetry);
+  for (int i = 0; i < maxNumStages - 1; ++i) {
+    setStage(i + 1, parameters.stages[i]);
+  }
+  for (int i = 0; i < maxNumBands - 1; ++i) {
+    setStage(overdraw::Engine::getBandSpline(i + 1), parameters.bands[i]);
   }
 
-  bool const isWetPassNeeded = [&] {
-    double m =
-      wetAmountTarget[0] * wetAmountTarget[1] * wetAmount[0] * wetAmount[1];
-    if (m == 1.0) {
-      return false;
+  for (int i = 0; i < maxNumBands - 1; ++i) {
+    for (int c = 0; c < 2; ++c) {
+      p.crossover[i][c] = parameters.crossovers[i].get(c)->get();
     }
-    if (m == 0.0) {
-      return !(wetAmountTarget[0] == 0.0 && wetAmountTarget[1] == 0.0 &&
-               wetAmount[0] == 0.0 && wetAmount[1] == 0.0);
-    }
-    return true;
-  }();
+  }
 
-  bool const isBypassing = !isWetPassNeeded && (wetAmount[0] == 0.0);
+  for (int i = 0; i < 2; ++i) {
+    auto& filter = parameters.filters[i];
+    p.filters[i].type =
+      static_cast<overdraw::Svf::Type>(filter.type->getIndex());
+    for (int c = 0; c < 2; ++c) {
+      p.filters[i].frequency[c] = filter.frequency.get(c)->get();
+      p.filters[i].q[c] = filter.q.get(c)->get();
+      p.filters[i].gain[c] = filter.gain.get(c)->get();
+    }
+  }
 
-  // mid side
+  for (int order = 0; order < numOversamplingOrders; ++order) {
+    p.linearPhaseEngines[order] = linearPhaseEngines[order];
+  }
+}
 
-  if (isMidSideEnabled) {
-    leftRightToMidSide(ioAudio, numSamples);
+// Chooses the order the engine runs at. The governor starts over from the
+// order of the parameter when it changes, and from the order in use while the
+// affine shortcut stands in for the resampling or when the engine has refused
+// the previous choice, which had more latency than the parameter one.
+void
+OverdrawAudioProcessor::updateAdaptiveOversampling(int const numSamples)
+{
+  if (!isAdaptiveOversamplingOn || !engine.areAdaptiveOversamplersBuilt()) {
+    governedOrder = -1;
+    engine.parameters.adaptiveOrder = -1;
+    return;
   }
 
-  // copy the dry signal
+  int const order = engine.getOversamplingOrder();
+  bool const isLinearPhase = engine.isUsingLinearPhase();
+  int const orderInUse = engine.getOversamplingOrderInUse();
+
+  if (order != governedOrder || isLinearPhase != isGovernedLinearPhase) {
+    governedOrder = order;
+    isGovernedLinearPhase = isLinearPhase;
+    governor.reset(order);
+  }
+  else if (engine.isResamplingIdle()) {
+    governor.reset(orderInUse);
+  }
+  else if (!engine.isSwitchingOversamplingOrder()) {
+    if (governor.getOrder() != orderInUse) {
+      governor.reset(orderInUse);
+    }
+    int const maxOrder = jmin(adaptiveMaxOrder.load(), order);
+    int const minOrder = jmin(adaptiveMinOrder.load(), maxOrder);
+    governor.update(loadMonitor.getLastLoad(),
+                    numSamples / getSampleRate(),
+                    minOrder,
+                    maxOrder);
+  }
 
-  dryBuffer.setNumSamples(numSamples);
+  engine.parameters.adaptiveOrder = governor.getOrder();
+}
 
-  for (int c = 0; c < 2; ++c) {
-    std::copy(ioAudio[c], ioAudio[c] + numSamples, dryBuffer.get()[c]);
+void
+OverdrawAudioProcessor::processBlock(AudioBuffer<double>& buffer, MidiBuffer&)
+{
+  if (maxNumSamples == 0) {
+    return;
   }
 
-  // input gain
+  int const numSamples = buffer.getNumSamples();
 
-  applyGain(ioAudio, gainTarget[0], gain[0], automationAlpha, numSamples);
+  bool const isCapturing = sessionCapture.isRecording();
+  if (isCapturing) {
+    sessionCapture.beginBlock(buffer.getArrayOfReadPointers(),
+                              numSamples,
+                              loadMonitor.getLastLoad(),
+                              readSessionParameterValues(),
+                              readSessionSettings());
+  }
 
-  // oversampling
+  {
+    auto const timer =
+      overdraw::LoadMonitor::Scope(loadMonitor, numSamples / getSampleRate());
+    process(buffer);
+  }
 
-  auto const numInputSamples = static_cast<uint32_t>(numSamples);
+  if (isCapturing) {
+    sessionCapture.endBlock(buffer.getArrayOfReadPointers(), numSamples);
+  }
+}
 
-  signalOversampling.prepareBuffers(numInputSamples);
-  dryOversampling.prepareBuffers(numInputSamples);
+void
+OverdrawAudioProcessor::process(AudioBuffer<double>& buffer)
+{
+  ScopedNoDenormals noDenormals;
 
-  uint32_t const numUpsampledSamples =
-    signalOversampling.upSample(ioAudio, numInputSamples);
+  auto const numSamples = buffer.getNumSamples();
 
-  dryOversampling.upSample(dryBuffer.get(), numInputSamples);
+  if (maxNumSamples == 0) {
+    return;
+  }
 
-  if (numUpsampledSamples == 0) {
-    for (auto i = 0; i < totalNumOutputChannels; ++i) {
-      buffer.clear(i, 0, numSamples);
+  if (numSamples > maxNumSamples) {
+    for (int offset = 0; offset < numSamples; offset += maxNumSamples) {
+      double* chunk[2] = { buffer.getWritePointer(0, offset),
+                           buffer.getWritePointer(1, offset) };
+      AudioBuffer<double> chunkBuffer(
+        chunk, 2, jmin(maxNumSamples, numSamples - offset));
+      process(chunkBuffer);
     }
     return;
   }
 
-  auto& upsampledBuffer = signalOversampling.getUpSampleOutputInterleaved();
-  auto& upsampledIo = upsampledBuffer.getBuffer2(0);
+  double* ioAudio[2] = { buffer.getWritePointer(0), buffer.getWritePointer(1) };
 
-  // waveshaping
+  setEngineParameters();
 
-  if (!isBypassing) {
-    dsp->waveshape(upsampledIo, numActiveKnots);
-  }
+  // true bypass, see PluginProcessor.h
 
-  // downsampling
+  bool const isWetSilent = engine.isWetSilent();
 
-  signalOversampling.downSample(upsampledBuffer, numInputSamples);
-  dryOversampling.downSample(dryOversampling.getUpSampleOutputInterleaved(),
-                             numInputSamples);
+  if (isTrueBypassOn || bypassMix > 0.0) {
+    engine.parameters.wet[0] = engine.parameters.wet[1] = 0.0;
+  }
 
-  // dry-wet and output gain
+  int const latency = engine.getLatency();
+  int const fadeLength =
+    jmax(1, roundToInt(overdraw::Engine::fadeSeconds * getSampleRate()));
 
-  auto& wetOutput = signalOversampling.getDownSampleOutputInterleaved();
-  auto& dryOutput = dryOversampling.getDownSampleOutputInterleaved();
+  if (bypassDelay.getDelay() != latency) {
+    bypassDelay.reset(latency);
+  }
+  bypassDelay.process(ioAudio, bypassBuffer, numSamples);
 
-  constexpr double vuMeterFrequency = 10.0;
+  if (isTrueBypassOn) {
+    if (isWetSilent) {
+      for (int c = 0; c < 2; ++c) {
+        std::copy(bypassBuffer[c], bypassBuffer[c] + numSamples, ioAudio[c]);
+      }
+      return;
+    }
+    // the engine starts over, with the wet amount still at zero
+    isTrueBypassOn = false;
+    bypassWarmUp = 2 * latency + fadeLength;
+    engine.reset();
+  }
 
-  Vec2d vuMeterAlpha =
-    exp(-MathConstants<double>::twoPi * invSampleRate * vuMeterFrequency);
+  // the engine, with the order chosen for adaptive oversampling, and the
+  // worker pool when rendering offline with multithreading enabled
 
-  auto& wetData = wetOutput.getBuffer2(0);
-  auto& dryData = dryOutput.getBuffer2(0);
+  updateAdaptiveOversampling(numSamples);
 
-  Vec2d alpha = automationAlpha;
+  engine.setWorkerPool(isNonRealtime() ? offlineWorkerPool.load() : nullptr);
 
-  Vec2d outputGain = Vec2d().load(gain[1]);
-  Vec2d outputGainTarget = Vec2d().load(gainTarget[1]);
+  engine.process(ioAudio, numSamples);
 
-  Vec2d vuMeterDry = vuMeterBuffer[0];
-  Vec2d vuMeterWet = vuMeterBuffer[1];
-  VecView<Vec2d> vuMeter = vuMeterBuffer[2];
+  oversamplingOrderInUse = engine.getOversamplingOrderInUse();
 
-  if (isWetPassNeeded) {
+  // crossfade between the processed output and the delayed input
 
-    Vec2d amount = Vec2d().load(wetAmount);
-    Vec2d amountTarget = Vec2d().load(wetAmountTarget);
+  double const bypassTarget = isWetSilent ? 1.0 : 0.0;
 
+  if (bypassMix != bypassTarget || bypassWarmUp > 0) {
+    double const bypassStep = bypassMix < bypassTarget ? 1.0 / fadeLength
+                                                       : -1.0 / fadeLength;
     for (int i = 0; i < numSamples; ++i) {
-      amount = alpha * (amount - amountTarget) + amountTarget;
-      outputGain = alpha * (outputGain - outputGainTarget) + outputGainTarget;
-      Vec2d wet = outputGain * wetData[i];
-      Vec2d dry = dryData[i];
-      wetData[i] = amount * (wet - dry) + dry;
-      Vec2d wet2 = wet * wet;
-      Vec2d dry2 = dry * dry;
-      vuMeterWet = vuMeterAlpha * (vuMeterWet - wet2) + wet2;
-      vuMeterDry = vuMeterAlpha * (vuMeterDry - dry2) + dry2;
-    }
-
-    amount.store(wetAmount);
-  }
-  else {
-    if (!isBypassing) {
-
-      for (int i = 0; i < numSamples; ++i) {
-        outputGain = alpha * (outputGain - outputGainTarget) + outputGainTarget;
-        Vec2d wet = outputGain * wetData[i];
-        wetData[i] = wet;
-        Vec2d dry = dryData[i];
-        Vec2d wet2 = wet * wet;
-        Vec2d dry2 = dry * dry;
-        vuMeterWet = vuMeterAlpha * (vuMeterWet - wet2) + wet2;
-        vuMeterDry = vuMeterAlpha * (vuMeterDry - dry2) + dry2;
+      if (bypassWarmUp > 0) {
+        --bypassWarmUp;
+      }
+      else if (bypassMix != bypassTarget) {
+        bypassMix = jlimit(0.0, 1.0, bypassMix + bypassStep);
+      }
+      for (int c = 0; c < 2; ++c) {
+        ioAudio[c][i] += bypassMix * (bypassBuffer[c][i] - ioAudio[c][i]);
       }
     }
   }
 
-  if (isBypassing) {
-    vuMeterBuffer[2] = 0.0;
-    dryOutput.deinterleave(ioAudio, 2, numSamples);
-  }
-  else {
-    outputGain.store(gain[1]);
-    vuMeterBuffer[0] = vuMeterDry;
-    vuMeterBuffer[1] = vuMeterWet;
-    Vec2d gainOffset = outputGainTarget * Vec2d().load(gainTarget[0]);
-    gainOffset *= gainOffset;
-    vuMeter = toDB(vuMeterWet) - toDB(gainOffset * vuMeterDry);
-
-    wetOutput.deinterleave(ioAudio, 2, numSamples);
-  }
-
-  // mid side
-
-  if (isMidSideEnabled) {
-    midSideToLeftRight(ioAudio, numSamples);
+  if (isWetSilent && bypassMix == 1.0) {
+    isTrueBypassOn = true;
+    bypassWarmUp = 0;
   }
 
   // update vu meter
 
-  vuMeterResults[0] = (float)(vuMeter[0]);
-  vuMeterResults[1] = (float)(vuMeter[1]);
+  vuMeterResults[0] = (float)(engine.getVuMeter(0));
+  vuMeterResults[1] = (float)(engine.getVuMeter(1));
 }
@@ -0,0 +1,127 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "avec/Avec.hpp"
+#include <cmath>
+
+namespace overdraw {
+
+// Closed-form one-pole smoothing of parameters toward their targets.
+// The recurrence y[i] = t + alpha * (y[i-1] - t) gives
+// y[i] = t + alpha^(i+1) * (y[-1] - t): the distance from the target is a
+// geometric sequence, so the values of consecutive samples can be computed
+// independently of each other instead of in a serial chain.
+
+// distance from the target, relative to it, below which a value snaps to it
+inline constexpr double rampSettleThreshold = 1.0e-9;
+
+inline bool
+isRampSettled(double const value, double const target)
+{
+  return std::abs(value - target) <=
+         rampSettleThreshold * (1.0 + std::abs(target));
+}
+
+inline bool
+isRampSettled(Vec2d const value, Vec2d const target)
+{
+  return isRampSettled(value[0], target[0]) &&
+         isRampSettled(value[1], target[1]);
+}
+
+/**
+ * Calls function(i, power) for i in [0, n), with power = alpha^(i+1). The
+ * powers of each group of four samples are computed from the one at the start
+ * of the group, so there is a single serial multiply every four samples.
+ */
+template<class Function>
+void
+forEachRampPower(int const n, double const alpha, Function&& function)
+{
+  double const alpha2 = alpha * alpha;
+  double const alpha3 = alpha2 * alpha;
+  double const alpha4 = alpha2 * alpha2;
+  double power = 1.0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    function(i, power * alpha);
+    function(i + 1, power * alpha2);
+    function(i + 2, power * alpha3);
+    function(i + 3, power * alpha4);
+    power *= alpha4;
+  }
+  for (; i < n; ++i) {
+    power *= alpha;
+    function(i, power);
+  }
+}
+
+/**
+ * Multiplies a channel by a gain smoothed toward target, a vector of
+ * consecutive samples at a time. Once the gain is settled, it is a constant
+ * multiply, or nothing at unity gain.
+ * @return the gain after the last sample
+ */
+template<class Vec>
+double
+applyGainRamp(double* io,
+              double const value,
+              double const target,
+              double const alpha,
+              int const n)
+{
+  constexpr int width = Vec::size();
+
+  if (isRampSettled(value, target)) {
+    if (target != 1.0) {
+      for (int i = 0; i < n; ++i) {
+        io[i] *= target;
+      }
+    }
+    return target;
+  }
+
+  alignas(64) double lanes[width];
+  double power = 1.0;
+  for (int k = 0; k < width; ++k) {
+    power *= alpha;
+    lanes[k] = (value - target) * power;
+  }
+  Vec distance = Vec().load_a(lanes);
+  Vec const step = power;
+  Vec const t = target;
+
+  int i = 0;
+  for (; i + width <= n; i += width) {
+    Vec const x = Vec().load(io + i);
+    (x * (t + distance)).store(io + i);
+    distance *= step;
+  }
+  distance.store_a(lanes);
+  for (int k = 0; i + k < n; ++k) {
+    io[i + k] *= target + lanes[k];
+  }
+
+  double const next = target + (value - target) * std::pow(alpha, n);
+  return isRampSettled(next, target) ? target : next;
+}
+
+} // namespace overdraw
@@ -0,0 +1,168 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "RepaintScheduler.h"
+
+RepaintScheduler::RepaintScheduler(OverdrawAudioProcessor& processor,
+                                   Component& editor)
+  : ComponentMovementWatcher(&editor)
+  , processor(processor)
+  , editor(editor)
+{
+  for (auto* parameter : processor.getParameters()) {
+    parameter->addListener(this);
+  }
+  editor.addMouseListener(this, true);
+  updateTimer();
+}
+
+RepaintScheduler::~RepaintScheduler()
+{
+  stopTimer();
+  cancelPendingUpdate();
+  editor.removeMouseListener(this);
+  for (auto* parameter : processor.getParameters()) {
+    parameter->removeListener(this);
+  }
+}
+
+void
+RepaintScheduler::addParameterView(Component& component)
+{
+  if (auto* timer = dynamic_cast<Timer*>(&component)) {
+    timer->stopTimer();
+  }
+  parameterViews.push_back(&component);
+  wakeUp();
+}
+
+void
+RepaintScheduler::addMeter(Component& component,
+                           std::vector<std::atomic<float>*> values,
+                           float threshold)
+{
+  if (auto* timer = dynamic_cast<Timer*>(&component)) {
+    timer->stopTimer();
+  }
+  auto paintedValues = std::vector<float>(values.size(), 0.f);
+  meters.push_back(
+    { &component, std::move(values), std::move(paintedValues), threshold });
+  wakeUp();
+}
+
+void
+RepaintScheduler::refresh(Component& component)
+{
+  if (!component.isShowing()) {
+    return;
+  }
+  if (auto* timer = dynamic_cast<Timer*>(&component)) {
+    timer->timerCallback();
+  }
+  component.repaint();
+}
+
+void
+RepaintScheduler::wakeUp()
+{
+  numIdleTicks = 0;
+  updateTimer();
+}
+
+void
+RepaintScheduler::updateTimer()
+{
+  // a minimized editor is polled at the idle rate, as restoring it does not
+  // notify the watcher
+  auto* peer = editor.getPeer();
+  bool const isShowing = editor.isShowing();
+  if (peer == nullptr || (!isShowing && !peer->isMinimised())) {
+    stopTimer();
+    return;
+  }
+  bool const isActive = isShowing && numIdleTicks < numTicksToIdle;
+  int const rate = isActive ? activeRate : idleRate;
+  if (!isTimerRunning() || getTimerInterval() != 1000 / rate) {
+    startTimerHz(rate);
+  }
+}
+
+void
+RepaintScheduler::timerCallback()
+{
+  bool isChanged = false;
+
+  if (areParametersChanged.exchange(false)) {
+    for (auto* view : parameterViews) {
+      refresh(*view);
+    }
+    isChanged = true;
+  }
+
+  for (auto& meter : meters) {
+    bool isMeterChanged = false;
+    for (size_t i = 0; i < meter.values.size(); ++i) {
+      float const value = meter.values[i]->load(std::memory_order_relaxed);
+      if (std::abs(value - meter.paintedValues[i]) > meter.threshold) {
+        isMeterChanged = true;
+      }
+    }
+    if (isMeterChanged) {
+      for (size_t i = 0; i < meter.values.size(); ++i) {
+        meter.paintedValues[i] =
+          meter.values[i]->load(std::memory_order_relaxed);
+      }
+      refresh(*meter.component);
+      isChanged = true;
+    }
+  }
+
+  if (isChanged) {
+    numIdleTicks = 0;
+  }
+  else if (numIdleTicks < numTicksToIdle) {
+    ++numIdleTicks;
+  }
+
+  updateTimer();
+}
+
+void
+RepaintScheduler::handleAsyncUpdate()
+{
+  wakeUp();
+}
+
+void
+RepaintScheduler::onInteraction()
+{
+  areParametersChanged = true;
+  if (numIdleTicks >= numTicksToIdle) {
+    wakeUp();
+  }
+}
+
+void
+RepaintScheduler::parameterValueChanged(int, float)
+{
+  // the async update is only needed to leave the idle rate
+  if (!areParametersChanged.exchange(true)) {
+    triggerAsyncUpdate();
+  }
+}
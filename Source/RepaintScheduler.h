@@ -0,0 +1,106 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "PluginProcessor.h"
+#include <JuceHeader.h>
+
+/**
+ * Schedules the repaints of the animated parts of the editor, instead of
+ * letting each of them repaint on its own timer.
+ * Views of the parameters, like the spline editors, are refreshed when a
+ * parameter changes or when the mouse moves over the editor; meters when one
+ * of their values moves by more than a threshold. A single timer, at 60 Hz
+ * like most displays, does the refreshing. It slows down to a poll of the
+ * meters once nothing has changed for a while, and it stops while the editor
+ * is not showing.
+ * A registered component that is a Timer has its own timer stopped, and it
+ * is refreshed by calling its timerCallback.
+ */
+class RepaintScheduler final
+  : private ComponentMovementWatcher
+  , private MouseListener
+  , private Timer
+  , private AsyncUpdater
+  , private AudioProcessorParameter::Listener
+{
+public:
+  RepaintScheduler(OverdrawAudioProcessor& processor, Component& editor);
+  ~RepaintScheduler() override;
+
+  void addParameterView(Component& component);
+
+  void addMeter(Component& component,
+                std::vector<std::atomic<float>*> values,
+                float threshold);
+
+private:
+  struct Meter
+  {
+    Component* component;
+    std::vector<std::atomic<float>*> values;
+    std::vector<float> paintedValues;
+    float threshold;
+  };
+
+  static void refresh(Component& component);
+
+  void wakeUp();
+  void updateTimer();
+
+  void timerCallback() override;
+  void handleAsyncUpdate() override;
+
+  using ComponentMovementWatcher::componentMovedOrResized;
+  using ComponentMovementWatcher::componentVisibilityChanged;
+  void componentMovedOrResized(bool, bool) override {}
+  void componentPeerChanged() override { wakeUp(); }
+  void componentVisibilityChanged() override { wakeUp(); }
+
+  void mouseMove(MouseEvent const&) override { onInteraction(); }
+  void mouseDrag(MouseEvent const&) override { onInteraction(); }
+  void mouseDown(MouseEvent const&) override { onInteraction(); }
+  void mouseUp(MouseEvent const&) override { onInteraction(); }
+  void mouseExit(MouseEvent const&) override { onInteraction(); }
+  void mouseWheelMove(MouseEvent const&, MouseWheelDetails const&) override
+  {
+    onInteraction();
+  }
+
+  void onInteraction();
+
+  // may be called on the audio thread, by automation
+  void parameterValueChanged(int, float) override;
+  void parameterGestureChanged(int, bool) override {}
+
+  OverdrawAudioProcessor& processor;
+  Component& editor;
+
+  std::vector<Component*> parameterViews;
+  std::vector<Meter> meters;
+
+  std::atomic<bool> areParametersChanged{ true };
+  int numIdleTicks = 0;
+
+  static constexpr int activeRate = 60;
+  static constexpr int idleRate = 4;
+  // about half a second at the active rate
+  static constexpr int numTicksToIdle = 30;
+};
@@ -0,0 +1,389 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "SessionCapture.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace overdraw {
+
+bool
+SessionCapture::start(std::string const& path,
+                      double const sampleRate,
+                      int const maxBlockSize,
+                      std::vector<char> const& state,
+                      std::vector<float> const& parameterValues,
+                      int32_t const* settings,
+                      size_t const ringSize)
+{
+  stop();
+
+  file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+
+  auto const write = [&](void const* data, size_t size) {
+    return std::fwrite(data, 1, size, file) == size;
+  };
+
+  auto const blockSize = static_cast<int32_t>(maxBlockSize);
+  auto const numParameters = static_cast<uint32_t>(parameterValues.size());
+  uint32_t const numSettings = SessionFormat::numSettings;
+  auto const stateSize = static_cast<uint32_t>(state.size());
+
+  bool const isHeaderWritten =
+    write(SessionFormat::magic, 8) && write(&sampleRate, sizeof(double)) &&
+    write(&blockSize, sizeof(int32_t)) &&
+    write(&numParameters, sizeof(uint32_t)) &&
+    write(parameterValues.data(), sizeof(float) * numParameters) &&
+    write(&numSettings, sizeof(uint32_t)) &&
+    write(settings, sizeof(int32_t) * numSettings) &&
+    write(&stateSize, sizeof(uint32_t)) && write(state.data(), state.size());
+
+  if (!isHeaderWritten) {
+    std::fclose(file);
+    file = nullptr;
+    return false;
+  }
+
+  ring.assign(std::max(ringSize, size_t{ 1 }), 0);
+  numBytesWritten.store(0, std::memory_order_relaxed);
+  numBytesRead.store(0, std::memory_order_relaxed);
+  isBlockOpen = false;
+  lastParameterValues = parameterValues;
+  std::copy(settings, settings + numSettings, lastSettings);
+  isOverflowed.store(false, std::memory_order_relaxed);
+  isResetPending.store(false, std::memory_order_relaxed);
+  isStopping = false;
+
+  writer = std::thread([this] { writerLoop(); });
+  isRecordingBlocks.store(true, std::memory_order_release);
+  return true;
+}
+
+void
+SessionCapture::stop()
+{
+  isRecordingBlocks.store(false, std::memory_order_release);
+  if (writer.joinable()) {
+    {
+      auto const lock = std::lock_guard<std::mutex>(mutex);
+      isStopping = true;
+    }
+    wakeUp.notify_all();
+    writer.join();
+  }
+  if (file) {
+    std::fclose(file);
+    file = nullptr;
+  }
+}
+
+// the audio thread never wakes the writer, which polls the ring buffer
+void
+SessionCapture::writerLoop()
+{
+  constexpr auto pollInterval = std::chrono::milliseconds(20);
+  for (;;) {
+    bool isLastDrain = false;
+    {
+      auto lock = std::unique_lock<std::mutex>(mutex);
+      wakeUp.wait_for(lock, pollInterval, [&] { return isStopping; });
+      isLastDrain = isStopping;
+    }
+    if (!drain()) {
+      isRecordingBlocks.store(false, std::memory_order_release);
+      return;
+    }
+    if (isLastDrain) {
+      return;
+    }
+  }
+}
+
+bool
+SessionCapture::drain()
+{
+  uint64_t const end = numBytesWritten.load(std::memory_order_acquire);
+  uint64_t begin = numBytesRead.load(std::memory_order_relaxed);
+  if (begin == end) {
+    return true;
+  }
+  while (begin < end) {
+    size_t const position = begin % ring.size();
+    auto const size = static_cast<size_t>(
+      std::min<uint64_t>(end - begin, ring.size() - position));
+    if (std::fwrite(ring.data() + position, 1, size, file) != size) {
+      return false;
+    }
+    begin += size;
+    numBytesRead.store(begin, std::memory_order_release);
+  }
+  return std::fflush(file) == 0;
+}
+
+void
+SessionCapture::push(void const* data, size_t size)
+{
+  auto const* bytes = static_cast<char const*>(data);
+  while (size > 0) {
+    size_t const position = blockEnd % ring.size();
+    size_t const chunk = std::min(size, ring.size() - position);
+    std::memcpy(ring.data() + position, bytes, chunk);
+    bytes += chunk;
+    size -= chunk;
+    blockEnd += chunk;
+  }
+}
+
+template<class Sample>
+void
+SessionCapture::beginBlock(Sample const* const* input,
+                           int const numSamples,
+                           double const load,
+                           float const* parameterValues,
+                           int32_t const* settings)
+{
+  isBlockOpen = false;
+  if (!isRecordingBlocks.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  size_t const numParameters = lastParameterValues.size();
+  uint32_t numChanges = 0;
+  for (size_t i = 0; i < numParameters; ++i) {
+    numChanges += parameterValues[i] != lastParameterValues[i] ? 1 : 0;
+  }
+  uint32_t numSettingChanges = 0;
+  for (uint32_t i = 0; i < SessionFormat::numSettings; ++i) {
+    numSettingChanges += settings[i] != lastSettings[i] ? 1 : 0;
+  }
+
+  size_t const channelBytes = sizeof(Sample) * numSamples;
+  size_t const recordSize =
+    3 * sizeof(uint32_t) + sizeof(uint8_t) + sizeof(double) +
+    numChanges * (sizeof(uint32_t) + sizeof(float)) +
+    numSettingChanges * (sizeof(uint32_t) + sizeof(int32_t)) +
+    2 * SessionFormat::numChannels * channelBytes;
+
+  blockEnd = numBytesWritten.load(std::memory_order_relaxed);
+  uint64_t const numBytesInUse =
+    blockEnd - numBytesRead.load(std::memory_order_acquire);
+  if (numBytesInUse + recordSize > ring.size()) {
+    isOverflowed.store(true, std::memory_order_relaxed);
+    isRecordingBlocks.store(false, std::memory_order_relaxed);
+    return;
+  }
+
+  auto const numSamplesField = static_cast<uint32_t>(numSamples);
+  uint8_t flags = 0;
+  if (sizeof(Sample) == sizeof(double)) {
+    flags |= SessionFormat::isDoublePrecisionFlag;
+  }
+  if (isResetPending.exchange(false, std::memory_order_acquire)) {
+    flags |= SessionFormat::isAfterResetFlag;
+  }
+  push(&numSamplesField, sizeof(uint32_t));
+  push(&flags, sizeof(uint8_t));
+  push(&load, sizeof(double));
+  push(&numChanges, sizeof(uint32_t));
+
+  for (size_t i = 0; i < numParameters; ++i) {
+    if (parameterValues[i] != lastParameterValues[i]) {
+      auto const index = static_cast<uint32_t>(i);
+      push(&index, sizeof(uint32_t));
+      push(&parameterValues[i], sizeof(float));
+      lastParameterValues[i] = parameterValues[i];
+    }
+  }
+
+  push(&numSettingChanges, sizeof(uint32_t));
+  for (uint32_t i = 0; i < SessionFormat::numSettings; ++i) {
+    if (settings[i] != lastSettings[i]) {
+      push(&i, sizeof(uint32_t));
+      push(&settings[i], sizeof(int32_t));
+      lastSettings[i] = settings[i];
+    }
+  }
+
+  for (int c = 0; c < SessionFormat::numChannels; ++c) {
+    push(input[c], channelBytes);
+  }
+  isBlockOpen = true;
+}
+
+template<class Sample>
+void
+SessionCapture::endBlock(Sample const* const* output, int const numSamples)
+{
+  if (!isBlockOpen) {
+    return;
+  }
+  isBlockOpen = false;
+  for (int c = 0; c < SessionFormat::numChannels; ++c) {
+    push(output[c], sizeof(Sample) * numSamples);
+  }
+  numBytesWritten.store(blockEnd, std::memory_order_release);
+}
+
+template void
+SessionCapture::beginBlock(float const* const*,
+                           int,
+                           double,
+                           float const*,
+                           int32_t const*);
+template void
+SessionCapture::beginBlock(double const* const*,
+                           int,
+                           double,
+                           float const*,
+                           int32_t const*);
+template void
+SessionCapture::endBlock(float const* const*, int);
+template void
+SessionCapture::endBlock(double const* const*, int);
+
+SessionReader::~SessionReader()
+{
+  if (file) {
+    std::fclose(file);
+  }
+}
+
+template<class T>
+bool
+SessionReader::read(T& value)
+{
+  return std::fread(&value, sizeof(T), 1, file) == 1;
+}
+
+bool
+SessionReader::open(std::string const& path)
+{
+  if (file) {
+    std::fclose(file);
+  }
+  // more than any version of the plug-in has
+  constexpr uint32_t maxNumParameters = 1u << 16;
+
+  file = std::fopen(path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  char magic[8];
+  int32_t blockSize = 0;
+  uint32_t numSettings = 0;
+  uint32_t stateSize = 0;
+  if (std::fread(magic, 1, 8, file) != 8 ||
+      std::memcmp(magic, SessionFormat::magic, 8) != 0 || !read(sampleRate) ||
+      !read(blockSize) || !read(numParameters) || sampleRate <= 0.0 ||
+      blockSize <= 0 || numParameters > maxNumParameters) {
+    return false;
+  }
+  parameterValues.resize(numParameters);
+  if (std::fread(parameterValues.data(), sizeof(float), numParameters, file) !=
+        numParameters ||
+      !read(numSettings) || numSettings != SessionFormat::numSettings ||
+      std::fread(settings, sizeof(int32_t), numSettings, file) !=
+        numSettings ||
+      !read(stateSize)) {
+    return false;
+  }
+  maxBlockSize = blockSize;
+  state.resize(stateSize);
+  return std::fread(state.data(), 1, stateSize, file) == stateSize;
+}
+
+bool
+SessionReader::readSamples(std::vector<double>& samples,
+                           int const numSamples,
+                           bool const isDoublePrecision)
+{
+  auto const count = static_cast<size_t>(numSamples);
+  samples.resize(count);
+  if (isDoublePrecision) {
+    return std::fread(samples.data(), sizeof(double), count, file) == count;
+  }
+  singlePrecision.resize(count);
+  if (std::fread(singlePrecision.data(), sizeof(float), count, file) !=
+      count) {
+    return false;
+  }
+  std::copy(singlePrecision.begin(), singlePrecision.end(), samples.begin());
+  return true;
+}
+
+bool
+SessionReader::readBlock(Block& block)
+{
+  // blocks longer than this are not from a host
+  constexpr uint32_t maxNumSamples = 1u << 24;
+
+  uint32_t numSamples = 0;
+  uint8_t flags = 0;
+  uint32_t numChanges = 0;
+  uint32_t numSettingChanges = 0;
+  if (!file) {
+    return false;
+  }
+  size_t const numSizeBytes =
+    std::fread(&numSamples, 1, sizeof(uint32_t), file);
+  isAtEndOfFile = numSizeBytes == 0 && std::feof(file);
+  if (numSizeBytes != sizeof(uint32_t) || !read(flags) ||
+      !read(block.load) || !read(numChanges) || numSamples > maxNumSamples ||
+      numChanges > numParameters) {
+    return false;
+  }
+  block.numSamples = static_cast<int>(numSamples);
+  block.isDoublePrecision = (flags & SessionFormat::isDoublePrecisionFlag) != 0;
+  block.isAfterReset = (flags & SessionFormat::isAfterResetFlag) != 0;
+
+  block.parameterChanges.resize(numChanges);
+  for (auto& change : block.parameterChanges) {
+    if (!read(change.first) || !read(change.second) ||
+        change.first >= numParameters) {
+      return false;
+    }
+  }
+
+  if (!read(numSettingChanges) ||
+      numSettingChanges > SessionFormat::numSettings) {
+    return false;
+  }
+  block.settingChanges.resize(numSettingChanges);
+  for (auto& change : block.settingChanges) {
+    if (!read(change.first) || !read(change.second) ||
+        change.first >= SessionFormat::numSettings) {
+      return false;
+    }
+  }
+
+  for (auto* channels : { &block.input, &block.output }) {
+    for (auto& samples : *channels) {
+      if (!readSamples(samples, block.numSamples, block.isDoublePrecision)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace overdraw
@@ -0,0 +1,257 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace overdraw {
+
+/**
+ * A capture file, in native byte order, holds a header:
+ *   char[8]  "OVDRSES2"
+ *   double   sample rate
+ *   int32    maximum block size given to prepareToPlay
+ *   uint32   number of parameters, followed by their normalized values as
+ *            floats
+ *   uint32   number of settings, followed by their values as int32, see
+ *            SessionFormat::Setting
+ *   uint32   size of the plug-in state, followed by the state
+ * then a record for each block given to processBlock:
+ *   uint32   number of samples
+ *   uint8    flags: isDoublePrecisionFlag if the samples are double, and
+ *            isAfterResetFlag if reset() was called before the block
+ *   double   load seen by adaptive oversampling, see LoadMonitor
+ *   uint32   number of parameters changed since the previous block, followed
+ *            by that many pairs of uint32 index and float normalized value
+ *   uint32   number of settings changed since the previous block, followed by
+ *            that many pairs of uint32 setting and int32 value
+ *   the input, then the output, channel after channel, as float or double
+ */
+struct SessionFormat final
+{
+  static constexpr char magic[9] = "OVDRSES2";
+  static constexpr int numChannels = 2;
+  static constexpr uint8_t isDoublePrecisionFlag = 1;
+  static constexpr uint8_t isAfterResetFlag = 2;
+
+  // The settings of the processor that are stored in the plug-in state but
+  // are not parameters, which can change while playing.
+  enum Setting : uint32_t
+  {
+    // a bit for each oversampling order that runs the partitioned FFT engine
+    linearPhaseFftOrders,
+    offlineMultithreading,
+    adaptiveOversampling,
+    adaptiveMinOrder,
+    adaptiveMaxOrder,
+    controlRateAutomation,
+    affineShortcut,
+    numSettings
+  };
+};
+
+/**
+ * Records the blocks that reach processBlock, for a deterministic replay
+ * through a fresh processor, see Tools/Replay.cpp.
+ * The audio thread writes each block in a single-producer ring buffer, and a
+ * thread of the capture writes the ring buffer to the file. Recording takes
+ * no locks and never allocates: if the file can't keep up and the ring buffer
+ * is full, the capture stops at the last complete block.
+ */
+class SessionCapture final
+{
+public:
+  static constexpr size_t defaultRingSize = size_t{ 16 } << 20;
+
+  SessionCapture() = default;
+  ~SessionCapture() { stop(); }
+
+  SessionCapture(SessionCapture const&) = delete;
+  SessionCapture& operator=(SessionCapture const&) = delete;
+
+  /**
+   * Creates the file and writes the header. Not while processing.
+   * @param state the plug-in state the replay starts from
+   * @param parameterValues the normalized values of all the parameters,
+   * which the state holds, to record only their changes
+   * @param settings the values of all the settings, see
+   * SessionFormat::Setting, which the state also holds
+   * @return false if the file could not be written
+   */
+  bool start(std::string const& path,
+             double sampleRate,
+             int maxBlockSize,
+             std::vector<char> const& state,
+             std::vector<float> const& parameterValues,
+             int32_t const* settings,
+             size_t ringSize = defaultRingSize);
+
+  /**
+   * Writes what is left in the ring buffer and closes the file. Not while
+   * processing.
+   */
+  void stop();
+
+  bool isRecording() const
+  {
+    return isRecordingBlocks.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @return true if the capture stopped because the ring buffer was full
+   */
+  bool hasOverflowed() const
+  {
+    return isOverflowed.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Marks the next block as following a call to reset(). Not while
+   * processing.
+   */
+  void markReset() { isResetPending.store(true, std::memory_order_release); }
+
+  /**
+   * Audio thread only. Records the input of a block, before processing it.
+   * For float and double samples.
+   * @param parameterValues the normalized values of all the parameters
+   * @param settings the values of all the settings, see
+   * SessionFormat::Setting
+   */
+  template<class Sample>
+  void beginBlock(Sample const* const* input,
+                  int numSamples,
+                  double load,
+                  float const* parameterValues,
+                  int32_t const* settings);
+
+  /**
+   * Audio thread only. Records the output of the block given to beginBlock,
+   * and hands the block to the file.
+   */
+  template<class Sample>
+  void endBlock(Sample const* const* output, int numSamples);
+
+private:
+  void push(void const* data, size_t size);
+  void writerLoop();
+  bool drain();
+
+  std::FILE* file = nullptr;
+  std::thread writer;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  bool isStopping = false;
+
+  std::vector<char> ring;
+  // the bytes ever written and read, the ring positions modulo its size
+  std::atomic<uint64_t> numBytesWritten{ 0 };
+  std::atomic<uint64_t> numBytesRead{ 0 };
+  // the end of the block being recorded, published by endBlock
+  uint64_t blockEnd = 0;
+  bool isBlockOpen = false;
+
+  std::vector<float> lastParameterValues;
+  int32_t lastSettings[SessionFormat::numSettings] = {};
+  std::atomic<bool> isRecordingBlocks{ false };
+  std::atomic<bool> isOverflowed{ false };
+  std::atomic<bool> isResetPending{ false };
+};
+
+/**
+ * Reads a capture file, one block at a time.
+ */
+class SessionReader final
+{
+public:
+  struct Block final
+  {
+    int numSamples = 0;
+    bool isDoublePrecision = true;
+    bool isAfterReset = false;
+    double load = 0.0;
+    std::vector<std::pair<uint32_t, float>> parameterChanges;
+    std::vector<std::pair<uint32_t, int32_t>> settingChanges;
+    // as double, which holds single precision samples exactly
+    std::vector<double> input[SessionFormat::numChannels];
+    std::vector<double> output[SessionFormat::numChannels];
+  };
+
+  SessionReader() = default;
+  ~SessionReader();
+
+  SessionReader(SessionReader const&) = delete;
+  SessionReader& operator=(SessionReader const&) = delete;
+
+  /**
+   * Opens the file and reads the header.
+   * @return false if it is not a capture file
+   */
+  bool open(std::string const& path);
+
+  double getSampleRate() const { return sampleRate; }
+  int getMaxBlockSize() const { return maxBlockSize; }
+  uint32_t getNumParameters() const { return numParameters; }
+  std::vector<float> const& getParameterValues() const
+  {
+    return parameterValues;
+  }
+  int32_t const* getSettings() const { return settings; }
+  std::vector<char> const& getState() const { return state; }
+
+  /**
+   * @return false at the end of the file, or at a truncated block
+   */
+  bool readBlock(Block& block);
+
+  /**
+   * @return true if the last readBlock found the end of the file, rather
+   * than a truncated block
+   */
+  bool isAtEnd() const { return isAtEndOfFile; }
+
+private:
+  template<class T>
+  bool read(T& value);
+
+  bool readSamples(std::vector<double>& samples,
+                   int numSamples,
+                   bool isDoublePrecision);
+
+  std::FILE* file = nullptr;
+  bool isAtEndOfFile = false;
+  double sampleRate = 0.0;
+  int maxBlockSize = 0;
+  uint32_t numParameters = 0;
+  std::vector<float> parameterValues;
+  int32_t settings[SessionFormat::numSettings] = {};
+  std::vector<char> state;
+  std::vector<float> singlePrecision;
+};
+
+} // namespace overdraw
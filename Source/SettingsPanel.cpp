@@ -0,0 +1,198 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "SettingsPanel.h"
+
+namespace {
+constexpr int kFirItem = 1;
+constexpr int kFftItem = 2;
+} // namespace
+
+SettingsPanel::SettingsPanel(OverdrawAudioProcessor& processor)
+  : processor(processor)
+{
+  using LinearPhaseEngine = OverdrawAudioProcessor::LinearPhaseEngine;
+
+  addAndMakeVisible(linearPhaseEngineLabel);
+  for (int i = 0; i < numOversamplingOrders - 1; ++i) {
+    int const order = i + 1;
+    auto& label = orderLabels[i];
+    label.setText(String(1 << order) + "x", dontSendNotification);
+    label.setJustificationType(Justification::centred);
+    addAndMakeVisible(label);
+
+    auto& engine = linearPhaseEngines[i];
+    engine.addItem("FIR", kFirItem);
+    engine.addItem("FFT", kFftItem);
+    engine.onChange = [this, order, &engine] {
+      processor.setLinearPhaseEngine(order,
+                                     engine.getSelectedId() == kFftItem
+                                       ? LinearPhaseEngine::partitionedFft
+                                       : LinearPhaseEngine::directFir);
+    };
+    addAndMakeVisible(engine);
+  }
+
+  addAndMakeVisible(offlineMultithreading);
+  offlineMultithreading.onClick = [this] {
+    processor.setOfflineMultithreading(offlineMultithreading.getToggleState());
+  };
+
+  // the items of the orders are numbered from 1, as ComboBox needs
+  for (auto* comboBox : { &adaptiveMinOrder, &adaptiveMaxOrder }) {
+    for (int order = 0; order < numOversamplingOrders; ++order) {
+      comboBox->addItem(String(1 << order) + "x", order + 1);
+    }
+    comboBox->onChange = [this] { setAdaptiveOversampling(); };
+    addAndMakeVisible(*comboBox);
+  }
+  adaptiveOversampling.onClick = [this] { setAdaptiveOversampling(); };
+  addAndMakeVisible(adaptiveOversampling);
+  addAndMakeVisible(adaptiveMinOrderLabel);
+  addAndMakeVisible(adaptiveMaxOrderLabel);
+  adaptiveMaxOrderLabel.setJustificationType(Justification::centred);
+
+  addAndMakeVisible(controlRateAutomation);
+  controlRateAutomation.onClick = [this] {
+    processor.setControlRateAutomation(controlRateAutomation.getToggleState());
+  };
+
+  addAndMakeVisible(affineShortcut);
+  affineShortcut.onClick = [this] {
+    processor.setAffineShortcut(affineShortcut.getToggleState());
+  };
+  addAndMakeVisible(affineShortcutNote);
+  affineShortcutNote.setJustificationType(Justification::topLeft);
+  affineShortcutNote.setColour(Label::textColourId,
+                               Colours::white.withAlpha(0.6f));
+
+  refresh();
+}
+
+int
+SettingsPanel::getIdealHeight(int const rowHeight)
+{
+  return numRows * rowHeight + 8;
+}
+
+// the processor keeps the maximum order above the minimum one, the controls
+// show what it kept
+void
+SettingsPanel::setAdaptiveOversampling()
+{
+  processor.setAdaptiveOversampling(adaptiveOversampling.getToggleState(),
+                                    adaptiveMinOrder.getSelectedId() - 1,
+                                    adaptiveMaxOrder.getSelectedId() - 1);
+  refresh();
+}
+
+void
+SettingsPanel::visibilityChanged()
+{
+  if (isVisible()) {
+    refresh();
+    startTimerHz(4);
+  }
+  else {
+    stopTimer();
+  }
+}
+
+void
+SettingsPanel::timerCallback()
+{
+  refresh();
+}
+
+void
+SettingsPanel::refresh()
+{
+  using LinearPhaseEngine = OverdrawAudioProcessor::LinearPhaseEngine;
+
+  for (int i = 0; i < numOversamplingOrders - 1; ++i) {
+    bool const isFft = processor.getLinearPhaseEngine(i + 1) ==
+                       LinearPhaseEngine::partitionedFft;
+    linearPhaseEngines[i].setSelectedId(isFft ? kFftItem : kFirItem,
+                                        dontSendNotification);
+  }
+  offlineMultithreading.setToggleState(
+    processor.isOfflineMultithreadingEnabled(), dontSendNotification);
+  adaptiveOversampling.setToggleState(
+    processor.isAdaptiveOversamplingEnabled(), dontSendNotification);
+  adaptiveMinOrder.setSelectedId(
+    processor.getAdaptiveOversamplingMinOrder() + 1, dontSendNotification);
+  adaptiveMaxOrder.setSelectedId(
+    processor.getAdaptiveOversamplingMaxOrder() + 1, dontSendNotification);
+  controlRateAutomation.setToggleState(
+    processor.isControlRateAutomationEnabled(), dontSendNotification);
+  affineShortcut.setToggleState(processor.isAffineShortcutEnabled(),
+                                dontSendNotification);
+}
+
+void
+SettingsPanel::paint(Graphics& g)
+{
+  auto const bounds = getLocalBounds();
+  g.setColour(backgroundColour);
+  g.fillRect(bounds);
+  g.setColour(lineColour);
+  g.drawRect(bounds, 1);
+}
+
+void
+SettingsPanel::resized()
+{
+  auto bounds = getLocalBounds().reduced(6, 4);
+  int const rowHeight = bounds.getHeight() / numRows;
+  auto const font = Font(rowHeight * 0.55f);
+
+  linearPhaseEngineLabel.setFont(font);
+  linearPhaseEngineLabel.setBounds(bounds.removeFromTop(rowHeight));
+
+  auto labelRow = bounds.removeFromTop(rowHeight);
+  auto engineRow = bounds.removeFromTop(rowHeight);
+  int const columnWidth = labelRow.getWidth() / (numOversamplingOrders - 1);
+  for (int i = 0; i < numOversamplingOrders - 1; ++i) {
+    orderLabels[i].setFont(font);
+    orderLabels[i].setBounds(labelRow.removeFromLeft(columnWidth));
+    linearPhaseEngines[i].setBounds(
+      engineRow.removeFromLeft(columnWidth).reduced(2));
+  }
+
+  offlineMultithreading.setBounds(bounds.removeFromTop(rowHeight));
+
+  adaptiveOversampling.setBounds(bounds.removeFromTop(rowHeight));
+  auto rangeRow = bounds.removeFromTop(rowHeight);
+  int const rangeColumnWidth = rangeRow.getWidth() / 4;
+  adaptiveMinOrderLabel.setFont(font);
+  adaptiveMinOrderLabel.setBounds(rangeRow.removeFromLeft(rangeColumnWidth));
+  adaptiveMinOrder.setBounds(
+    rangeRow.removeFromLeft(rangeColumnWidth).reduced(2));
+  adaptiveMaxOrderLabel.setFont(font);
+  adaptiveMaxOrderLabel.setBounds(rangeRow.removeFromLeft(rangeColumnWidth));
+  adaptiveMaxOrder.setBounds(
+    rangeRow.removeFromLeft(rangeColumnWidth).reduced(2));
+
+  controlRateAutomation.setBounds(bounds.removeFromTop(rowHeight));
+
+  affineShortcut.setBounds(bounds.removeFromTop(rowHeight));
+  affineShortcutNote.setFont(font);
+  affineShortcutNote.setBounds(
+    bounds.removeFromTop(numAffineShortcutNoteRows * rowHeight));
+}
@@ -0,0 +1,88 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "PluginProcessor.h"
+#include <JuceHeader.h>
+
+/**
+ * The settings of the processor that are stored in the plug-in state but are
+ * not parameters: the engine of linear-phase oversampling at each order,
+ * offline multithreading, adaptive oversampling with its range of orders,
+ * control-rate automation and the affine shortcut.
+ * The controls follow the processor while the panel is showing, so that they
+ * stay in step with the states the host loads.
+ */
+class SettingsPanel final
+  : public Component
+  , private Timer
+{
+public:
+  explicit SettingsPanel(OverdrawAudioProcessor& processor);
+
+  void paint(Graphics& g) override;
+  void resized() override;
+  void visibilityChanged() override;
+
+  // the height that fits all the controls, at the given height of a row
+  static int getIdealHeight(int rowHeight);
+
+  Colour lineColour = Colours::white;
+  Colour backgroundColour = Colours::black.withAlpha(0.8f);
+
+private:
+  void timerCallback() override;
+
+  // reads the settings from the processor
+  void refresh();
+
+  void setAdaptiveOversampling();
+
+  static constexpr int numOversamplingOrders =
+    OverdrawAudioProcessor::numOversamplingOrders;
+  static constexpr int numRows = 11;
+  static constexpr int numAffineShortcutNoteRows = 3;
+
+  OverdrawAudioProcessor& processor;
+
+  // from 2x up, 1x does not resample
+  Label linearPhaseEngineLabel{ {}, "Linear-Phase Engine" };
+  std::array<Label, numOversamplingOrders - 1> orderLabels;
+  std::array<ComboBox, numOversamplingOrders - 1> linearPhaseEngines;
+
+  ToggleButton offlineMultithreading{ "Multithreading When Rendering" };
+
+  ToggleButton adaptiveOversampling{ "Adaptive Oversampling" };
+  Label adaptiveMinOrderLabel{ {}, "From" };
+  ComboBox adaptiveMinOrder;
+  Label adaptiveMaxOrderLabel{ {}, "to" };
+  ComboBox adaptiveMaxOrder;
+
+  ToggleButton controlRateAutomation{ "Control-Rate Knot Smoothing" };
+
+  // the shortcut treats the linear-phase resampling as a pure delay, see
+  // overdraw::Engine
+  ToggleButton affineShortcut{ "Affine Shortcut" };
+  Label affineShortcutNote{
+    {},
+    "Skips the oversampling where the curves are straight. Near the Nyquist "
+    "frequency of the host, the output differs from the oversampled one."
+  };
+};
@@ -0,0 +1,149 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "Svf.h"
+#include <algorithm>
+#include <cmath>
+
+namespace overdraw {
+
+void
+Svf::setTarget(Type newType,
+               double const* frequency,
+               double const* q,
+               double const* gain,
+               double sampleRate)
+{
+  constexpr double pi = 3.14159265358979323846;
+
+  double g[2], k[2], m0[2], m1[2], m2[2];
+
+  for (int c = 0; c < 2; ++c) {
+    double const cutoff = std::min(frequency[c], 0.49 * sampleRate);
+    double const w = std::tan(pi * cutoff / sampleRate);
+    double const a = std::pow(10.0, gain[c] / 40.0);
+    double const invQ = 1.0 / std::max(q[c], 0.01);
+    switch (newType) {
+      case Type::highPass:
+        g[c] = w;
+        k[c] = invQ;
+        m0[c] = 1.0;
+        m1[c] = -invQ;
+        m2[c] = -1.0;
+        break;
+      case Type::lowPass:
+        g[c] = w;
+        k[c] = invQ;
+        m0[c] = 0.0;
+        m1[c] = 0.0;
+        m2[c] = 1.0;
+        break;
+      case Type::lowShelf:
+        g[c] = w / std::sqrt(a);
+        k[c] = invQ;
+        m0[c] = 1.0;
+        m1[c] = invQ * (a - 1.0);
+        m2[c] = a * a - 1.0;
+        break;
+      case Type::highShelf:
+        g[c] = w * std::sqrt(a);
+        k[c] = invQ;
+        m0[c] = a * a;
+        m1[c] = invQ * (1.0 - a) * a;
+        m2[c] = 1.0 - a * a;
+        break;
+      case Type::peak:
+        g[c] = w;
+        k[c] = invQ / a;
+        m0[c] = 1.0;
+        m1[c] = invQ / a * (a * a - 1.0);
+        m2[c] = 0.0;
+        break;
+      case Type::off:
+      default:
+        g[c] = w;
+        k[c] = invQ;
+        m0[c] = 1.0;
+        m1[c] = 0.0;
+        m2[c] = 0.0;
+        break;
+    }
+  }
+
+  target.g = Vec2d().load(g);
+  target.k = Vec2d().load(k);
+  target.m0 = Vec2d().load(m0);
+  target.m1 = Vec2d().load(m1);
+  target.m2 = Vec2d().load(m2);
+
+  bool const isSwitchingOn = type == Type::off && newType != Type::off;
+  type = newType;
+  if (isSwitchingOn) {
+    reset();
+  }
+}
+
+void
+Svf::process(VecBuffer<Vec2d>& io, double const alpha)
+{
+  if (type == Type::off) {
+    return;
+  }
+
+  int const numSamples = io.getNumSamples();
+  Vec2d const a = alpha;
+  Coefficients c = coefficients;
+  Vec2d s1 = ic1eq;
+  Vec2d s2 = ic2eq;
+
+  for (int i = 0; i < numSamples; ++i) {
+    c.g = a * (c.g - target.g) + target.g;
+    c.k = a * (c.k - target.k) + target.k;
+    c.m0 = a * (c.m0 - target.m0) + target.m0;
+    c.m1 = a * (c.m1 - target.m1) + target.m1;
+    c.m2 = a * (c.m2 - target.m2) + target.m2;
+
+    Vec2d const a1 = 1.0 / (1.0 + c.g * (c.g + c.k));
+    Vec2d const a2 = c.g * a1;
+    Vec2d const a3 = c.g * a2;
+
+    Vec2d const v0 = io[i];
+    Vec2d const v3 = v0 - s2;
+    Vec2d const v1 = a1 * s1 + a2 * v3;
+    Vec2d const v2 = s2 + a2 * s1 + a3 * v3;
+    s1 = 2.0 * v1 - s1;
+    s2 = 2.0 * v2 - s2;
+
+    io[i] = c.m0 * v0 + c.m1 * v1 + c.m2 * v2;
+  }
+
+  coefficients = c;
+  ic1eq = s1;
+  ic2eq = s2;
+}
+
+void
+Svf::reset()
+{
+  coefficients = target;
+  ic1eq = 0.0;
+  ic2eq = 0.0;
+}
+
+} // namespace overdraw
@@ -0,0 +1,88 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "avec/Avec.hpp"
+
+namespace overdraw {
+
+/**
+ * A stereo state variable filter in the topology-preserving form by Andrew
+ * Simper, used as pre and post emphasis around the waveshaper, in the
+ * oversampled domain. The coefficients are smoothed sample by sample toward
+ * the targets, which this topology tolerates without artifacts, so the costly
+ * tan and pow are only computed once per block in setTarget.
+ */
+class Svf final
+{
+public:
+  enum class Type
+  {
+    off,
+    highPass,
+    lowPass,
+    lowShelf,
+    highShelf,
+    peak
+  };
+
+  Svf() { AVEC_ASSERT_ALIGNMENT(this, Vec2d); }
+
+  /**
+   * Sets the coefficients to smooth toward. A filter that is switched on
+   * starts from them, with cleared state.
+   * @param frequency the cutoff or center frequency of each channel, in Hz
+   * @param q the quality factor of each channel
+   * @param gain the shelf or peak gain of each channel, in dB
+   * @param sampleRate the rate at which the filter runs
+   */
+  void setTarget(Type type,
+                 double const* frequency,
+                 double const* q,
+                 double const* gain,
+                 double sampleRate);
+
+  bool isActive() const { return type != Type::off; }
+
+  void process(VecBuffer<Vec2d>& io, double const alpha);
+
+  /**
+   * Clears the state and jumps to the target coefficients.
+   */
+  void reset();
+
+private:
+  struct Coefficients final
+  {
+    Vec2d g = 0.0;
+    Vec2d k = 1.0;
+    Vec2d m0 = 1.0;
+    Vec2d m1 = 0.0;
+    Vec2d m2 = 0.0;
+  };
+
+  Coefficients coefficients;
+  Coefficients target;
+  Vec2d ic1eq = 0.0;
+  Vec2d ic2eq = 0.0;
+  Type type = Type::off;
+};
+
+} // namespace overdraw
@@ -0,0 +1,189 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace overdraw {
+
+WorkerPool::WorkerPool(int numWorkers)
+{
+  numWorkers = std::max(1, numWorkers);
+  queues.reserve(numWorkers);
+  for (int i = 0; i < numWorkers; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  workers.reserve(numWorkers);
+  for (int i = 0; i < numWorkers; ++i) {
+    workers.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    auto const lock = std::lock_guard<std::mutex>(sleepMutex);
+    isQuitting = true;
+  }
+  wakeUp.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+std::shared_ptr<WorkerPool>
+WorkerPool::getShared()
+{
+  static std::mutex mutex;
+  static std::weak_ptr<WorkerPool> shared;
+
+  auto const lock = std::lock_guard<std::mutex>(mutex);
+  auto pool = shared.lock();
+  if (!pool) {
+    int const numHardwareThreads =
+      static_cast<int>(std::thread::hardware_concurrency());
+    pool = std::make_shared<WorkerPool>(std::max(1, numHardwareThreads - 1));
+    shared = pool;
+  }
+  return pool;
+}
+
+void
+WorkerPool::push(Task task)
+{
+  task.group->numPending.fetch_add(1, std::memory_order_relaxed);
+
+  auto const queueIndex =
+    nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+  {
+    auto& queue = *queues[queueIndex];
+    auto const lock = std::lock_guard<std::mutex>(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  {
+    auto const lock = std::lock_guard<std::mutex>(sleepMutex);
+    numQueued.fetch_add(1, std::memory_order_release);
+  }
+  wakeUp.notify_one();
+}
+
+bool
+WorkerPool::tryPop(int queueIndex, Task& task)
+{
+  auto& queue = *queues[queueIndex];
+  auto const lock = std::lock_guard<std::mutex>(queue.mutex);
+  if (queue.tasks.empty()) {
+    return false;
+  }
+  task = queue.tasks.front();
+  queue.tasks.pop_front();
+  return true;
+}
+
+bool
+WorkerPool::trySteal(int thiefIndex, Task& task)
+{
+  int const numQueues = static_cast<int>(queues.size());
+  for (int i = 1; i <= numQueues; ++i) {
+    auto& queue = *queues[(thiefIndex + i) % numQueues];
+    auto const lock = std::lock_guard<std::mutex>(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+WorkerPool::tryRunOne(int queueIndex)
+{
+  Task task;
+  if (tryPop(queueIndex, task) || trySteal(queueIndex, task)) {
+    numQueued.fetch_sub(1, std::memory_order_relaxed);
+    run(task);
+    return true;
+  }
+  return false;
+}
+
+void
+WorkerPool::run(Task const& task)
+{
+  task.function(task.context);
+  // a waiter may return, and destroy the group, as soon as the count is zero,
+  // so the last task wakes it through the pool only
+  if (task.group->numPending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    auto const lock = std::lock_guard<std::mutex>(groupMutex);
+    groupCompleted.notify_all();
+  }
+}
+
+void
+WorkerPool::wait(TaskGroup& group)
+{
+  // a waiting thread has no queue of its own, any one is a starting point
+  int const queueIndex = static_cast<int>(
+    nextQueue.load(std::memory_order_relaxed) % queues.size());
+  int numFailedAttempts = 0;
+  for (;;) {
+    int const numPending = group.numPending.load(std::memory_order_acquire);
+    if (numPending == 0) {
+      return;
+    }
+    if (tryRunOne(queueIndex)) {
+      numFailedAttempts = 0;
+      continue;
+    }
+    // nothing left to run here: the last tasks of the group are on other
+    // threads. Spin a little, as they are usually about to complete, then
+    // block until the last one wakes us up.
+    if (++numFailedAttempts < maxNumSpins) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (numQueued.load(std::memory_order_acquire) == 0) {
+      auto lock = std::unique_lock<std::mutex>(groupMutex);
+      groupCompleted.wait(lock, [&] {
+        return group.numPending.load(std::memory_order_acquire) == 0;
+      });
+    }
+    numFailedAttempts = 0;
+  }
+}
+
+void
+WorkerPool::workerLoop(int workerIndex)
+{
+  for (;;) {
+    if (tryRunOne(workerIndex)) {
+      continue;
+    }
+    auto lock = std::unique_lock<std::mutex>(sleepMutex);
+    wakeUp.wait(lock, [&] {
+      return isQuitting || numQueued.load(std::memory_order_acquire) > 0;
+    });
+    if (isQuitting) {
+      return;
+    }
+  }
+}
+
+} // namespace overdraw
@@ -0,0 +1,125 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace overdraw {
+
+/**
+ * Counts the tasks of a WorkerPool that have not completed yet. The pool
+ * stops using it when its count reaches zero, so it may be destroyed as soon
+ * as WorkerPool::wait returns.
+ */
+struct TaskGroup final
+{
+  std::atomic<int> numPending{ 0 };
+};
+
+/**
+ * A small work-stealing thread pool, for offline rendering only: it takes
+ * locks and it may wake threads, so it must never be used from a real-time
+ * callback. Each worker pops from the front of its own queue and steals from
+ * the back of the others. A thread waiting on a TaskGroup runs queued tasks
+ * too, so nested or concurrent waits from many plug-in instances cannot
+ * starve the pool.
+ */
+class WorkerPool final
+{
+public:
+  explicit WorkerPool(int numWorkers);
+  ~WorkerPool();
+
+  WorkerPool(WorkerPool const&) = delete;
+  WorkerPool& operator=(WorkerPool const&) = delete;
+
+  /**
+   * @return the pool shared by all the instances in the process, with one
+   * worker less than the hardware threads. It lives as long as someone holds
+   * it.
+   */
+  static std::shared_ptr<WorkerPool> getShared();
+
+  int getNumWorkers() const { return static_cast<int>(workers.size()); }
+
+  /**
+   * Queues a task. The callable is referenced, not copied: it must stay alive
+   * until wait(group) returns.
+   */
+  template<class Function>
+  void submit(TaskGroup& group, Function& function)
+  {
+    push({ [](void* context) { (*static_cast<Function*>(context))(); },
+           const_cast<void*>(static_cast<void const*>(&function)),
+           &group });
+  }
+
+  /**
+   * Runs queued tasks until all the tasks of the group have completed. When
+   * none is left to run, it spins for a bounded number of attempts and then
+   * blocks until the last task of the group completes.
+   */
+  void wait(TaskGroup& group);
+
+private:
+  struct Task final
+  {
+    void (*function)(void*);
+    void* context;
+    TaskGroup* group;
+  };
+
+  struct Queue final
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void push(Task task);
+  bool tryPop(int queueIndex, Task& task);
+  bool trySteal(int thiefIndex, Task& task);
+  bool tryRunOne(int queueIndex);
+  void run(Task const& task);
+  void workerLoop(int workerIndex);
+
+  static constexpr int maxNumSpins = 64;
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  std::atomic<unsigned> nextQueue{ 0 };
+  std::atomic<int> numQueued{ 0 };
+
+  std::mutex sleepMutex;
+  std::condition_variable wakeUp;
+  bool isQuitting = false;
+
+  // the blocked waiters, woken when the last task of a group completes
+  std::mutex groupMutex;
+  std::condition_variable groupCompleted;
+};
+
+} // namespace overdraw
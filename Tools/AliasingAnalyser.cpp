@@ -0,0 +1,433 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Headless analysis of the aliasing, the distortion and the CPU cost of every
+// oversampling setting, for a given preset.
+//
+// Each setting processes sines through the whole plug-in. The frequency of
+// each sine is an odd FFT bin, so the signal is periodic in the analysis
+// frame and every product of the nonlinearity lands exactly on a bin: the
+// harmonic h either stays at bin h * k, when it is below Nyquist, or folds
+// back to a bin of its own. The power of the former is the THD, the power of
+// the latter is the aliasing, both relative to the fundamental.
+// The cheapest setting, by CPU time, whose worst aliasing over all the test
+// frequencies is below the floor is reported at the end.
+
+#include "PluginProcessor.h"
+#include "pffft_double/pffft_double.h"
+#include <JuceHeader.h>
+
+#include <chrono>
+#include <cstdio>
+#include <optional>
+
+namespace {
+
+constexpr int fftSize = 1 << 16;
+constexpr int maxHarmonic = 1000;
+
+struct Options final
+{
+  String presetPath;
+  double sampleRate = 48000.0;
+  int blockSize = 512;
+  double levelDb = -6.0;
+  double floorDb = -90.0;
+  double cpuSeconds = 5.0;
+  Array<double> frequencies{ 100.0, 1000.0, 3000.0, 6000.0, 10000.0, 15000.0,
+                             20000.0 };
+};
+
+struct Setting final
+{
+  int order;
+  bool isLinearPhase;
+  OverdrawAudioProcessor::LinearPhaseEngine engine;
+
+  String getName() const
+  {
+    using Engine = OverdrawAudioProcessor::LinearPhaseEngine;
+    String name = String(1 << order) + "x ";
+    if (!isLinearPhase) {
+      return name + "minimum phase";
+    }
+    return name + (engine == Engine::directFir ? "linear phase, FIR"
+                                               : "linear phase, FFT");
+  }
+};
+
+struct Measurement final
+{
+  Setting setting;
+  double worstAliasingDb = 0.0;
+  double worstThdDb = 0.0;
+  double nsPerSample = 0.0;
+};
+
+void
+printUsage()
+{
+  std::printf(
+    "usage: OverdrawAliasingAnalyser [options]\n"
+    "  --preset <file>        plug-in state, binary or xml (default: init)\n"
+    "  --floor <dB>           aliasing floor, relative to the fundamental "
+    "(default: -90)\n"
+    "  --level <dBFS>         level of the test sines (default: -6)\n"
+    "  --frequencies <list>   comma separated, in Hz (default: 100,1000,3000,"
+    "6000,10000,15000,20000)\n"
+    "  --sample-rate <Hz>     (default: 48000)\n"
+    "  --block-size <n>       (default: 512)\n"
+    "  --cpu-seconds <s>      audio processed to measure the cpu cost "
+    "(default: 5)\n");
+}
+
+std::optional<Options>
+parseOptions(StringArray const& args)
+{
+  Options options;
+  for (int i = 0; i < args.size(); ++i) {
+    auto const& arg = args[i];
+    bool const hasValue = i + 1 < args.size();
+    if (arg == "--help" || arg == "-h") {
+      return std::nullopt;
+    }
+    if (!hasValue) {
+      std::fprintf(stderr, "missing value for %s\n", arg.toRawUTF8());
+      return std::nullopt;
+    }
+    auto const& value = args[++i];
+    if (arg == "--preset") {
+      options.presetPath = value;
+    }
+    else if (arg == "--floor") {
+      options.floorDb = value.getDoubleValue();
+    }
+    else if (arg == "--level") {
+      options.levelDb = value.getDoubleValue();
+    }
+    else if (arg == "--sample-rate") {
+      options.sampleRate = value.getDoubleValue();
+    }
+    else if (arg == "--block-size") {
+      options.blockSize = jmax(1, value.getIntValue());
+    }
+    else if (arg == "--cpu-seconds") {
+      options.cpuSeconds = value.getDoubleValue();
+    }
+    else if (arg == "--frequencies") {
+      options.frequencies.clear();
+      for (auto const& f : StringArray::fromTokens(value, ",", {})) {
+        options.frequencies.add(f.getDoubleValue());
+      }
+    }
+    else {
+      std::fprintf(stderr, "unknown option %s\n", arg.toRawUTF8());
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+
+bool
+loadPreset(OverdrawAudioProcessor& processor, String const& path)
+{
+  MemoryBlock data;
+  if (!File(path).loadFileAsData(data)) {
+    return false;
+  }
+  if (auto xml = parseXML(data.toString())) {
+    MemoryBlock binary;
+    AudioProcessor::copyXmlToBinary(*xml, binary);
+    data = binary;
+  }
+  processor.setStateInformation(data.getData(),
+                                static_cast<int>(data.getSize()));
+  return true;
+}
+
+void
+setParameter(OverdrawAudioProcessor& processor, String const& id, float value)
+{
+  auto* parameter = processor.getOverdrawParameters().apvts->getParameter(id);
+  jassert(parameter);
+  parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+void
+applySetting(OverdrawAudioProcessor& processor,
+             Setting const& setting,
+             Options const& options)
+{
+  processor.releaseResources();
+  setParameter(processor, "Oversampling", static_cast<float>(setting.order));
+  setParameter(
+    processor, "Linear-Phase-Oversampling", setting.isLinearPhase ? 1.f : 0.f);
+  if (setting.order > 0) {
+    processor.setLinearPhaseEngine(setting.order, setting.engine);
+  }
+  processor.setRateAndBufferSizeDetails(options.sampleRate, options.blockSize);
+  processor.prepareToPlay(options.sampleRate, options.blockSize);
+  processor.reset();
+}
+
+// Runs numSamples of a sine through the processor, keeping the last
+// output.size() samples of the left channel.
+void
+runSine(OverdrawAudioProcessor& processor,
+        Options const& options,
+        double frequency,
+        int numSamples,
+        std::vector<double>& output)
+{
+  double const amplitude = Decibels::decibelsToGain(options.levelDb);
+  double const phaseIncrement =
+    MathConstants<double>::twoPi * frequency / options.sampleRate;
+
+  AudioBuffer<double> buffer(2, options.blockSize);
+  MidiBuffer midi;
+  int const firstKept = numSamples - static_cast<int>(output.size());
+
+  for (int offset = 0; offset < numSamples; offset += options.blockSize) {
+    int const blockSize = jmin(options.blockSize, numSamples - offset);
+    buffer.setSize(2, blockSize, false, false, true);
+    for (int i = 0; i < blockSize; ++i) {
+      // the phase is computed from the index to stay exactly periodic
+      double const x =
+        amplitude * std::sin(phaseIncrement * static_cast<double>(offset + i));
+      buffer.setSample(0, i, x);
+      buffer.setSample(1, i, x);
+    }
+    processor.processBlock(buffer, midi);
+    for (int i = 0; i < blockSize; ++i) {
+      int const index = offset + i - firstKept;
+      if (index >= 0) {
+        output[index] = buffer.getSample(0, i);
+      }
+    }
+  }
+}
+
+double*
+allocateFftBuffer()
+{
+  return static_cast<double*>(pffftd_aligned_malloc(fftSize * sizeof(double)));
+}
+
+class Spectrum final
+{
+public:
+  Spectrum()
+    : setup(pffftd_new_setup(fftSize, PFFFT_REAL))
+    , input(allocateFftBuffer())
+    , output(allocateFftBuffer())
+    , work(allocateFftBuffer())
+  {}
+
+  Spectrum(Spectrum const&) = delete;
+  Spectrum& operator=(Spectrum const&) = delete;
+
+  ~Spectrum()
+  {
+    pffftd_aligned_free(work);
+    pffftd_aligned_free(output);
+    pffftd_aligned_free(input);
+    pffftd_destroy_setup(setup);
+  }
+
+  void compute(std::vector<double> const& signal)
+  {
+    std::copy(signal.begin(), signal.end(), input);
+    pffftd_transform_ordered(setup, input, output, work, PFFFT_FORWARD);
+  }
+
+  // power of a bin in (0, fftSize / 2)
+  double getPower(int bin) const
+  {
+    double const re = output[2 * bin];
+    double const im = output[2 * bin + 1];
+    return re * re + im * im;
+  }
+
+private:
+  PFFFTD_Setup* setup;
+  double* input;
+  double* output;
+  double* work;
+};
+
+struct Distortion final
+{
+  double aliasingDb;
+  double thdDb;
+};
+
+Distortion
+analyse(Spectrum const& spectrum, int fundamentalBin)
+{
+  double const fundamental = spectrum.getPower(fundamentalBin);
+  double harmonics = 0.0;
+  double aliases = 0.0;
+  for (int h = 2; h <= maxHarmonic; ++h) {
+    int64_t const unfolded = static_cast<int64_t>(h) * fundamentalBin;
+    int bin = static_cast<int>(unfolded % fftSize);
+    if (bin > fftSize / 2) {
+      bin = fftSize - bin;
+    }
+    if (bin == 0 || bin == fftSize / 2) {
+      continue;
+    }
+    if (unfolded < fftSize / 2) {
+      harmonics += spectrum.getPower(bin);
+    }
+    else {
+      aliases += spectrum.getPower(bin);
+    }
+  }
+  auto const toDb = [&](double power) {
+    return 10.0 * std::log10(power / fundamental + 1.0e-30);
+  };
+  return { toDb(aliases), toDb(harmonics) };
+}
+
+Measurement
+measure(OverdrawAudioProcessor& processor,
+        Setting const& setting,
+        Options const& options,
+        Spectrum& spectrum)
+{
+  Measurement measurement{ setting, -300.0, -300.0, 0.0 };
+
+  std::vector<double> output(fftSize);
+  // one second lets the smoothing settle and the latency pass
+  int const warmUp = static_cast<int>(options.sampleRate);
+
+  for (double frequency : options.frequencies) {
+    // an odd bin, so that no alias can land on a harmonic
+    int bin = static_cast<int>(std::round(frequency * fftSize /
+                                          options.sampleRate)) | 1;
+    bin = jlimit(1, fftSize / 2 - 1, bin);
+    double const binFrequency = bin * options.sampleRate / fftSize;
+
+    applySetting(processor, setting, options);
+    runSine(processor, options, binFrequency, warmUp + fftSize, output);
+    spectrum.compute(output);
+    auto const distortion = analyse(spectrum, bin);
+    measurement.worstAliasingDb =
+      jmax(measurement.worstAliasingDb, distortion.aliasingDb);
+    measurement.worstThdDb = jmax(measurement.worstThdDb, distortion.thdDb);
+  }
+
+  // cpu cost, on a sine in the middle of the band
+  applySetting(processor, setting, options);
+  int const numCpuSamples =
+    jmax(options.blockSize,
+         static_cast<int>(options.cpuSeconds * options.sampleRate));
+  std::vector<double> discarded(1);
+  auto const start = std::chrono::steady_clock::now();
+  runSine(processor, options, 1000.0, numCpuSamples, discarded);
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+  measurement.nsPerSample =
+    std::chrono::duration<double, std::nano>(elapsed).count() / numCpuSamples;
+
+  return measurement;
+}
+
+std::vector<Setting>
+getSettings()
+{
+  using Engine = OverdrawAudioProcessor::LinearPhaseEngine;
+  std::vector<Setting> settings;
+  settings.push_back({ 0, false, Engine::directFir });
+  for (int order = 1; order < OverdrawAudioProcessor::numOversamplingOrders;
+       ++order) {
+    settings.push_back({ order, false, Engine::directFir });
+    settings.push_back({ order, true, Engine::directFir });
+    settings.push_back({ order, true, Engine::partitionedFft });
+  }
+  return settings;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  ScopedJuceInitialiser_GUI juce;
+
+  StringArray args;
+  for (int i = 1; i < argc; ++i) {
+    args.add(argv[i]);
+  }
+  auto const options = parseOptions(args);
+  if (!options) {
+    printUsage();
+    return 2;
+  }
+
+  OverdrawAudioProcessor processor;
+  if (options->presetPath.isNotEmpty() &&
+      !loadPreset(processor, options->presetPath)) {
+    std::fprintf(
+      stderr, "could not read %s\n", options->presetPath.toRawUTF8());
+    return 2;
+  }
+
+  Spectrum spectrum;
+  std::vector<Measurement> measurements;
+
+  std::printf("%-28s %14s %10s %12s %10s\n",
+              "setting",
+              "aliasing (dB)",
+              "THD (dB)",
+              "ns/sample",
+              "realtime");
+
+  for (auto const& setting : getSettings()) {
+    auto const measurement = measure(processor, setting, *options, spectrum);
+    double const realtimeFactor =
+      1.0e9 / (measurement.nsPerSample * options->sampleRate);
+    std::printf("%-28s %14.1f %10.1f %12.1f %9.0fx\n",
+                setting.getName().toRawUTF8(),
+                measurement.worstAliasingDb,
+                measurement.worstThdDb,
+                measurement.nsPerSample,
+                realtimeFactor);
+    std::fflush(stdout);
+    measurements.push_back(measurement);
+  }
+
+  Measurement const* cheapest = nullptr;
+  for (auto const& measurement : measurements) {
+    if (measurement.worstAliasingDb <= options->floorDb &&
+        (!cheapest || measurement.nsPerSample < cheapest->nsPerSample)) {
+      cheapest = &measurement;
+    }
+  }
+
+  if (!cheapest) {
+    std::printf("\nno setting keeps the aliasing below %.1f dB\n",
+                options->floorDb);
+    return 1;
+  }
+
+  std::printf("\ncheapest setting with aliasing below %.1f dB: %s\n",
+              options->floorDb,
+              cheapest->setting.getName().toRawUTF8());
+  return 0;
+}
@@ -0,0 +1,302 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Deterministic replay of a session captured by the plug-in, see
+// OverdrawAudioProcessor::setSessionCaptureTarget.
+//
+// A fresh processor gets the state, the parameter values and the settings of
+// the capture, is prepared as the captured one was, and is given the same
+// blocks, with the same parameter and setting changes, resets and loads for
+// adaptive oversampling. Its
+// output is compared bit for bit with the captured one, and the time spent in
+// processBlock is reported as in OverdrawStressTest, per sample of each
+// block, along with the total against the duration of the session.
+// A mismatch means that the processing changed, or that a parameter or a
+// setting changed by another thread during a captured block, which the
+// capture records at the next one.
+
+#include "PluginProcessor.h"
+#include "SessionCapture.h"
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+void
+printUsage()
+{
+  std::fprintf(stderr,
+               "usage: OverdrawReplay <capture file>\n"
+               "  exits with 0 if the output matches the capture bit for "
+               "bit, 1 if it\n"
+               "  does not, 2 if the capture can't be read\n");
+}
+
+struct Result final
+{
+  int64_t numBlocks = 0;
+  int64_t numSamples = 0;
+  int64_t numMismatchingBlocks = 0;
+  int64_t firstMismatchingBlock = -1;
+  double maxDifference = 0.0;
+  // parameters whose normalized value differs from the captured one after
+  // setting it, from the rounding of their range
+  int64_t numInexactParameters = 0;
+  bool isTruncated = false;
+  std::vector<double> nsPerSample;
+  double totalSeconds = 0.0;
+};
+
+void
+setParameter(AudioProcessorParameter& parameter, float value, Result& result)
+{
+  if (parameter.getValue() != value) {
+    parameter.setValueNotifyingHost(value);
+    if (parameter.getValue() != value) {
+      ++result.numInexactParameters;
+    }
+  }
+}
+
+// the settings that the setters of the processor take, see
+// overdraw::SessionFormat::Setting
+void
+setSettings(OverdrawAudioProcessor& processor, int32_t const* settings)
+{
+  using Setting = overdraw::SessionFormat::Setting;
+  using LinearPhaseEngine = OverdrawAudioProcessor::LinearPhaseEngine;
+
+  for (int order = 0; order < OverdrawAudioProcessor::numOversamplingOrders;
+       ++order) {
+    bool const isFft = (settings[Setting::linearPhaseFftOrders] >> order) & 1;
+    processor.setLinearPhaseEngine(order,
+                                   isFft ? LinearPhaseEngine::partitionedFft
+                                         : LinearPhaseEngine::directFir);
+  }
+  processor.setOfflineMultithreading(
+    settings[Setting::offlineMultithreading] != 0);
+  processor.setAdaptiveOversampling(
+    settings[Setting::adaptiveOversampling] != 0,
+    settings[Setting::adaptiveMinOrder],
+    settings[Setting::adaptiveMaxOrder]);
+  processor.setControlRateAutomation(
+    settings[Setting::controlRateAutomation] != 0);
+  processor.setAffineShortcut(settings[Setting::affineShortcut] != 0);
+}
+
+template<class Sample>
+void
+processBlock(OverdrawAudioProcessor& processor,
+             AudioBuffer<Sample>& buffer,
+             overdraw::SessionReader::Block const& block,
+             Result& result)
+{
+  int const numSamples = block.numSamples;
+  MidiBuffer midi;
+
+  buffer.setSize(2, numSamples, false, false, true);
+  for (int c = 0; c < 2; ++c) {
+    for (int i = 0; i < numSamples; ++i) {
+      buffer.setSample(c, i, static_cast<Sample>(block.input[c][i]));
+    }
+  }
+
+  auto const start = std::chrono::steady_clock::now();
+  processor.processBlock(buffer, midi);
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+
+  double const seconds = std::chrono::duration<double>(elapsed).count();
+  result.totalSeconds += seconds;
+  if (numSamples > 0) {
+    result.nsPerSample.push_back(1.0e9 * seconds / numSamples);
+  }
+
+  bool isMatching = true;
+  for (int c = 0; c < 2; ++c) {
+    for (int i = 0; i < numSamples; ++i) {
+      Sample const sample = buffer.getSample(c, i);
+      auto const captured = static_cast<Sample>(block.output[c][i]);
+      // bitwise, so that NaNs and signed zeros match too
+      if (std::memcmp(&sample, &captured, sizeof(Sample)) != 0) {
+        isMatching = false;
+        double const difference =
+          static_cast<double>(sample) - static_cast<double>(captured);
+        result.maxDifference =
+          std::max(result.maxDifference, std::abs(difference));
+      }
+    }
+  }
+  if (!isMatching) {
+    if (result.numMismatchingBlocks == 0) {
+      result.firstMismatchingBlock = result.numBlocks;
+    }
+    ++result.numMismatchingBlocks;
+  }
+}
+
+bool
+replay(overdraw::SessionReader& reader, Result& result)
+{
+  auto processor = std::make_unique<OverdrawAudioProcessor>();
+  // not even with OVERDRAW_SESSION_CAPTURE set
+  processor->setSessionCaptureTarget({});
+
+  auto const& state = reader.getState();
+  processor->setStateInformation(state.data(), static_cast<int>(state.size()));
+
+  auto const& parameters = processor->getParameters();
+  if (static_cast<uint32_t>(parameters.size()) != reader.getNumParameters()) {
+    std::fprintf(stderr,
+                 "the capture has %u parameters, this version of the plug-in "
+                 "has %d\n",
+                 reader.getNumParameters(),
+                 parameters.size());
+    return false;
+  }
+  auto const& parameterValues = reader.getParameterValues();
+  for (int i = 0; i < parameters.size(); ++i) {
+    setParameter(*parameters[i], parameterValues[i], result);
+  }
+
+  // the state holds them too, this is for the captures of a processor whose
+  // settings differ from the ones it would load
+  int32_t settings[overdraw::SessionFormat::numSettings];
+  std::copy(reader.getSettings(),
+            reader.getSettings() + overdraw::SessionFormat::numSettings,
+            settings);
+  setSettings(*processor, settings);
+
+  double const sampleRate = reader.getSampleRate();
+  int const maxBlockSize = reader.getMaxBlockSize();
+  processor->setRateAndBufferSizeDetails(sampleRate, maxBlockSize);
+  processor->prepareToPlay(sampleRate, maxBlockSize);
+
+  AudioBuffer<float> floatBuffer(2, maxBlockSize);
+  AudioBuffer<double> doubleBuffer(2, maxBlockSize);
+
+  overdraw::SessionReader::Block block;
+  while (reader.readBlock(block)) {
+    if (block.isAfterReset) {
+      processor->reset();
+    }
+    for (auto const& [index, value] : block.parameterChanges) {
+      setParameter(*parameters[static_cast<int>(index)], value, result);
+    }
+    for (auto const& [setting, value] : block.settingChanges) {
+      settings[setting] = value;
+    }
+    if (!block.settingChanges.empty()) {
+      setSettings(*processor, settings);
+    }
+    processor->setLoadForReplay(block.load);
+
+    if (block.isDoublePrecision) {
+      processBlock(*processor, doubleBuffer, block, result);
+    }
+    else {
+      processBlock(*processor, floatBuffer, block, result);
+    }
+
+    ++result.numBlocks;
+    result.numSamples += block.numSamples;
+  }
+  result.isTruncated = !reader.isAtEnd();
+
+  processor->releaseResources();
+  return true;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  ScopedJuceInitialiser_GUI juce;
+
+  if (argc != 2 || std::strcmp(argv[1], "--help") == 0 ||
+      std::strcmp(argv[1], "-h") == 0) {
+    printUsage();
+    return 2;
+  }
+
+  overdraw::SessionReader reader;
+  if (!reader.open(argv[1])) {
+    std::fprintf(stderr, "could not read a capture from %s\n", argv[1]);
+    return 2;
+  }
+
+  Result result;
+  if (!replay(reader, result)) {
+    return 2;
+  }
+
+  double const duration = result.numSamples / reader.getSampleRate();
+
+  std::printf("blocks                 %lld\n",
+              static_cast<long long>(result.numBlocks));
+  std::printf("duration               %.3f s at %g Hz, blocks up to %d\n",
+              duration,
+              reader.getSampleRate(),
+              reader.getMaxBlockSize());
+  if (result.isTruncated) {
+    std::printf("                       the capture ends with a partial "
+                "block, which is ignored\n");
+  }
+  if (result.numInexactParameters > 0) {
+    std::printf("inexact parameters     %lld, the output may differ\n",
+                static_cast<long long>(result.numInexactParameters));
+  }
+
+  if (result.numMismatchingBlocks == 0) {
+    std::printf("output                 bit-exact\n");
+  }
+  else {
+    std::printf("output                 %lld blocks differ, the first is "
+                "block %lld, max difference %g\n",
+                static_cast<long long>(result.numMismatchingBlocks),
+                static_cast<long long>(result.firstMismatchingBlock),
+                result.maxDifference);
+  }
+
+  auto& nsPerSample = result.nsPerSample;
+  if (!nsPerSample.empty()) {
+    std::sort(nsPerSample.begin(), nsPerSample.end());
+    auto const percentile = [&](double p) {
+      auto const index = std::min(
+        nsPerSample.size() - 1,
+        static_cast<size_t>(std::ceil(p * nsPerSample.size())) - 1);
+      return nsPerSample[index];
+    };
+    std::printf("processing time        %.3f s, %.1f times real time\n",
+                result.totalSeconds,
+                result.totalSeconds > 0.0 ? duration / result.totalSeconds
+                                          : 0.0);
+    std::printf("ns/sample              median %.1f, p99.99 %.1f, max %.1f\n",
+                percentile(0.5),
+                percentile(0.9999),
+                nsPerSample.back());
+  }
+
+  return result.numMismatchingBlocks == 0 ? 0 : 1;
+}
@@ -0,0 +1,464 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Streaming processing of raw PCM, from stdin to stdout, for pipelines like
+// ffmpeg | OverdrawStream | encoder, without temporary files.
+//
+// The input is interleaved float32 or float64 in native byte order. It is
+// read in blocks of a fixed number of frames by a reader thread and written
+// by a writer thread, each handing blocks to the processing through a pair
+// of buffers: one is filled while the other is drained, so a stall of the
+// pipe or the disk on either side does not stop the processing until both
+// buffers are waiting. The latency is one block on each side, plus the one of
+// the plug-in, which is removed from the output unless asked otherwise: the
+// first frames are dropped and the end of the stream is padded with silence,
+// so the output has as many frames as the input, aligned with it.
+
+#include "PluginProcessor.h"
+#include <JuceHeader.h>
+
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+enum class Format
+{
+  float32,
+  float64
+};
+
+struct Options final
+{
+  String presetPath;
+  String parametersPath;
+  Format format = Format::float32;
+  int numChannels = 2;
+  double sampleRate = 48000.0;
+  int blockSize = 256;
+  bool isKeepingLatency = false;
+
+  int getSampleBytes() const
+  {
+    return format == Format::float32 ? sizeof(float) : sizeof(double);
+  }
+
+  int getFrameBytes() const { return numChannels * getSampleBytes(); }
+};
+
+void
+printUsage()
+{
+  std::fprintf(
+    stderr,
+    "usage: OverdrawStream [options] < input.raw > output.raw\n"
+    "  --preset <file>        plug-in state, binary or xml (default: init)\n"
+    "  --parameters <file>    one '<parameter id> <value>' per line, in the\n"
+    "                         units of the parameter, applied after the "
+    "preset\n"
+    "  --format <f32|f64>     sample format, native byte order "
+    "(default: f32)\n"
+    "  --channels <1|2>       interleaved channels (default: 2)\n"
+    "  --sample-rate <Hz>     (default: 48000)\n"
+    "  --block-size <n>       frames per block (default: 256)\n"
+    "  --keep-latency         outputs the latency of the plug-in instead of\n"
+    "                         compensating it\n");
+}
+
+std::optional<Options>
+parseOptions(StringArray const& args)
+{
+  Options options;
+  for (int i = 0; i < args.size(); ++i) {
+    auto const& arg = args[i];
+    if (arg == "--help" || arg == "-h") {
+      return std::nullopt;
+    }
+    if (arg == "--keep-latency") {
+      options.isKeepingLatency = true;
+      continue;
+    }
+    if (i + 1 == args.size()) {
+      std::fprintf(stderr, "missing value for %s\n", arg.toRawUTF8());
+      return std::nullopt;
+    }
+    auto const& value = args[++i];
+    if (arg == "--preset") {
+      options.presetPath = value;
+    }
+    else if (arg == "--parameters") {
+      options.parametersPath = value;
+    }
+    else if (arg == "--format") {
+      if (value == "f32") {
+        options.format = Format::float32;
+      }
+      else if (value == "f64") {
+        options.format = Format::float64;
+      }
+      else {
+        std::fprintf(stderr, "unknown format %s\n", value.toRawUTF8());
+        return std::nullopt;
+      }
+    }
+    else if (arg == "--channels") {
+      options.numChannels = jlimit(1, 2, value.getIntValue());
+    }
+    else if (arg == "--sample-rate") {
+      options.sampleRate = value.getDoubleValue();
+    }
+    else if (arg == "--block-size") {
+      options.blockSize = jmax(1, value.getIntValue());
+    }
+    else {
+      std::fprintf(stderr, "unknown option %s\n", arg.toRawUTF8());
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+
+bool
+loadPreset(OverdrawAudioProcessor& processor, String const& path)
+{
+  MemoryBlock data;
+  if (!File(path).loadFileAsData(data)) {
+    return false;
+  }
+  if (auto xml = parseXML(data.toString())) {
+    MemoryBlock binary;
+    AudioProcessor::copyXmlToBinary(*xml, binary);
+    data = binary;
+  }
+  processor.setStateInformation(data.getData(),
+                                static_cast<int>(data.getSize()));
+  return true;
+}
+
+// blank lines and the text after a '#' are ignored
+bool
+loadParameters(OverdrawAudioProcessor& processor, String const& path)
+{
+  auto const file = File(path);
+  if (!file.existsAsFile()) {
+    std::fprintf(stderr, "could not read %s\n", path.toRawUTF8());
+    return false;
+  }
+  auto& apvts = *processor.getOverdrawParameters().apvts;
+  StringArray lines;
+  file.readLines(lines);
+  for (int i = 0; i < lines.size(); ++i) {
+    auto const line = lines[i].upToFirstOccurrenceOf("#", false, false).trim();
+    if (line.isEmpty()) {
+      continue;
+    }
+    auto const tokens = StringArray::fromTokens(line, " \t=", {});
+    auto* parameter = tokens.size() == 2 ? apvts.getParameter(tokens[0])
+                                         : nullptr;
+    if (!parameter) {
+      std::fprintf(stderr,
+                   "%s:%d: expected '<parameter id> <value>', got '%s'\n",
+                   path.toRawUTF8(),
+                   i + 1,
+                   line.toRawUTF8());
+      return false;
+    }
+    parameter->setValueNotifyingHost(
+      parameter->convertTo0to1(tokens[1].getFloatValue()));
+  }
+  return true;
+}
+
+struct Block final
+{
+  std::vector<char> data;
+  size_t size = 0;
+  bool isLast = false;
+};
+
+// Two blocks handed from one thread to another. The producer fills a block
+// while the consumer drains the other one, and waits only when the consumer
+// has not yet released the block it needs next, and vice versa.
+class DoubleBuffer final
+{
+public:
+  explicit DoubleBuffer(size_t capacity)
+  {
+    for (auto& block : blocks) {
+      block.data.resize(capacity);
+    }
+  }
+
+  Block& acquireEmpty()
+  {
+    auto lock = std::unique_lock<std::mutex>(mutex);
+    condition.wait(lock, [&] { return !isFull[writeIndex]; });
+    return blocks[writeIndex];
+  }
+
+  void publish()
+  {
+    {
+      auto const lock = std::lock_guard<std::mutex>(mutex);
+      isFull[writeIndex] = true;
+    }
+    writeIndex ^= 1;
+    condition.notify_all();
+  }
+
+  Block& acquireFull()
+  {
+    auto lock = std::unique_lock<std::mutex>(mutex);
+    condition.wait(lock, [&] { return isFull[readIndex]; });
+    return blocks[readIndex];
+  }
+
+  void release()
+  {
+    {
+      auto const lock = std::lock_guard<std::mutex>(mutex);
+      isFull[readIndex] = false;
+    }
+    readIndex ^= 1;
+    condition.notify_all();
+  }
+
+private:
+  std::array<Block, 2> blocks;
+  std::array<bool, 2> isFull{};
+  // each owned by one side
+  int writeIndex = 0;
+  int readIndex = 0;
+  std::mutex mutex;
+  std::condition_variable condition;
+};
+
+void
+readInput(DoubleBuffer& input)
+{
+  for (;;) {
+    auto& block = input.acquireEmpty();
+    block.size = std::fread(block.data.data(), 1, block.data.size(), stdin);
+    block.isLast = block.size < block.data.size();
+    bool const isLast = block.isLast;
+    input.publish();
+    if (isLast) {
+      return;
+    }
+  }
+}
+
+// a write error ends the process, as a closed pipe does through SIGPIPE,
+// since the processing and the reader cannot do anything useful after it
+void
+writeOutput(DoubleBuffer& output)
+{
+  for (;;) {
+    auto& block = output.acquireFull();
+    if (std::fwrite(block.data.data(), 1, block.size, stdout) != block.size ||
+        std::fflush(stdout) != 0) {
+      std::fprintf(stderr, "could not write the output\n");
+      std::_Exit(1);
+    }
+    bool const isLast = block.isLast;
+    output.release();
+    if (isLast) {
+      return;
+    }
+  }
+}
+
+template<class Sample>
+void
+deinterleave(char const* data,
+             AudioBuffer<double>& buffer,
+             int const numChannels,
+             int const numFrames)
+{
+  for (int i = 0; i < numFrames; ++i) {
+    for (int c = 0; c < numChannels; ++c) {
+      Sample sample;
+      std::memcpy(&sample, data, sizeof(Sample));
+      data += sizeof(Sample);
+      buffer.setSample(c, i, static_cast<double>(sample));
+    }
+  }
+  // mono goes through both channels of the plug-in
+  if (numChannels == 1) {
+    buffer.copyFrom(1, 0, buffer, 0, 0, numFrames);
+  }
+}
+
+template<class Sample>
+void
+interleave(AudioBuffer<double> const& buffer,
+           char* data,
+           int const numChannels,
+           int const firstFrame,
+           int const numFrames)
+{
+  for (int i = firstFrame; i < numFrames; ++i) {
+    for (int c = 0; c < numChannels; ++c) {
+      auto const sample = static_cast<Sample>(buffer.getSample(c, i));
+      std::memcpy(data, &sample, sizeof(Sample));
+      data += sizeof(Sample);
+    }
+  }
+}
+
+int
+run(OverdrawAudioProcessor& processor, Options const& options)
+{
+  int const blockSize = options.blockSize;
+  int const frameBytes = options.getFrameBytes();
+  bool const isFloat32 = options.format == Format::float32;
+
+  processor.setRateAndBufferSizeDetails(options.sampleRate, blockSize);
+  processor.prepareToPlay(options.sampleRate, blockSize);
+
+  int const latency =
+    options.isKeepingLatency ? 0 : processor.getLatencySamples();
+
+  AudioBuffer<double> buffer(2, blockSize);
+  MidiBuffer midi;
+
+  auto const capacity = static_cast<size_t>(blockSize * frameBytes);
+  DoubleBuffer input(capacity);
+  DoubleBuffer output(capacity);
+
+  std::thread reader(readInput, std::ref(input));
+  std::thread writer(writeOutput, std::ref(output));
+
+  int numFramesToDrop = latency;
+
+  // the buffer holds numFrames frames
+  auto const processAndWrite = [&](int const numFrames, bool const isLast) {
+    if (numFrames > 0) {
+      processor.processBlock(buffer, midi);
+    }
+
+    int const firstFrame = jmin(numFramesToDrop, numFrames);
+    numFramesToDrop -= firstFrame;
+
+    auto& block = output.acquireEmpty();
+    if (isFloat32) {
+      interleave<float>(buffer,
+                        block.data.data(),
+                        options.numChannels,
+                        firstFrame,
+                        numFrames);
+    }
+    else {
+      interleave<double>(buffer,
+                         block.data.data(),
+                         options.numChannels,
+                         firstFrame,
+                         numFrames);
+    }
+    block.size = static_cast<size_t>((numFrames - firstFrame) * frameBytes);
+    block.isLast = isLast;
+    output.publish();
+  };
+
+  for (;;) {
+    auto& block = input.acquireFull();
+    // a trailing partial frame is dropped
+    int const numFrames = static_cast<int>(block.size / frameBytes);
+    bool const isLast = block.isLast;
+    buffer.setSize(2, numFrames, false, false, true);
+    if (isFloat32) {
+      deinterleave<float>(
+        block.data.data(), buffer, options.numChannels, numFrames);
+    }
+    else {
+      deinterleave<double>(
+        block.data.data(), buffer, options.numChannels, numFrames);
+    }
+    input.release();
+
+    processAndWrite(numFrames, isLast && latency == 0);
+
+    if (isLast) {
+      break;
+    }
+  }
+
+  // the tail still inside the plug-in, pushed out by silence
+  for (int numFramesLeft = latency; numFramesLeft > 0;) {
+    int const numFrames = jmin(blockSize, numFramesLeft);
+    numFramesLeft -= numFrames;
+    buffer.setSize(2, numFrames, false, false, true);
+    buffer.clear();
+    processAndWrite(numFrames, numFramesLeft == 0);
+  }
+
+  reader.join();
+  writer.join();
+
+  processor.releaseResources();
+  return 0;
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  ScopedJuceInitialiser_GUI juce;
+
+  StringArray args;
+  for (int i = 1; i < argc; ++i) {
+    args.add(argv[i]);
+  }
+  auto const options = parseOptions(args);
+  if (!options) {
+    printUsage();
+    return 2;
+  }
+
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+  OverdrawAudioProcessor processor;
+  if (options->presetPath.isNotEmpty() &&
+      !loadPreset(processor, options->presetPath)) {
+    std::fprintf(
+      stderr, "could not read %s\n", options->presetPath.toRawUTF8());
+    return 2;
+  }
+  if (options->parametersPath.isNotEmpty() &&
+      !loadParameters(processor, options->parametersPath)) {
+    return 2;
+  }
+
+  return run(processor, *options);
+}
@@ -0,0 +1,277 @@
+/*
+Copyright 2020-2026 Dario Mambro
+
+This file is part of Overdraw.
+
+Overdraw is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Overdraw is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Overdraw.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Worst-case execution time of processBlock under adversarial conditions.
+//
+// Each scenario drives a fresh processor with blocks of noise and records the
+// time per sample of every block, then reports its maximum and its 99.99th
+// percentile. Averages hide the spikes that cause dropouts, so no average is
+// reported at all.
+
+#include "PluginProcessor.h"
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <optional>
+#include <random>
+
+namespace {
+
+struct Options final
+{
+  double sampleRate = 48000.0;
+  int maxBlockSize = 512;
+  int numBlocks = 50000;
+  uint32_t seed = 1;
+  String filter;
+};
+
+enum class Input
+{
+  noise,
+  denormals
+};
+
+struct Scenario final
+{
+  String name;
+  bool hasRandomBlockSizes = false;
+  bool hasOversamplingFlips = false;
+  bool hasKnotJumps = false;
+  bool hasMidSideToggles = false;
+  Input input = Input::noise;
+};
+
+std::vector<Scenario>
+getScenarios()
+{
+  std::vector<Scenario> scenarios;
+  scenarios.push_back({ "baseline" });
+  scenarios.push_back({ "random-block-sizes", true });
+  scenarios.push_back({ "oversampling-flips", false, true });
+  scenarios.push_back({ "knot-jumps", false, false, true });
+  scenarios.push_back({ "denormals", false, false, false, false,
+                        Input::denormals });
+  scenarios.push_back({ "mid-side-toggles", false, false, false, true });
+  scenarios.push_back({ "everything", true, true, true, true,
+                        Input::denormals });
+  return scenarios;
+}
+
+void
+printUsage()
+{
+  std::printf(
+    "usage: OverdrawStressTest [options]\n"
+    "  --blocks <n>           blocks per scenario (default: 50000)\n"
+    "  --max-block-size <n>   block size given to prepareToPlay "
+    "(default: 512)\n"
+    "  --sample-rate <Hz>     (default: 48000)\n"
+    "  --seed <n>             (default: 1)\n"
+    "  --filter <text>        runs only the scenarios whose name contains "
+    "it\n");
+}
+
+std::optional<Options>
+parseOptions(StringArray const& args)
+{
+  Options options;
+  for (int i = 0; i < args.size(); ++i) {
+    auto const& arg = args[i];
+    if (arg == "--help" || arg == "-h" || i + 1 == args.size()) {
+      return std::nullopt;
+    }
+    auto const& value = args[++i];
+    if (arg == "--blocks") {
+      options.numBlocks = jmax(1, value.getIntValue());
+    }
+    else if (arg == "--max-block-size") {
+      options.maxBlockSize = jmax(1, value.getIntValue());
+    }
+    else if (arg == "--sample-rate") {
+      options.sampleRate = value.getDoubleValue();
+    }
+    else if (arg == "--seed") {
+      options.seed = static_cast<uint32_t>(value.getLargeIntValue());
+    }
+    else if (arg == "--filter") {
+      options.filter = value;
+    }
+    else {
+      std::fprintf(stderr, "unknown option %s\n", arg.toRawUTF8());
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+
+void
+setParameter(OverdrawAudioProcessor& processor, String const& id, float value)
+{
+  auto* parameter = processor.getOverdrawParameters().apvts->getParameter(id);
+  jassert(parameter);
+  parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+// the parameters of the knots of all the splines, to be thrown between the
+// ends of their ranges
+std::vector<AudioProcessorParameter*>
+getKnotParameters(OverdrawAudioProcessor& processor)
+{
+  std::vector<AudioProcessorParameter*> knotParameters;
+  for (auto* parameter : processor.getParameters()) {
+    auto* withId = dynamic_cast<AudioProcessorParameterWithID*>(parameter);
+    if (withId && withId->paramID.containsIgnoreCase("knot")) {
+      knotParameters.push_back(parameter);
+    }
+  }
+  return knotParameters;
+}
+
+struct Result final
+{
+  double maxNsPerSample = 0.0;
+  double p9999NsPerSample = 0.0;
+  double maxBlockMs = 0.0;
+};
+
+Result
+run(Scenario const& scenario, Options const& options)
+{
+  auto processor = std::make_unique<OverdrawAudioProcessor>();
+  processor->setRateAndBufferSizeDetails(options.sampleRate,
+                                         options.maxBlockSize);
+  processor->prepareToPlay(options.sampleRate, options.maxBlockSize);
+
+  auto const knotParameters = getKnotParameters(*processor);
+
+  auto randomGenerator = std::mt19937(options.seed);
+  auto uniform = std::uniform_real_distribution<double>(-1.0, 1.0);
+  // from a single sample up to twice the prepared maximum
+  auto blockSizes =
+    std::uniform_int_distribution<int>(1, 2 * options.maxBlockSize);
+  auto orders = std::uniform_int_distribution<int>(
+    0, OverdrawAudioProcessor::numOversamplingOrders - 1);
+  auto coin = std::bernoulli_distribution(0.5);
+  auto rareEvent = std::bernoulli_distribution(0.05);
+
+  int const maxNumSamples = 2 * options.maxBlockSize;
+  AudioBuffer<double> buffer(2, maxNumSamples);
+  MidiBuffer midi;
+
+  std::vector<double> nsPerSample;
+  nsPerSample.reserve(options.numBlocks);
+  double maxBlockNs = 0.0;
+
+  bool isMidSide = false;
+  bool areKnotsHigh = false;
+
+  for (int block = 0; block < options.numBlocks; ++block) {
+    int const numSamples = scenario.hasRandomBlockSizes
+                             ? blockSizes(randomGenerator)
+                             : options.maxBlockSize;
+
+    // parameter changes happen between blocks, as from a host
+    if (scenario.hasOversamplingFlips && rareEvent(randomGenerator)) {
+      auto const order = static_cast<float>(orders(randomGenerator));
+      setParameter(*processor, "Oversampling", order);
+      setParameter(*processor,
+                   "Linear-Phase-Oversampling",
+                   coin(randomGenerator) ? 1.f : 0.f);
+    }
+    if (scenario.hasKnotJumps) {
+      areKnotsHigh = !areKnotsHigh;
+      for (auto* parameter : knotParameters) {
+        parameter->setValueNotifyingHost(areKnotsHigh ? 1.f : 0.f);
+      }
+    }
+    if (scenario.hasMidSideToggles) {
+      isMidSide = !isMidSide;
+      setParameter(*processor, "Mid-Side", isMidSide ? 1.f : 0.f);
+    }
+
+    buffer.setSize(2, numSamples, false, false, true);
+    double const level = scenario.input == Input::denormals ? 1.0e-310 : 0.5;
+    for (int c = 0; c < 2; ++c) {
+      for (int i = 0; i < numSamples; ++i) {
+        buffer.setSample(c, i, level * uniform(randomGenerator));
+      }
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+    processor->processBlock(buffer, midi);
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+
+    double const ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    nsPerSample.push_back(ns / numSamples);
+    maxBlockNs = jmax(maxBlockNs, ns);
+  }
+
+  std::sort(nsPerSample.begin(), nsPerSample.end());
+  auto const percentileIndex = std::min(
+    nsPerSample.size() - 1,
+    static_cast<size_t>(std::ceil(0.9999 * nsPerSample.size())) - 1);
+
+  return { nsPerSample.back(),
+           nsPerSample[percentileIndex],
+           1.0e-6 * maxBlockNs };
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  ScopedJuceInitialiser_GUI juce;
+
+  StringArray args;
+  for (int i = 1; i < argc; ++i) {
+    args.add(argv[i]);
+  }
+  auto const options = parseOptions(args);
+  if (!options) {
+    printUsage();
+    return 2;
+  }
+
+  std::printf("%-22s %16s %16s %14s\n",
+              "scenario",
+              "max ns/sample",
+              "p99.99 ns/sample",
+              "max block ms");
+
+  for (auto const& scenario : getScenarios()) {
+    if (options->filter.isNotEmpty() &&
+        !scenario.name.contains(options->filter)) {
+      continue;
+    }
+    auto const result = run(scenario, *options);
+    std::printf("%-22s %16.1f %16.1f %14.3f\n",
+                scenario.name.toRawUTF8(),
+                result.maxNsPerSample,
+                result.p9999NsPerSample,
+                result.maxBlockMs);
+    std::fflush(stdout);
+  }
+
+  return 0;
+}